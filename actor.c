@@ -0,0 +1,382 @@
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+#include "defs.h"
+#include "helpers.h"
+
+static long long monotonic_ns() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+static int room_index(struct House* house, struct Room* room) {
+    return (int)(room - house->rooms);
+}
+
+// Connections from a room into the given part (-1 counts unassigned neighbours)
+static int edges_into(struct House* house, int room, int part, const int* assignment) {
+    int count = 0;
+    struct Room* from = &house->rooms[room];
+    for (int i = 0; i < from->connection_count; i++) {
+        if (assignment[room_index(house, from->connections[i])] == part) {
+            count++;
+        }
+    }
+    return count;
+}
+
+// Splits the rooms into parts of near-equal size with few connections between them.
+// Each part grows from a corner of what is left by taking the room with the most
+// connections into it, then boundary rooms move wherever that cuts fewer connections
+// while sizes stay balanced. Returns the number of connections crossing parts.
+int actor_partition_rooms(struct House* house, int parts, int* assignment) {
+    if (!house || !assignment || parts < 1) return -1;
+    int n = house->room_count;
+    if (parts > n) parts = n;
+    int* sizes = calloc(parts, sizeof(int));
+    if (!sizes) return -1;
+    for (int i = 0; i < n; i++) {
+        assignment[i] = -1;
+    }
+
+    int assigned = 0;
+    for (int p = 0; p < parts; p++) {
+        int target = (n - assigned + (parts - p) - 1) / (parts - p);
+        while (sizes[p] < target) {
+            int best = -1;
+            int best_in = 0;
+            int best_out = 0;
+            // A part with no frontier left (or no rooms yet) starts again from a corner
+            for (int pass = (sizes[p] == 0); pass < 2 && best < 0; pass++) {
+                for (int r = 0; r < n; r++) {
+                    if (assignment[r] != -1) continue;
+                    int in = edges_into(house, r, p, assignment);
+                    if (in == 0 && pass == 0) continue;
+                    int out = edges_into(house, r, -1, assignment);
+                    if (best < 0 || in > best_in || (in == best_in && out < best_out)) {
+                        best = r;
+                        best_in = in;
+                        best_out = out;
+                    }
+                }
+            }
+            assignment[best] = p;
+            sizes[p]++;
+            assigned++;
+        }
+    }
+
+    int slack = n / (parts * 20) + 1;
+    int upper = (n + parts - 1) / parts + slack;
+    int lower = n / parts - slack;
+    for (int pass = 0; pass < 8; pass++) {
+        int moved = 0;
+        for (int r = 0; r < n; r++) {
+            int own = assignment[r];
+            if (sizes[own] <= 1 || sizes[own] <= lower) continue;
+            int internal = edges_into(house, r, own, assignment);
+            int best_part = -1;
+            int best_gain = 0;
+            struct Room* room = &house->rooms[r];
+            for (int c = 0; c < room->connection_count; c++) {
+                int other = assignment[room_index(house, room->connections[c])];
+                if (other == own || sizes[other] >= upper) continue;
+                int gain = edges_into(house, r, other, assignment) - internal;
+                if (gain > best_gain) {
+                    best_gain = gain;
+                    best_part = other;
+                }
+            }
+            if (best_part >= 0) {
+                sizes[own]--;
+                sizes[best_part]++;
+                assignment[r] = best_part;
+                moved++;
+            }
+        }
+        if (moved == 0) break;
+    }
+    free(sizes);
+
+    int cut = 0;
+    for (int r = 0; r < n; r++) {
+        struct Room* room = &house->rooms[r];
+        for (int c = 0; c < room->connection_count; c++) {
+            int other = room_index(house, room->connections[c]);
+            if (other > r && assignment[other] != assignment[r]) {
+                cut++;
+            }
+        }
+    }
+    return cut;
+}
+
+static struct Room* entity_room(struct Entity* entity) {
+    if (entity->kind == ENTITY_GHOST) {
+        return ((struct Ghost*)entity)->current_room;
+    }
+    return ((struct Hunter*)entity)->current_room;
+}
+
+static bool entity_is_running(struct Entity* entity) {
+    if (entity->kind == ENTITY_GHOST) {
+        return ((struct Ghost*)entity)->is_running;
+    }
+    return ((struct Hunter*)entity)->is_running;
+}
+
+static void entity_take_turn(struct Entity* entity) {
+    trace_bind(entity->trace);
+    if (entity->kind == ENTITY_GHOST) {
+        struct Ghost* ghost = (struct Ghost*)entity;
+        rand_bind_stream(&ghost->rng_state);
+        ghost_take_turn(ghost);
+    } else {
+        struct Hunter* hunter = (struct Hunter*)entity;
+        rand_bind_stream(&hunter->rng_state);
+        hunter_take_turn(hunter);
+    }
+}
+
+static void entity_leave_house(struct Entity* entity) {
+    trace_bind(entity->trace);
+    if (entity->kind == ENTITY_GHOST) {
+        ghost_leave_house((struct Ghost*)entity);
+    } else {
+        hunter_leave_house((struct Hunter*)entity);
+    }
+}
+
+static bool worker_adopt(struct Worker* worker, struct Entity* entity) {
+    if (worker->resident_count >= worker->resident_capacity) {
+        int capacity = worker->resident_capacity ? worker->resident_capacity * 2 : 16;
+        struct Entity** residents = realloc(worker->residents, sizeof(struct Entity*) * capacity);
+        if (!residents) {
+            fprintf(stderr, "Worker %d can't take in another entity\n", worker->index);
+            return false;
+        }
+        worker->residents = residents;
+        worker->resident_capacity = capacity;
+    }
+    worker->residents[worker->resident_count++] = entity;
+    return true;
+}
+
+// Order doesn't matter, so the last resident fills the gap
+static void worker_release(struct Worker* worker, int slot) {
+    worker->residents[slot] = worker->residents[--worker->resident_count];
+}
+
+// Any worker may push; only the owner takes the whole list at once, so there is no ABA
+static void worker_post(struct Worker* worker, struct Entity* entity) {
+    struct Entity* head = __atomic_load_n(&worker->inbox, __ATOMIC_RELAXED);
+    do {
+        entity->next_message = head;
+    } while (!__atomic_compare_exchange_n(&worker->inbox, &head, entity, true,
+                                          __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+static void worker_drain_inbox(struct Worker* worker) {
+    struct Entity* pending = __atomic_exchange_n(&worker->inbox, NULL, __ATOMIC_ACQUIRE);
+    // The inbox is a stack, so reverse it to admit entities in arrival order
+    struct Entity* arrivals = NULL;
+    while (pending) {
+        struct Entity* next = pending->next_message;
+        pending->next_message = arrivals;
+        arrivals = pending;
+        pending = next;
+    }
+    while (arrivals) {
+        struct Entity* entity = arrivals;
+        arrivals = entity->next_message;
+        entity->next_message = NULL;
+        room_accept_entity(entity_room(entity), entity);
+        if (!worker_adopt(worker, entity)) {
+            entity_leave_house(entity);
+        }
+    }
+}
+
+// Everyone still in this partition, or on their way into it, leaves with the house
+static void worker_evacuate(struct Worker* worker) {
+    worker_drain_inbox(worker);
+    while (worker->resident_count > 0) {
+        entity_leave_house(worker->residents[--worker->resident_count]);
+    }
+}
+
+static void* worker_thread(void* arg) {
+    struct Worker* worker = (struct Worker*)arg;
+    struct House* house = worker->house;
+    bool fast = house->config.fast;
+    while (!house_is_shutting_down(house)) {
+        // A whole round counts as one turn, so checkpoints land between rounds
+        house_turn_begin(house);
+        worker_drain_inbox(worker);
+        long long now = monotonic_ns();
+        long long wake_at = now + ACTOR_IDLE_NS;
+        bool ran = false;
+        int i = 0;
+        while (i < worker->resident_count) {
+            struct Entity* entity = worker->residents[i];
+            if (!fast && entity->next_turn_ns > now) {
+                if (entity->next_turn_ns < wake_at) {
+                    wake_at = entity->next_turn_ns;
+                }
+                i++;
+                continue;
+            }
+            ran = true;
+            worker->turns++;
+            entity_take_turn(entity);
+            if (!entity_is_running(entity)) {
+                worker_release(worker, i);
+                entity_leave_house(entity);
+                continue;
+            }
+            entity->next_turn_ns = now + (entity->kind == ENTITY_GHOST ? GHOST_TURN_NS : HUNTER_TURN_NS);
+            struct Room* room = entity_room(entity);
+            if (room->owner != worker) {
+                // The turn is over, so the other worker can safely pick the entity up
+                worker_release(worker, i);
+                worker->handoffs++;
+                worker_post(room->owner, entity);
+                continue;
+            }
+            i++;
+        }
+        house_turn_end(house);
+        if (fast) {
+            if (!ran) sched_yield();
+            continue;
+        }
+        struct timespec until = { .tv_sec = wake_at / 1000000000LL, .tv_nsec = wake_at % 1000000000LL };
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &until, NULL);
+    }
+    worker_evacuate(worker);
+    rand_bind_stream(NULL);
+    trace_bind(NULL);
+    return NULL;
+}
+
+bool actors_start(struct House* house) {
+    if (!house || house->room_count == 0) return false;
+    int parts = house->config.worker_count;
+    if (parts <= 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        parts = cpus > 0 ? (int)cpus : 1;
+    }
+    if (parts > house->room_count) {
+        parts = house->room_count;
+    }
+    int* assignment = malloc(sizeof(int) * house->room_count);
+    house->workers = calloc(parts, sizeof(struct Worker));
+    if (!assignment || !house->workers) {
+        fprintf(stderr, "Failed to allocate actor workers\n");
+        free(assignment);
+        free(house->workers);
+        house->workers = NULL;
+        return false;
+    }
+    house->worker_count = parts;
+    int cut = actor_partition_rooms(house, parts, assignment);
+
+    int connections = 0;
+    for (int i = 0; i < parts; i++) {
+        house->workers[i].index = i;
+        house->workers[i].house = house;
+    }
+    for (int r = 0; r < house->room_count; r++) {
+        struct Room* room = &house->rooms[r];
+        room->owner = &house->workers[assignment[r]];
+        room->occupancy = room->hunter_count;
+        room->owner->room_count++;
+        connections += room->connection_count;
+    }
+    free(assignment);
+
+    long long now = monotonic_ns();
+    bool placed = true;
+    for (int i = 0; i < house->ghost_count; i++) {
+        struct Ghost* ghost = house->ghosts[i];
+        if (!ghost->is_running) continue;
+        ghost->entity.next_turn_ns = now;
+        placed = placed && worker_adopt(ghost->current_room->owner, &ghost->entity);
+    }
+    for (int i = 0; i < house->hunter_count; i++) {
+        struct Hunter* hunter = house->hunters[i];
+        if (!hunter->is_running) continue;
+        hunter->entity.next_turn_ns = now;
+        placed = placed && worker_adopt(hunter->current_room->owner, &hunter->entity);
+    }
+    if (!placed) return false;
+
+    printf("Actor mode: %d workers over %d rooms, %d of %d connections cross partitions\n",
+           parts, house->room_count, cut, connections / 2);
+
+    for (int i = 0; i < parts; i++) {
+        struct Worker* worker = &house->workers[i];
+        if (pthread_create(&worker->thread, NULL, worker_thread, worker) != 0) {
+            fprintf(stderr, "Failed to create worker thread %d\n", i);
+            return false;
+        }
+        worker->started = true;
+    }
+    return true;
+}
+
+void actors_join(struct House* house) {
+    if (!house || !house->workers) return;
+    for (int i = 0; i < house->worker_count; i++) {
+        if (house->workers[i].started) {
+            pthread_join(house->workers[i].thread, NULL);
+        }
+    }
+    // A hand-over can land after its worker already finished, and workers that
+    // never started still hold their entities
+    for (int i = 0; i < house->worker_count; i++) {
+        worker_evacuate(&house->workers[i]);
+    }
+    for (int r = 0; r < house->room_count; r++) {
+        house->rooms[r].owner = NULL;
+    }
+    for (int i = 0; i < house->worker_count; i++) {
+        struct Worker* worker = &house->workers[i];
+        printf("Worker %d: %d rooms, %ld turns, %ld hand-offs\n",
+               worker->index, worker->room_count, worker->turns, worker->handoffs);
+    }
+}
+
+// Hands every room back to the semaphores without the workers, e.g. in a fork() child
+// where they no longer run. Entities on their way to another partition arrive first.
+void actors_release_rooms(struct House* house) {
+    if (!house || !house->workers) return;
+    for (int i = 0; i < house->worker_count; i++) {
+        struct Entity* pending = __atomic_exchange_n(&house->workers[i].inbox, NULL, __ATOMIC_ACQUIRE);
+        while (pending) {
+            struct Entity* next = pending->next_message;
+            pending->next_message = NULL;
+            room_accept_entity(entity_room(pending), pending);
+            pending = next;
+        }
+    }
+    for (int r = 0; r < house->room_count; r++) {
+        house->rooms[r].owner = NULL;
+    }
+}
+
+void actors_cleanup(struct House* house) {
+    if (!house || !house->workers) return;
+    for (int i = 0; i < house->worker_count; i++) {
+        free(house->workers[i].residents);
+    }
+    free(house->workers);
+    house->workers = NULL;
+    house->worker_count = 0;
+}
@@ -0,0 +1,618 @@
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <time.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include "defs.h"
+#include "helpers.h"
+
+// Batch runs: worker processes claim run numbers from a shared counter, run each
+// simulation single-threaded with its own seed, and fold the outcome into a fixed-size
+// aggregate of counters, Welford moments and t-digests. Every so often a worker sends
+// what it gathered since its last report and starts over; the parent merges those
+// deltas, so memory doesn't grow with the number of runs. With a precision target the
+// parent stops the workers once every tracked rate's interval is narrow enough.
+//
+// Hunters and ghosts of one run share a house and a seed, so their outcomes aren't
+// independent; rates over them are averaged per run and get a t interval over runs.
+// Only the share of runs the hunters won, where the run itself is the trial, uses Wilson.
+// A t interval collapses to nothing while every run agrees, as it does for fear exits
+// that haven't happened yet, so its half-width never drops below the Wilson half-width
+// of the pooled count, and a rate no two runs have disagreed on never counts as converged.
+
+#define TDIGEST_COMPRESSION 200
+#define TDIGEST_CENTROIDS TDIGEST_COMPRESSION  // k1 never keeps more after compressing
+#define TDIGEST_BUFFER 256
+
+#define BATCH_FLUSH_RUNS 64         // a worker reports after this many runs...
+#define BATCH_FLUSH_NS 100000000LL  // ...or this long, whichever comes first
+#define BATCH_MIN_RUNS 30           // fewer runs don't decide convergence
+#define BATCH_Z 1.959964            // two-sided 95% normal quantile
+#define BATCH_T_TABLE 30            // exact Student t quantiles up to this many degrees of freedom
+
+// Running mean and variance (Welford), mergeable with Chan's formula
+struct Moments {
+    long long count;
+    double mean;
+    double m2;
+    double min;
+    double max;
+};
+
+struct Centroid {
+    double mean;
+    double weight;
+};
+
+// Merging t-digest: points collect in the buffer and are folded into the centroids,
+// sorted by mean, whenever it fills up or a quantile is asked for
+struct TDigest {
+    int centroid_count;
+    int buffered;
+    double total;
+    double min;
+    double max;
+    struct Centroid centroids[TDIGEST_CENTROIDS];
+    struct Centroid buffer[TDIGEST_BUFFER];
+};
+
+// Everything a worker sends back; plain data so it can go through a pipe as is
+struct BatchAggregate {
+    long long runs;
+    long long solved_runs;      // every case file reached three unique pieces of evidence
+    long long hunters;
+    long long exits[3];         // hunters leaving for each LogReason
+    long long ghosts;
+    long long identified;       // ghosts whose collected evidence names their real type
+    struct Moments identified_share;    // per run: identified / ghosts
+    struct Moments afraid_share;        // per run: hunters left afraid / hunters
+    struct Moments solve_turns;
+    struct Moments run_turns;
+    struct TDigest solve_digest;
+    struct TDigest turns_digest;
+};
+
+// Shared between the parent and every worker
+struct BatchShared {
+    long long next_run;
+    bool stop;                  // the intervals converged; claim no more runs
+};
+
+// A rate with its 95% interval and how that interval was worked out
+struct Proportion {
+    const char* name;
+    const char* method;
+    double rate;
+    double low;
+    double high;
+    bool varied;                // false while every run gave the same share
+};
+
+static double elapsed_ms(const struct timespec* start, const struct timespec* end) {
+    return (end->tv_sec - start->tv_sec) * 1000.0 + (end->tv_nsec - start->tv_nsec) / 1e6;
+}
+
+static long long monotonic_ns() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long long)now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+static void moments_add(struct Moments* moments, double value) {
+    moments->count++;
+    if (moments->count == 1 || value < moments->min) moments->min = value;
+    if (moments->count == 1 || value > moments->max) moments->max = value;
+    double delta = value - moments->mean;
+    moments->mean += delta / moments->count;
+    moments->m2 += delta * (value - moments->mean);
+}
+
+static void moments_merge(struct Moments* into, const struct Moments* from) {
+    if (from->count == 0) return;
+    if (into->count == 0) {
+        *into = *from;
+        return;
+    }
+    long long count = into->count + from->count;
+    double delta = from->mean - into->mean;
+    into->mean += delta * from->count / count;
+    into->m2 += from->m2 + delta * delta * ((double)into->count * from->count / count);
+    if (from->min < into->min) into->min = from->min;
+    if (from->max > into->max) into->max = from->max;
+    into->count = count;
+}
+
+static double moments_sd(const struct Moments* moments) {
+    return moments->count > 1 ? sqrt(moments->m2 / (moments->count - 1)) : 0.0;
+}
+
+static int compare_centroids(const void* a, const void* b) {
+    double x = ((const struct Centroid*)a)->mean;
+    double y = ((const struct Centroid*)b)->mean;
+    return (x > y) - (x < y);
+}
+
+// The k1 scale function: centroids near the tails cover less of the distribution
+static double tdigest_scale(double q) {
+    return TDIGEST_COMPRESSION / (2.0 * M_PI) * asin(2.0 * q - 1.0);
+}
+
+static void tdigest_compress(struct TDigest* digest) {
+    if (digest->buffered == 0) return;
+    struct Centroid all[TDIGEST_CENTROIDS + TDIGEST_BUFFER];
+    int count = digest->centroid_count;
+    memcpy(all, digest->centroids, (size_t)count * sizeof(struct Centroid));
+    memcpy(all + count, digest->buffer, (size_t)digest->buffered * sizeof(struct Centroid));
+    count += digest->buffered;
+    digest->buffered = 0;
+    qsort(all, count, sizeof(struct Centroid), compare_centroids);
+
+    // Neighbours merge while the merged centroid spans at most one unit of k
+    int out = 0;
+    double before = 0.0;
+    struct Centroid current = all[0];
+    for (int i = 1; i < count; i++) {
+        double weight = current.weight + all[i].weight;
+        bool fits = tdigest_scale((before + weight) / digest->total) -
+                    tdigest_scale(before / digest->total) <= 1.0;
+        if (fits || out == TDIGEST_CENTROIDS - 1) {
+            current.mean += (all[i].mean - current.mean) * all[i].weight / weight;
+            current.weight = weight;
+        } else {
+            digest->centroids[out++] = current;
+            before += current.weight;
+            current = all[i];
+        }
+    }
+    digest->centroids[out++] = current;
+    digest->centroid_count = out;
+}
+
+static void tdigest_add_weighted(struct TDigest* digest, double value, double weight) {
+    if (digest->total == 0.0 || value < digest->min) digest->min = value;
+    if (digest->total == 0.0 || value > digest->max) digest->max = value;
+    digest->total += weight;
+    digest->buffer[digest->buffered].mean = value;
+    digest->buffer[digest->buffered].weight = weight;
+    if (++digest->buffered == TDIGEST_BUFFER) {
+        tdigest_compress(digest);
+    }
+}
+
+static void tdigest_merge(struct TDigest* into, struct TDigest* from) {
+    tdigest_compress(from);
+    double min = from->min;
+    double max = from->max;
+    for (int i = 0; i < from->centroid_count; i++) {
+        tdigest_add_weighted(into, from->centroids[i].mean, from->centroids[i].weight);
+    }
+    if (from->total > 0.0) {
+        if (min < into->min) into->min = min;
+        if (max > into->max) into->max = max;
+    }
+}
+
+// Interpolates between centroid centres, and towards the exact min and max at the ends
+static double tdigest_quantile(struct TDigest* digest, double q) {
+    tdigest_compress(digest);
+    if (digest->centroid_count == 0) return 0.0;
+    const struct Centroid* centroids = digest->centroids;
+    int count = digest->centroid_count;
+    double target = q * digest->total;
+    double centre = centroids[0].weight / 2.0;
+    if (target <= centre) {
+        return digest->min + (centroids[0].mean - digest->min) * (centre > 0.0 ? target / centre : 0.0);
+    }
+    for (int i = 0; i + 1 < count; i++) {
+        double next = centre + (centroids[i].weight + centroids[i + 1].weight) / 2.0;
+        if (target <= next) {
+            double fraction = (target - centre) / (next - centre);
+            return centroids[i].mean + (centroids[i + 1].mean - centroids[i].mean) * fraction;
+        }
+        centre = next;
+    }
+    double tail = digest->total - centre;
+    double fraction = tail > 0.0 ? (target - centre) / tail : 1.0;
+    return centroids[count - 1].mean + (digest->max - centroids[count - 1].mean) * fraction;
+}
+
+static void aggregate_merge(struct BatchAggregate* into, struct BatchAggregate* from) {
+    into->runs += from->runs;
+    into->solved_runs += from->solved_runs;
+    into->hunters += from->hunters;
+    for (int i = 0; i < 3; i++) {
+        into->exits[i] += from->exits[i];
+    }
+    into->ghosts += from->ghosts;
+    into->identified += from->identified;
+    moments_merge(&into->identified_share, &from->identified_share);
+    moments_merge(&into->afraid_share, &from->afraid_share);
+    moments_merge(&into->solve_turns, &from->solve_turns);
+    moments_merge(&into->run_turns, &from->run_turns);
+    tdigest_merge(&into->solve_digest, &from->solve_digest);
+    tdigest_merge(&into->turns_digest, &from->turns_digest);
+}
+
+// One whole simulation on this thread; false when its house couldn't be built
+static bool batch_run_one(struct SimConfig config, long long run, BatchHouseFactory create,
+                          const void* context, struct BatchAggregate* aggregate) {
+    config.seed = rand_stream_seed(config.seed, (int)run);
+    struct House* house = create(&config, context);
+    if (!house) return false;
+    for (int i = 0; i < house->hunter_count; i++) {
+        house_hunter_started(house);
+    }
+    for (int i = 0; i < house->ghost_count; i++) {
+        house_ghost_started(house);
+    }
+    long turns = house->hunter_count > 0 ? house_run_inline(house) : 0;
+
+    int solved_turn = -1;
+    for (int i = 0; i < house->ghost_count; i++) {
+        const struct CaseFile* case_file = &house->ghosts[i]->case_file;
+        if (!case_file->solved) {
+            solved_turn = -1;
+            break;
+        }
+        if (case_file->solved_turn > solved_turn) {
+            solved_turn = case_file->solved_turn;
+        }
+    }
+    int afraid = 0;
+    for (int i = 0; i < house->hunter_count; i++) {
+        enum LogReason reason = house->hunters[i]->exit_reason;
+        if (reason >= LR_EVIDENCE && reason <= LR_AFRAID) {
+            aggregate->exits[reason]++;
+        }
+        afraid += reason == LR_AFRAID;
+    }
+    int identified = 0;
+    for (int i = 0; i < house->ghost_count; i++) {
+        const struct Ghost* ghost = house->ghosts[i];
+        identified += evidence_identify_ghost(ghost->case_file.collected) == ghost->type;
+    }
+    aggregate->identified += identified;
+    if (house->ghost_count > 0) {
+        moments_add(&aggregate->identified_share, (double)identified / house->ghost_count);
+    }
+    if (house->hunter_count > 0) {
+        moments_add(&aggregate->afraid_share, (double)afraid / house->hunter_count);
+    }
+    aggregate->runs++;
+    aggregate->hunters += house->hunter_count;
+    aggregate->ghosts += house->ghost_count;
+    if (solved_turn >= 0) {
+        aggregate->solved_runs++;
+        moments_add(&aggregate->solve_turns, solved_turn);
+        tdigest_add_weighted(&aggregate->solve_digest, solved_turn, 1.0);
+    }
+    moments_add(&aggregate->run_turns, turns);
+    tdigest_add_weighted(&aggregate->turns_digest, turns, 1.0);
+    house_cleanup(house);
+    return true;
+}
+
+// Sends everything gathered since the last report and starts the aggregate over
+static bool send_aggregate(int fd, struct BatchAggregate* aggregate) {
+    tdigest_compress(&aggregate->solve_digest);
+    tdigest_compress(&aggregate->turns_digest);
+    const char* data = (const char*)aggregate;
+    size_t left = sizeof(*aggregate);
+    while (left > 0) {
+        ssize_t written = write(fd, data, left);
+        if (written < 0 && errno == EINTR) continue;
+        if (written <= 0) return false;
+        data += written;
+        left -= (size_t)written;
+    }
+    memset(aggregate, 0, sizeof(*aggregate));
+    return true;
+}
+
+static void batch_worker(const struct SimConfig* config, long long runs, BatchHouseFactory create,
+                         const void* context, struct BatchShared* shared, int result_fd) {
+    // Building a house narrates every step; the parent prints the summary instead
+    if (!freopen("/dev/null", "w", stdout)) {
+        fclose(stdout);
+    }
+    log_set_console(false);
+    log_set_files(false);
+    log_set_pacing(false);
+
+    struct BatchAggregate* aggregate = calloc(1, sizeof(struct BatchAggregate));
+    if (!aggregate) {
+        close(result_fd);
+        return;
+    }
+    long long flushed_ns = monotonic_ns();
+    while (!__atomic_load_n(&shared->stop, __ATOMIC_ACQUIRE)) {
+        long long run = __atomic_fetch_add(&shared->next_run, 1, __ATOMIC_RELAXED);
+        if (run >= runs || !batch_run_one(*config, run, create, context, aggregate)) break;
+        if (aggregate->runs >= BATCH_FLUSH_RUNS || monotonic_ns() - flushed_ns >= BATCH_FLUSH_NS) {
+            if (!send_aggregate(result_fd, aggregate)) break;
+            flushed_ns = monotonic_ns();
+        }
+    }
+    if (aggregate->runs > 0) {
+        send_aggregate(result_fd, aggregate);
+    }
+    close(result_fd);
+    free(aggregate);
+}
+
+// Returns the bytes read: the whole aggregate, 0 once the worker closed its pipe, or
+// anything in between when it died halfway through a report
+static size_t read_aggregate(int fd, struct BatchAggregate* aggregate) {
+    char* data = (char*)aggregate;
+    size_t got = 0;
+    while (got < sizeof(*aggregate)) {
+        ssize_t n = read(fd, data + got, sizeof(*aggregate) - got);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        got += (size_t)n;
+    }
+    return got;
+}
+
+// Wilson score interval; unlike the normal approximation it stays inside [0, 1] and
+// keeps its coverage for rates near 0 or 1
+static struct Proportion wilson_interval(const char* name, long long successes, long long trials) {
+    struct Proportion rate = { name, "Wilson", 0.0, 0.0, 1.0, true };
+    if (trials == 0) return rate;
+    double n = (double)trials;
+    double p = successes / n;
+    double z2 = BATCH_Z * BATCH_Z;
+    double denominator = 1.0 + z2 / n;
+    double centre = (p + z2 / (2.0 * n)) / denominator;
+    double half = BATCH_Z * sqrt(p * (1.0 - p) / n + z2 / (4.0 * n * n)) / denominator;
+    rate.rate = p;
+    rate.low = centre - half > 0.0 ? centre - half : 0.0;
+    rate.high = centre + half < 1.0 ? centre + half : 1.0;
+    return rate;
+}
+
+// Two-sided 95% Student t quantile; past the table the Cornish-Fisher expansion is
+// within 0.001 of it
+static double t_quantile(long long degrees) {
+    static const double table[BATCH_T_TABLE] = {
+        12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+        2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+        2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042,
+    };
+    if (degrees <= BATCH_T_TABLE) return table[degrees - 1];
+    double z = BATCH_Z;
+    double z3 = z * z * z;
+    double z5 = z3 * z * z;
+    double z7 = z5 * z * z;
+    double v = (double)degrees;
+    return z + (z3 + z) / (4.0 * v) + (5.0 * z5 + 16.0 * z3 + 3.0 * z) / (96.0 * v * v) +
+           (3.0 * z7 + 19.0 * z5 + 17.0 * z3 - 15.0 * z) / (384.0 * v * v * v);
+}
+
+// Mean of a per-run share with a t interval over runs, so the run is the sampling unit.
+// The pooled successes and trials only set the smallest half-width it may claim.
+static struct Proportion run_interval(const char* name, const struct Moments* shares, long long successes,
+                                      long long trials) {
+    struct Proportion rate = { name, "t over runs", shares->mean, 0.0, 1.0, false };
+    if (shares->count < 2) return rate;
+    rate.varied = shares->max > shares->min;
+    double half = t_quantile(shares->count - 1) * moments_sd(shares) / sqrt((double)shares->count);
+    struct Proportion pooled = wilson_interval(name, successes, trials);
+    if ((pooled.high - pooled.low) / 2.0 > half) {
+        half = (pooled.high - pooled.low) / 2.0;
+        rate.method = "t, Wilson floor";
+    }
+    rate.low = shares->mean - half > 0.0 ? shares->mean - half : 0.0;
+    rate.high = shares->mean + half < 1.0 ? shares->mean + half : 1.0;
+    return rate;
+}
+
+// The outcomes the stopping rule watches
+static int tracked_rates(const struct BatchAggregate* total, struct Proportion rates[3]) {
+    rates[0] = run_interval("Ghosts correctly identified", &total->identified_share, total->identified,
+                            total->ghosts);
+    rates[1] = wilson_interval("Hunters won (3 unique)", total->solved_runs, total->runs);
+    rates[2] = run_interval("Hunters left afraid", &total->afraid_share, total->exits[LR_AFRAID],
+                            total->hunters);
+    return 3;
+}
+
+static bool batch_converged(const struct BatchAggregate* total, double precision) {
+    if (total->runs < BATCH_MIN_RUNS) return false;
+    struct Proportion rates[3];
+    int count = tracked_rates(total, rates);
+    for (int i = 0; i < count; i++) {
+        if (!rates[i].varied || (rates[i].high - rates[i].low) / 2.0 > precision) return false;
+    }
+    return true;
+}
+
+static void print_distribution(const char* name, const struct Moments* moments, struct TDigest* digest) {
+    if (moments->count == 0) {
+        printf("%-22s %8d %9s\n", name, 0, "-");
+        return;
+    }
+    printf("%-22s %8lld %9.1f %8.1f %8.0f %8.1f %8.1f %8.1f %8.0f\n", name, moments->count, moments->mean,
+           moments_sd(moments), moments->min, tdigest_quantile(digest, 0.5), tdigest_quantile(digest, 0.9),
+           tdigest_quantile(digest, 0.99), moments->max);
+}
+
+static double share(long long part, long long whole) {
+    return whole > 0 ? 100.0 * part / whole : 0.0;
+}
+
+static void batch_report(struct BatchAggregate* total, int workers, double ms, long long budget,
+                         double precision, long long converged_at) {
+    printf("\n--- Batch Results ---\n");
+    printf("Runs: %lld in %.2f s on %d worker processes (%.1f runs/s)\n", total->runs, ms / 1000.0, workers,
+           ms > 0.0 ? total->runs * 1000.0 / ms : 0.0);
+    if (precision > 0.0 && converged_at > 0) {
+        printf("Intervals within +/-%.2f%% after %lld runs of a %lld run budget; %lld more were already under way\n",
+               precision * 100.0, converged_at, budget, total->runs - converged_at);
+    } else if (precision > 0.0) {
+        printf("Run budget of %lld spent before every interval was within +/-%.2f%%\n", budget, precision * 100.0);
+        struct Proportion rates[3];
+        int count = tracked_rates(total, rates);
+        for (int i = 0; i < count; i++) {
+            if (!rates[i].varied) {
+                printf("%s: every run gave the same share, which doesn't count as converged\n", rates[i].name);
+            }
+        }
+    }
+    printf("Hunter exits: evidence=%lld (%.1f%%) bored=%lld (%.1f%%) afraid=%lld (%.1f%%)\n",
+           total->exits[LR_EVIDENCE], share(total->exits[LR_EVIDENCE], total->hunters),
+           total->exits[LR_BORED], share(total->exits[LR_BORED], total->hunters),
+           total->exits[LR_AFRAID], share(total->exits[LR_AFRAID], total->hunters));
+    printf("\n%-22s %8s %9s %8s %8s %8s %8s %8s %8s\n", "", "runs", "mean", "sd", "min", "p50", "p90", "p99",
+           "max");
+    print_distribution("Turns to solve", &total->solve_turns, &total->solve_digest);
+    print_distribution("Run length (turns)", &total->run_turns, &total->turns_digest);
+
+    struct Proportion rates[3];
+    int count = tracked_rates(total, rates);
+    printf("\n%-28s %8s %17s %8s  %s\n", "", "rate", "95% interval", "+/-", "method");
+    for (int i = 0; i < count; i++) {
+        printf("%-28s %7.2f%% [%6.2f%%, %6.2f%%] %7.2f%%  %s%s\n", rates[i].name, rates[i].rate * 100.0,
+               rates[i].low * 100.0, rates[i].high * 100.0, (rates[i].high - rates[i].low) * 50.0, rates[i].method,
+               rates[i].varied ? "" : ", every run equal");
+    }
+    printf("\nAggregate state: %zu bytes per worker, whatever the number of runs\n", sizeof(struct BatchAggregate));
+}
+
+// Forks the workers, merges their reports as they come and prints the result. With a
+// precision above 0, runs is only a budget: the workers stop claiming runs once every
+// tracked rate is known to within +/- precision. Has to run before this process starts
+// any thread of its own.
+bool batch_run(const struct SimConfig* config, long long runs, int workers, double precision,
+               BatchHouseFactory create, const void* context) {
+    if (!config || !create || runs < 1) return false;
+    if (workers < 1) {
+        long online = sysconf(_SC_NPROCESSORS_ONLN);
+        workers = online > 0 ? (int)online : 1;
+    }
+    if (workers > runs) workers = (int)runs;
+
+    struct BatchShared* shared = mmap(NULL, sizeof(struct BatchShared), PROT_READ | PROT_WRITE,
+                                      MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    pid_t* pids = calloc(workers, sizeof(pid_t));
+    int* result_fds = calloc(workers, sizeof(int));
+    struct pollfd* polls = calloc(workers, sizeof(struct pollfd));
+    struct BatchAggregate* total = calloc(1, sizeof(struct BatchAggregate));
+    struct BatchAggregate* received = calloc(1, sizeof(struct BatchAggregate));
+    if (shared == MAP_FAILED || !pids || !result_fds || !polls || !total || !received) {
+        fprintf(stderr, "Failed to allocate a batch of %d workers\n", workers);
+        if (shared != MAP_FAILED) munmap(shared, sizeof(struct BatchShared));
+        free(pids);
+        free(result_fds);
+        free(polls);
+        free(total);
+        free(received);
+        return false;
+    }
+    shared->next_run = 0;
+    shared->stop = false;
+
+    if (precision > 0.0) {
+        printf("Batch: up to %lld runs of seed %u on %d worker processes, until every rate is within +/-%.2f%%\n",
+               runs, config->seed, workers, precision * 100.0);
+    } else {
+        printf("Batch: %lld runs of seed %u on %d worker processes\n", runs, config->seed, workers);
+    }
+    struct timespec began;
+    clock_gettime(CLOCK_MONOTONIC, &began);
+    fflush(stdout);
+    fflush(stderr);
+    int started = 0;
+    for (int w = 0; w < workers; w++) {
+        int fds[2];
+        if (pipe(fds) != 0) {
+            perror("Failed to create batch pipe");
+            break;
+        }
+        pid_t pid = fork();
+        if (pid < 0) {
+            perror("Failed to fork batch worker");
+            close(fds[0]);
+            close(fds[1]);
+            break;
+        }
+        if (pid == 0) {
+            close(fds[0]);
+            for (int i = 0; i < started; i++) {
+                close(result_fds[i]);
+            }
+            batch_worker(config, runs, create, context, shared, fds[1]);
+            _exit(EXIT_SUCCESS);
+        }
+        close(fds[1]);
+        pids[started] = pid;
+        result_fds[started] = fds[0];
+        started++;
+    }
+
+    // Merge reports in whatever order the workers send them until every pipe closes
+    bool complete = started > 0;
+    long long converged_at = 0;
+    int open_pipes = started;
+    for (int w = 0; w < started; w++) {
+        polls[w].fd = result_fds[w];
+        polls[w].events = POLLIN;
+    }
+    while (open_pipes > 0) {
+        if (poll(polls, started, -1) < 0) {
+            if (errno == EINTR) continue;
+            perror("Failed to wait for batch workers");
+            complete = false;
+            break;
+        }
+        for (int w = 0; w < started; w++) {
+            if (polls[w].fd < 0 || !(polls[w].revents & (POLLIN | POLLHUP | POLLERR))) continue;
+            size_t got = read_aggregate(result_fds[w], received);
+            if (got < sizeof(*received)) {
+                if (got > 0) {
+                    fprintf(stderr, "Batch worker %d ended in the middle of a report\n", w);
+                    complete = false;
+                }
+                polls[w].fd = -1;
+                open_pipes--;
+                continue;
+            }
+            aggregate_merge(total, received);
+            if (precision > 0.0 && converged_at == 0 && batch_converged(total, precision)) {
+                converged_at = total->runs;
+                __atomic_store_n(&shared->stop, true, __ATOMIC_RELEASE);
+            }
+        }
+    }
+    for (int w = 0; w < started; w++) {
+        close(result_fds[w]);
+        int status = 0;
+        while (waitpid(pids[w], &status, 0) < 0 && errno == EINTR) {}
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS) {
+            fprintf(stderr, "Batch worker %d failed\n", w);
+            complete = false;
+        }
+    }
+    struct timespec ended;
+    clock_gettime(CLOCK_MONOTONIC, &ended);
+    if (converged_at == 0 && total->runs < runs) {
+        fprintf(stderr, "Only %lld of %lld runs finished\n", total->runs, runs);
+        complete = false;
+    }
+    batch_report(total, started, elapsed_ms(&began, &ended), runs, precision, converged_at);
+
+    munmap(shared, sizeof(struct BatchShared));
+    free(pids);
+    free(result_fds);
+    free(polls);
+    free(total);
+    free(received);
+    return complete;
+}
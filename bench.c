@@ -0,0 +1,554 @@
+#define _GNU_SOURCE     // CPU_SET and pthread_setaffinity_np for pinning
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+#include "defs.h"
+#include "helpers.h"
+
+// Microbenchmarks of the primitives every turn goes through. Each one runs for a
+// number of warmup and measured repetitions at 1, 2, 4, ... threads; a repetition
+// starts fresh threads behind a barrier so they hit the primitive together.
+
+#define BENCH_DEFAULT_OPS 200000L
+#define BENCH_DEFAULT_REPS 5
+#define BENCH_DEFAULT_WARMUP 1
+#define BENCH_SAMPLE_EVERY 16           // time one op in this many for the latency percentiles
+#define BENCH_LOG_LINE_LIMIT 90000L     // write_log_record stops the program at 100000 lines a thread
+
+struct BenchOptions {
+    int max_threads;
+    long ops;               // operations per thread and repetition
+    int reps;
+    int warmup;
+    bool pin;
+    const char* only;       // run just this benchmark, or NULL for all of them
+    const char* json;       // where to write the results, "-" for stdout, or NULL
+};
+
+// What the benchmarks share; set up once with one hunter per possible thread
+struct BenchState {
+    struct House* house;
+    struct Room* from;
+    struct Room* to;
+    struct CaseFile case_file;
+    const enum EvidenceType* evidence;
+    int evidence_count;
+    char log_dir[32];
+};
+
+struct BenchWorker {
+    struct BenchState* state;
+    const struct Bench* bench;
+    pthread_barrier_t* barrier;
+    int index;
+    long ops;
+    bool pin;
+    bool pinned;
+    unsigned rng_state;
+    struct RoomStack stack;
+    long long* samples;
+    long sample_count;
+    struct timespec start;
+    struct timespec end;
+};
+
+struct Bench {
+    const char* name;
+    const char* op;             // what one operation is
+    long ops_divisor;           // slow primitives run this many times fewer operations
+    bool (*setup)(struct BenchState* state);
+    void (*run)(struct BenchWorker* worker, long i);
+    void (*teardown)(struct BenchState* state, int threads);
+};
+
+struct BenchResult {
+    const struct Bench* bench;
+    int threads;
+    long ops;
+    double* throughput;         // operations per second of each measured repetition
+    long long latency[5];       // p50, p90, p99, p99.9 and max in ns
+    bool pinned;
+};
+
+static const char* latency_names[5] = {"p50", "p90", "p99", "p999", "max"};
+
+static long long timespec_ns(const struct timespec* time) {
+    return (long long)time->tv_sec * 1000000000LL + time->tv_nsec;
+}
+
+static long long now_ns() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return timespec_ns(&now);
+}
+
+static int compare_long_long(const void* a, const void* b) {
+    long long x = *(const long long*)a;
+    long long y = *(const long long*)b;
+    return (x > y) - (x < y);
+}
+
+static int compare_double(const void* a, const void* b) {
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+static bool setup_nothing(struct BenchState* state) {
+    (void)state;
+    return true;
+}
+
+static void teardown_nothing(struct BenchState* state, int threads) {
+    (void)state;
+    (void)threads;
+}
+
+// Every thread moves its own hunter back and forth between the same two rooms
+static void run_room_move(struct BenchWorker* worker, long i) {
+    (void)i;
+    struct Hunter* hunter = worker->state->house->hunters[worker->index];
+    struct Room* to = hunter->current_room == worker->state->from ? worker->state->to : worker->state->from;
+    room_move_entity(hunter->current_room, to, hunter);
+}
+
+static void run_room_evidence(struct BenchWorker* worker, long i) {
+    struct BenchState* state = worker->state;
+    enum EvidenceType evidence = state->evidence[i % state->evidence_count];
+    room_add_evidence(state->to, 0, evidence);
+    room_remove_evidence(state->to, 0, evidence);
+}
+
+static bool setup_casefile(struct BenchState* state) {
+    casefile_cleanup(&state->case_file);
+    casefile_init(&state->case_file);
+    return true;
+}
+
+static void run_casefile(struct BenchWorker* worker, long i) {
+    struct BenchState* state = worker->state;
+    casefile_add_evidence(&state->case_file, state->evidence[i % state->evidence_count], (int)i);
+    casefile_is_solved(&state->case_file);
+}
+
+static void run_rand(struct BenchWorker* worker, long i) {
+    (void)worker;
+    (void)i;
+    rand_int_threadsafe(0, 100);
+}
+
+static void run_roomstack(struct BenchWorker* worker, long i) {
+    (void)i;
+    roomstack_push(&worker->stack, worker->state->to);
+    roomstack_pop(&worker->stack);
+}
+
+// Lines go to one file per thread in a scratch directory, as they would per hunter
+static bool setup_log(struct BenchState* state) {
+    snprintf(state->log_dir, sizeof(state->log_dir), "/tmp/ghost_bench.XXXXXX");
+    if (!mkdtemp(state->log_dir)) {
+        perror("Failed to create a scratch directory for log files");
+        return false;
+    }
+    char prefix[40];
+    snprintf(prefix, sizeof(prefix), "%s/", state->log_dir);
+    log_set_prefix(prefix);
+    log_set_files(true);
+    return true;
+}
+
+static void run_log(struct BenchWorker* worker, long i) {
+    (void)i;
+    log_move(worker->index + 1, 0, 0, worker->state->from->name, worker->state->to->name, EV_EMF);
+}
+
+static void teardown_log(struct BenchState* state, int threads) {
+    log_set_files(false);
+    log_set_prefix(NULL);
+    for (int t = 0; t < threads; t++) {
+        char path[64];
+        snprintf(path, sizeof(path), "%s/log_%d.csv", state->log_dir, t + 1);
+        unlink(path);
+    }
+    rmdir(state->log_dir);
+}
+
+static const struct Bench benches[] = {
+    {"room_move_entity", "one move between two shared rooms", 1, setup_nothing, run_room_move, teardown_nothing},
+    {"room_evidence", "room_add_evidence + room_remove_evidence", 1, setup_nothing, run_room_evidence, teardown_nothing},
+    {"casefile", "casefile_add_evidence + casefile_is_solved", 1, setup_casefile, run_casefile, teardown_nothing},
+    {"rand_int_threadsafe", "one draw from the thread's stream", 1, setup_nothing, run_rand, teardown_nothing},
+    {"roomstack", "roomstack_push + roomstack_pop", 1, setup_nothing, run_roomstack, teardown_nothing},
+    {"write_log_record", "one log line through log_move", 20, setup_log, run_log, teardown_log},
+};
+#define BENCH_COUNT ((int)(sizeof(benches) / sizeof(benches[0])))
+
+static void* bench_worker(void* arg) {
+    struct BenchWorker* worker = arg;
+    if (worker->pin) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(worker->index % (cpus > 0 ? cpus : 1), &set);
+        worker->pinned = pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+    }
+    worker->rng_state = rand_stream_seed(1, worker->index);
+    rand_bind_stream(&worker->rng_state);
+    roomstack_init(&worker->stack);
+    void (*run)(struct BenchWorker*, long) = worker->bench->run;
+
+    pthread_barrier_wait(worker->barrier);
+    clock_gettime(CLOCK_MONOTONIC, &worker->start);
+    for (long i = 0; i < worker->ops; i++) {
+        if (i % BENCH_SAMPLE_EVERY == 0) {
+            long long began = now_ns();
+            run(worker, i);
+            worker->samples[worker->sample_count++] = now_ns() - began;
+        } else {
+            run(worker, i);
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &worker->end);
+
+    roomstack_clear(&worker->stack);
+    rand_bind_stream(NULL);
+    return NULL;
+}
+
+// One repetition; returns operations per second, or a negative value on failure.
+// Latency samples are appended to samples when it isn't NULL.
+static double bench_repetition(struct BenchState* state, const struct Bench* bench, int threads, long ops,
+                               bool pin, long long* samples, long* sample_count, bool* pinned) {
+    struct BenchWorker* workers = calloc(threads, sizeof(struct BenchWorker));
+    pthread_t* handles = calloc(threads, sizeof(pthread_t));
+    long per_thread_samples = ops / BENCH_SAMPLE_EVERY + 1;
+    long long* scratch = calloc((size_t)threads * per_thread_samples, sizeof(long long));
+    if (!workers || !handles || !scratch) {
+        free(workers);
+        free(handles);
+        free(scratch);
+        return -1;
+    }
+    pthread_barrier_t barrier;
+    pthread_barrier_init(&barrier, NULL, threads);
+    int started = 0;
+    for (int t = 0; t < threads; t++) {
+        workers[t] = (struct BenchWorker){
+            .state = state,
+            .bench = bench,
+            .barrier = &barrier,
+            .index = t,
+            .ops = ops,
+            .pin = pin,
+            .samples = scratch + (size_t)t * per_thread_samples,
+        };
+        if (pthread_create(&handles[t], NULL, bench_worker, &workers[t]) != 0) break;
+        started++;
+    }
+    if (started < threads) {
+        // The started workers wait at the barrier forever; nothing sensible to do but stop
+        fprintf(stderr, "Failed to start %d benchmark threads\n", threads);
+        exit(EXIT_FAILURE);
+    }
+
+    long long first_start = 0;
+    long long last_end = 0;
+    for (int t = 0; t < threads; t++) {
+        pthread_join(handles[t], NULL);
+        long long start = timespec_ns(&workers[t].start);
+        long long end = timespec_ns(&workers[t].end);
+        if (t == 0 || start < first_start) first_start = start;
+        if (end > last_end) last_end = end;
+        if (pinned && !workers[t].pinned) *pinned = false;
+        if (samples) {
+            memcpy(samples + *sample_count, workers[t].samples, workers[t].sample_count * sizeof(long long));
+            *sample_count += workers[t].sample_count;
+        }
+    }
+    pthread_barrier_destroy(&barrier);
+    free(workers);
+    free(handles);
+    free(scratch);
+
+    long long elapsed = last_end - first_start;
+    return elapsed > 0 ? (double)ops * threads * 1e9 / (double)elapsed : 0.0;
+}
+
+static bool bench_run(struct BenchState* state, const struct Bench* bench, int threads,
+                      const struct BenchOptions* options, struct BenchResult* result) {
+    long ops = options->ops / bench->ops_divisor;
+    if (ops < 1) ops = 1;
+    if (bench->run == run_log && ops > BENCH_LOG_LINE_LIMIT) ops = BENCH_LOG_LINE_LIMIT;
+
+    memset(result, 0, sizeof(*result));
+    result->bench = bench;
+    result->threads = threads;
+    result->ops = ops;
+    result->pinned = options->pin;
+    result->throughput = calloc(options->reps, sizeof(double));
+    long long* samples = calloc((size_t)options->reps * threads * (ops / BENCH_SAMPLE_EVERY + 1), sizeof(long long));
+    if (!result->throughput || !samples) {
+        free(samples);
+        return false;
+    }
+    long sample_count = 0;
+    bool ok = bench->setup(state);
+    for (int r = 0; ok && r < options->warmup; r++) {
+        ok = bench_repetition(state, bench, threads, ops, options->pin, NULL, NULL, NULL) >= 0;
+    }
+    for (int r = 0; ok && r < options->reps; r++) {
+        result->throughput[r] = bench_repetition(state, bench, threads, ops, options->pin,
+                                                 samples, &sample_count, &result->pinned);
+        ok = result->throughput[r] >= 0;
+    }
+    bench->teardown(state, threads);
+
+    if (ok && sample_count > 0) {
+        qsort(samples, sample_count, sizeof(long long), compare_long_long);
+        const double ranks[4] = {0.50, 0.90, 0.99, 0.999};
+        for (int p = 0; p < 4; p++) {
+            result->latency[p] = samples[(long)(ranks[p] * (sample_count - 1))];
+        }
+        result->latency[4] = samples[sample_count - 1];
+    }
+    free(samples);
+    return ok;
+}
+
+// Median, minimum and maximum of the measured repetitions
+static void throughput_summary(const struct BenchResult* result, int reps, double summary[3]) {
+    double* sorted = malloc(reps * sizeof(double));
+    if (!sorted) {
+        summary[0] = summary[1] = summary[2] = 0;
+        return;
+    }
+    memcpy(sorted, result->throughput, reps * sizeof(double));
+    qsort(sorted, reps, sizeof(double), compare_double);
+    summary[0] = reps % 2 ? sorted[reps / 2] : (sorted[reps / 2 - 1] + sorted[reps / 2]) / 2;
+    summary[1] = sorted[0];
+    summary[2] = sorted[reps - 1];
+    free(sorted);
+}
+
+// How much of a latency sample is the clock itself
+static long long timer_overhead_ns() {
+    long long best = -1;
+    for (int i = 0; i < 1000; i++) {
+        long long began = now_ns();
+        long long ended = now_ns();
+        if (best < 0 || ended - began < best) best = ended - began;
+    }
+    return best;
+}
+
+static bool write_json(const char* path, const struct BenchOptions* options, const struct BenchResult* results,
+                       int count, long long timer_ns) {
+    FILE* out = strcmp(path, "-") == 0 ? stdout : fopen(path, "w");
+    if (!out) {
+        perror("Failed to open the JSON output");
+        return false;
+    }
+    fprintf(out, "{\n");
+    fprintf(out, "  \"online_cpus\": %ld,\n", sysconf(_SC_NPROCESSORS_ONLN));
+    fprintf(out, "  \"reps\": %d,\n  \"warmup\": %d,\n  \"pin\": %s,\n", options->reps, options->warmup,
+            options->pin ? "true" : "false");
+    fprintf(out, "  \"sample_every\": %d,\n  \"timer_overhead_ns\": %lld,\n", BENCH_SAMPLE_EVERY, timer_ns);
+    fprintf(out, "  \"results\": [\n");
+    for (int i = 0; i < count; i++) {
+        const struct BenchResult* result = &results[i];
+        double summary[3];
+        throughput_summary(result, options->reps, summary);
+        fprintf(out, "    {\"name\": \"%s\", \"op\": \"%s\", \"threads\": %d, \"ops_per_thread\": %ld, "
+                     "\"pinned\": %s,\n",
+                result->bench->name, result->bench->op, result->threads, result->ops,
+                result->pinned ? "true" : "false");
+        fprintf(out, "     \"ops_per_sec\": {\"median\": %.1f, \"min\": %.1f, \"max\": %.1f, \"reps\": [",
+                summary[0], summary[1], summary[2]);
+        for (int r = 0; r < options->reps; r++) {
+            fprintf(out, "%s%.1f", r ? ", " : "", result->throughput[r]);
+        }
+        fprintf(out, "]},\n     \"latency_ns\": {");
+        for (int p = 0; p < 5; p++) {
+            fprintf(out, "%s\"%s\": %lld", p ? ", " : "", latency_names[p], result->latency[p]);
+        }
+        fprintf(out, "}}%s\n", i + 1 < count ? "," : "");
+    }
+    fprintf(out, "  ]\n}\n");
+    if (out != stdout) fclose(out);
+    return true;
+}
+
+static void print_usage(const char* program) {
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  --threads N       Run at 1, 2, 4, ... up to N threads (default one per online CPU)\n"
+            "  --ops N           Operations per thread and repetition (default %ld)\n"
+            "  --reps N          Measured repetitions (default %d)\n"
+            "  --warmup N        Unmeasured repetitions before them (default %d)\n"
+            "  --no-pin          Don't pin thread i to CPU i\n"
+            "  --only NAME       Run one benchmark: room_move_entity, room_evidence, casefile,\n"
+            "                    rand_int_threadsafe, roomstack or write_log_record\n"
+            "  --json FILE       Write the results as JSON to FILE, or to stdout for '-'\n",
+            program, BENCH_DEFAULT_OPS, BENCH_DEFAULT_REPS, BENCH_DEFAULT_WARMUP);
+}
+
+static bool parse_arguments(int argc, char* argv[], struct BenchOptions* options) {
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* value = (i + 1 < argc) ? argv[i + 1] : NULL;
+        if (strcmp(arg, "--threads") == 0 && value) {
+            options->max_threads = atoi(value);
+            if (options->max_threads < 1) {
+                fprintf(stderr, "--threads needs a positive count\n");
+                return false;
+            }
+            i++;
+        } else if (strcmp(arg, "--ops") == 0 && value) {
+            options->ops = atol(value);
+            if (options->ops < 1) {
+                fprintf(stderr, "--ops needs a positive count\n");
+                return false;
+            }
+            i++;
+        } else if (strcmp(arg, "--reps") == 0 && value) {
+            options->reps = atoi(value);
+            if (options->reps < 1) {
+                fprintf(stderr, "--reps needs a positive count\n");
+                return false;
+            }
+            i++;
+        } else if (strcmp(arg, "--warmup") == 0 && value) {
+            options->warmup = atoi(value);
+            if (options->warmup < 0) {
+                fprintf(stderr, "--warmup can't be negative\n");
+                return false;
+            }
+            i++;
+        } else if (strcmp(arg, "--no-pin") == 0) {
+            options->pin = false;
+        } else if (strcmp(arg, "--only") == 0 && value) {
+            options->only = value;
+            i++;
+        } else if (strcmp(arg, "--json") == 0 && value) {
+            options->json = value;
+            i++;
+        } else {
+            fprintf(stderr, "Unknown or incomplete option '%s'\n", arg);
+            print_usage(argv[0]);
+            return false;
+        }
+    }
+    if (options->only) {
+        for (int b = 0; b < BENCH_COUNT; b++) {
+            if (strcmp(options->only, benches[b].name) == 0) return true;
+        }
+        fprintf(stderr, "Unknown benchmark '%s'\n", options->only);
+        return false;
+    }
+    return true;
+}
+
+static bool bench_state_init(struct BenchState* state, int threads) {
+    memset(state, 0, sizeof(*state));
+    state->house = house_init();
+    if (!state->house) return false;
+    // Rooms roomy enough that a move never fails for lack of space
+    state->house->config.room_capacity = threads;
+    house_populate_rooms(state->house);
+    if (state->house->room_count == 0 || !house_apply_config(state->house)) return false;
+    state->from = state->house->starting_room;
+    state->to = state->from->connections[0];
+    for (int t = 0; t < threads; t++) {
+        char name[MAX_HUNTER_NAME];
+        snprintf(name, sizeof(name), "bench%d", t + 1);
+        struct Hunter* hunter = hunter_init(name, t + 1, state->house);
+        if (!hunter || !hunter_collection_append(state->house, hunter)) {
+            hunter_cleanup(hunter);
+            return false;
+        }
+    }
+    casefile_init(&state->case_file);
+    state->evidence_count = get_all_evidence_types(&state->evidence);
+    return state->evidence_count > 0;
+}
+
+int main(int argc, char* argv[]) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    struct BenchOptions options = {
+        .max_threads = cpus > 0 ? (int)cpus : 1,
+        .ops = BENCH_DEFAULT_OPS,
+        .reps = BENCH_DEFAULT_REPS,
+        .warmup = BENCH_DEFAULT_WARMUP,
+        .pin = true,
+    };
+    if (!parse_arguments(argc, argv, &options)) {
+        return EXIT_FAILURE;
+    }
+    log_set_console(false);
+    log_set_files(false);
+    log_set_pacing(false);
+
+    struct BenchState state;
+    if (!bench_state_init(&state, options.max_threads)) {
+        fprintf(stderr, "Failed to set up the benchmark house\n");
+        house_cleanup(state.house);
+        return EXIT_FAILURE;
+    }
+
+    // 1, 2, 4, ... and the maximum itself when it isn't a power of two
+    int thread_counts[32];
+    int thread_count_total = 0;
+    for (int t = 1; t < options.max_threads && thread_count_total < 31; t *= 2) {
+        thread_counts[thread_count_total++] = t;
+    }
+    thread_counts[thread_count_total++] = options.max_threads;
+
+    struct BenchResult* results = calloc((size_t)BENCH_COUNT * thread_count_total, sizeof(struct BenchResult));
+    if (!results) {
+        house_cleanup(state.house);
+        return EXIT_FAILURE;
+    }
+    // JSON on stdout keeps stdout machine-readable, so the table goes to stderr then
+    FILE* table = options.json && strcmp(options.json, "-") == 0 ? stderr : stdout;
+    long long timer_ns = timer_overhead_ns();
+    fprintf(table, "%-20s %7s %14s %14s %9s %9s %9s %9s\n", "benchmark", "threads", "ops/s", "min ops/s",
+           "p50 ns", "p99 ns", "p99.9 ns", "max ns");
+    int count = 0;
+    bool ok = true;
+    for (int b = 0; ok && b < BENCH_COUNT; b++) {
+        if (options.only && strcmp(options.only, benches[b].name) != 0) continue;
+        for (int c = 0; ok && c < thread_count_total; c++) {
+            struct BenchResult* result = &results[count];
+            ok = bench_run(&state, &benches[b], thread_counts[c], &options, result);
+            if (!ok) {
+                fprintf(stderr, "Benchmark %s failed at %d threads\n", benches[b].name, thread_counts[c]);
+                break;
+            }
+            count++;
+            double summary[3];
+            throughput_summary(result, options.reps, summary);
+            fprintf(table, "%-20s %7d %14.0f %14.0f %9lld %9lld %9lld %9lld\n", benches[b].name, thread_counts[c],
+                   summary[0], summary[1], result->latency[0], result->latency[2], result->latency[3],
+                   result->latency[4]);
+            fflush(table);
+        }
+    }
+    fprintf(table, "Latencies are sampled every %d operations and include about %lld ns of clock reads\n",
+           BENCH_SAMPLE_EVERY, timer_ns);
+
+    if (ok && options.json && !write_json(options.json, &options, results, count, timer_ns)) {
+        ok = false;
+    }
+    for (int i = 0; i < count; i++) {
+        free(results[i].throughput);
+    }
+    free(results);
+    casefile_cleanup(&state.case_file);
+    house_cleanup(state.house);
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
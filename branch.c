@@ -0,0 +1,238 @@
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "defs.h"
+#include "helpers.h"
+
+// What a branch sends back to the parent over its pipe
+struct BranchOutcome {
+    int branch;
+    unsigned seed;
+    long turns;
+    int solved_turn;        // -1 when some case stayed open
+    int exits[3];           // hunters leaving for each LogReason
+    int ghosts_bored;
+    double ms;
+};
+
+static double elapsed_ms(const struct timespec* start, const struct timespec* end) {
+    return (end->tv_sec - start->tv_sec) * 1000.0 + (end->tv_nsec - start->tv_nsec) / 1e6;
+}
+
+// The parent may have paused right after a turn ended an entity but before its thread
+// took it out of the house; the branch finishes that for it
+static void leave_if_finished(struct House* house) {
+    for (int i = 0; i < house->ghost_count; i++) {
+        struct Ghost* ghost = house->ghosts[i];
+        if (!ghost->is_running && ghost->current_room) ghost_leave_house(ghost);
+    }
+    for (int i = 0; i < house->hunter_count; i++) {
+        struct Hunter* hunter = house->hunters[i];
+        if (!hunter->is_running && hunter->current_room) hunter_leave_house(hunter);
+    }
+}
+
+// Runs the rest of the simulation on the calling thread, round by round and without
+// sleeping, the way the entity threads would in --fast mode; returns the turns taken
+long house_run_inline(struct House* house) {
+    long turns = 0;
+    while (!house_is_shutting_down(house)) {
+        for (int i = 0; i < house->ghost_count; i++) {
+            struct Ghost* ghost = house->ghosts[i];
+            if (!ghost->is_running) continue;
+            rand_bind_stream(&ghost->rng_state);
+            ghost_take_turn(ghost);
+            turns++;
+            if (!ghost->is_running) ghost_leave_house(ghost);
+        }
+        for (int i = 0; i < house->hunter_count; i++) {
+            struct Hunter* hunter = house->hunters[i];
+            if (!hunter->is_running) continue;
+            rand_bind_stream(&hunter->rng_state);
+            hunter_take_turn(hunter);
+            turns++;
+            if (!hunter->is_running) hunter_leave_house(hunter);
+        }
+    }
+    // Whoever is left leaves with the house, as the threads do on shutdown
+    for (int i = 0; i < house->ghost_count; i++) {
+        if (house->ghosts[i]->is_running) ghost_leave_house(house->ghosts[i]);
+    }
+    for (int i = 0; i < house->hunter_count; i++) {
+        if (house->hunters[i]->is_running) hunter_leave_house(house->hunters[i]);
+    }
+    rand_bind_stream(NULL);
+    return turns;
+}
+
+static void branch_main(struct House* house, int branch, int outcome_fd) {
+    struct timespec began;
+    clock_gettime(CLOCK_MONOTONIC, &began);
+    house_reset_after_fork(house);
+
+    char prefix[32];
+    snprintf(prefix, sizeof(prefix), "branch%d_", branch);
+    log_set_prefix(prefix);
+    log_set_console(false);
+    log_set_pacing(false);
+    checker_detach();
+    telemetry_detach();
+    trace_bind(NULL);
+
+    // A fresh stream per entity is all that sets one future apart from another
+    struct BranchOutcome outcome;
+    memset(&outcome, 0, sizeof(outcome));
+    outcome.branch = branch;
+    outcome.seed = rand_stream_seed(house->config.seed, -(branch + 1));
+    for (int i = 0; i < house->ghost_count; i++) {
+        house->ghosts[i]->rng_state = rand_stream_seed(outcome.seed, house->ghosts[i]->id);
+    }
+    for (int i = 0; i < house->hunter_count; i++) {
+        house->hunters[i]->rng_state = rand_stream_seed(outcome.seed, house->hunters[i]->id);
+    }
+
+    leave_if_finished(house);
+    outcome.turns = house_run_inline(house);
+
+    outcome.solved_turn = -1;
+    for (int i = 0; i < house->ghost_count; i++) {
+        const struct CaseFile* case_file = &house->ghosts[i]->case_file;
+        if (!case_file->solved) {
+            outcome.solved_turn = -1;
+            break;
+        }
+        if (case_file->solved_turn > outcome.solved_turn) {
+            outcome.solved_turn = case_file->solved_turn;
+        }
+    }
+    for (int i = 0; i < house->hunter_count; i++) {
+        enum LogReason reason = house->hunters[i]->exit_reason;
+        if (reason >= LR_EVIDENCE && reason <= LR_AFRAID) {
+            outcome.exits[reason]++;
+        }
+    }
+    for (int i = 0; i < house->ghost_count; i++) {
+        outcome.ghosts_bored += house->ghosts[i]->exit_reason == GHOST_EXIT_BORED;
+    }
+    struct timespec ended;
+    clock_gettime(CLOCK_MONOTONIC, &ended);
+    outcome.ms = elapsed_ms(&began, &ended);
+
+    const char* data = (const char*)&outcome;
+    size_t left = sizeof(outcome);
+    while (left > 0) {
+        ssize_t written = write(outcome_fd, data, left);
+        if (written < 0 && errno == EINTR) continue;
+        if (written <= 0) break;
+        data += written;
+        left -= (size_t)written;
+    }
+    close(outcome_fd);
+}
+
+// Pauses the run between turns and forks one child per branch. The children share the
+// paused house copy-on-write and continue it single-threaded, each with its own random
+// streams; the parent resumes as soon as the last one is forked.
+bool house_branch(struct House* house, int count, struct BranchSet* branches) {
+    if (!house || !branches || count < 1) return false;
+    memset(branches, 0, sizeof(*branches));
+    branches->pids = calloc(count, sizeof(pid_t));
+    branches->outcome_fds = calloc(count, sizeof(int));
+    if (!branches->pids || !branches->outcome_fds) {
+        fprintf(stderr, "Failed to allocate %d branches\n", count);
+        branches_collect(branches);
+        return false;
+    }
+    if (!house_pause_turns(house)) {
+        branches_collect(branches);
+        return false;
+    }
+
+    struct timespec began;
+    clock_gettime(CLOCK_MONOTONIC, &began);
+    // Anything still buffered would otherwise be printed again by every child
+    fflush(stdout);
+    fflush(stderr);
+    for (int b = 0; b < count; b++) {
+        int fds[2];
+        if (pipe(fds) != 0) {
+            perror("Failed to create branch pipe");
+            break;
+        }
+        pid_t pid = fork();
+        if (pid < 0) {
+            perror("Failed to fork branch");
+            close(fds[0]);
+            close(fds[1]);
+            break;
+        }
+        if (pid == 0) {
+            close(fds[0]);
+            for (int i = 0; i < branches->count; i++) {
+                close(branches->outcome_fds[i]);
+            }
+            branch_main(house, b, fds[1]);
+            _exit(EXIT_SUCCESS);
+        }
+        close(fds[1]);
+        branches->pids[branches->count] = pid;
+        branches->outcome_fds[branches->count] = fds[0];
+        branches->count++;
+    }
+    struct timespec forked;
+    clock_gettime(CLOCK_MONOTONIC, &forked);
+    branches->fork_ms = elapsed_ms(&began, &forked);
+    house_resume_turns(house);
+
+    printf("Branched %d futures in %.2f ms (%.1f us each)\n", branches->count, branches->fork_ms,
+           branches->count > 0 ? branches->fork_ms * 1000.0 / branches->count : 0.0);
+    return branches->count > 0;
+}
+
+// Waits for every branch, prints what each one ended with and releases the set
+void branches_collect(struct BranchSet* branches) {
+    if (!branches) return;
+    if (branches->count > 0) {
+        printf("\n--- Branch Outcomes ---\n");
+    }
+    for (int b = 0; b < branches->count; b++) {
+        struct BranchOutcome outcome;
+        char* data = (char*)&outcome;
+        size_t got = 0;
+        while (got < sizeof(outcome)) {
+            ssize_t n = read(branches->outcome_fds[b], data + got, sizeof(outcome) - got);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) break;
+            got += (size_t)n;
+        }
+        close(branches->outcome_fds[b]);
+        int status = 0;
+        while (waitpid(branches->pids[b], &status, 0) < 0 && errno == EINTR) {}
+        if (got < sizeof(outcome)) {
+            printf("Branch %d: ended without an outcome\n", b);
+            continue;
+        }
+        char solved[32];
+        if (outcome.solved_turn >= 0) {
+            snprintf(solved, sizeof(solved), "solved at turn %d", outcome.solved_turn);
+        } else {
+            snprintf(solved, sizeof(solved), "unsolved");
+        }
+        printf("Branch %d (seed %u): %s, evidence=%d bored=%d afraid=%d, %d ghosts bored, "
+               "%ld turns in %.2f ms\n",
+               outcome.branch, outcome.seed, solved, outcome.exits[LR_EVIDENCE],
+               outcome.exits[LR_BORED], outcome.exits[LR_AFRAID], outcome.ghosts_bored,
+               outcome.turns, outcome.ms);
+    }
+    free(branches->pids);
+    free(branches->outcome_fds);
+    branches->pids = NULL;
+    branches->outcome_fds = NULL;
+    branches->count = 0;
+}
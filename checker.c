@@ -0,0 +1,623 @@
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include <time.h>
+#include "defs.h"
+#include "helpers.h"
+
+// Online invariant checker: the rules validate_logs.py applies after the run, applied
+// while it happens.
+//
+// Every logged event is copied into a bounded lock-free ring (one ticket per event,
+// claimed with a CAS, published through the slot's sequence number) and a single
+// checker thread replays the events onto shadow rooms and entities.
+//
+// An entity's own events arrive in the order it made them, so its moves, return path,
+// device and stats are checked exactly. Events of different entities can reach the
+// ring in a different order than the changes they describe, because a hunter logs
+// after it leaves the room. Occupancy and evidence are therefore only flagged when
+// they stay wrong for CHECK_TOLERANCE_NS of event time.
+
+enum CheckIssue {
+    CHECK_MOVEMENT = 0,
+    CHECK_RETURN,
+    CHECK_EVIDENCE,
+    CHECK_OCCUPANCY,
+    CHECK_STATS,
+    CHECK_MISSING_INIT,
+    CHECK_ISSUE_COUNT
+};
+
+static const char* const issue_names[CHECK_ISSUE_COUNT] = {
+    "movement", "return", "evidence", "occupancy", "stats", "missing init"
+};
+
+// The strings are room names, device and reason names and hunter names, all of which
+// outlive the run, so the ring stores the pointers
+struct CheckEvent {
+    long long at_ns;
+    const char* action;
+    const char* room;
+    const char* extra;
+    const char* device;
+    int entity_id;
+    int boredom;
+    int fear;
+    bool is_ghost;
+};
+
+struct CheckSlot {
+    unsigned long sequence;
+    struct CheckEvent event;
+};
+
+struct ShadowRoom {
+    int hunters;
+    int evidence[EVIDENCE_TYPE_COUNT];  // drops minus pickups, per device
+    long long over_since;               // occupancy out of range since, 0 when fine
+    long long owed_since;               // some evidence count negative since, 0 when fine
+};
+
+struct ShadowEntity {
+    bool used;
+    bool is_ghost;
+    int id;
+    int room;                   // -1 once the entity left
+    enum EvidenceType device;
+    int boredom;
+    int fear;
+    bool initialised;
+    bool returning;
+    int* path;                  // rooms to walk back through, top last
+    int path_length;
+    int path_capacity;
+};
+
+static struct House* checked_house = NULL;
+static struct CheckSlot* ring = NULL;
+static unsigned long ring_mask = 0;
+static unsigned long enqueue_pos __attribute__((aligned(64))) = 0;
+static unsigned long dequeue_pos __attribute__((aligned(64))) = 0;
+static bool checker_enabled = false;
+static bool checker_stopping = false;
+static pthread_t checker_tid;
+static long producer_stalls = 0;
+
+// Only the checker thread touches the shadow state
+static struct ShadowRoom* shadow_rooms = NULL;
+static struct ShadowEntity* shadow_entities = NULL;    // open addressing on the id
+static int shadow_capacity = 0;
+static int shadow_count = 0;
+static int* suspects = NULL;                           // rooms with a pending tolerance check
+static int suspect_count = 0;
+static long long event_clock = 0;                      // latest event time seen
+static long issue_counts[CHECK_ISSUE_COUNT];
+static long events_checked = 0;
+
+static void report(enum CheckIssue issue, const char* format, ...) __attribute__((format(printf, 2, 3)));
+
+static void report(enum CheckIssue issue, const char* format, ...) {
+    if (++issue_counts[issue] > CHECK_REPORT_LIMIT) return;
+    va_list args;
+    va_start(args, format);
+    fprintf(stderr, "Invariant violated (%s): ", issue_names[issue]);
+    vfprintf(stderr, format, args);
+    fprintf(stderr, "\n");
+    va_end(args);
+}
+
+static long long monotonic_ns() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+// Room names handed to the logger point into House::rooms, so the index falls out of
+// the address; anything else is looked up by name
+static int room_of(const char* name) {
+    if (!name || !name[0]) return -1;
+    struct House* house = checked_house;
+    const char* base = (const char*)house->rooms;
+    if (name >= base && name < (const char*)(house->rooms + house->room_count)) {
+        int index = (int)((name - base) / (long)sizeof(struct Room));
+        if (house->rooms[index].name == name) return index;
+    }
+    for (int i = 0; i < house->room_count; i++) {
+        if (strcmp(house->rooms[i].name, name) == 0) return i;
+    }
+    return -1;
+}
+
+static const char* room_name(int room) {
+    return room >= 0 ? checked_house->rooms[room].name : "(outside)";
+}
+
+static bool rooms_adjacent(int from, int to) {
+    struct Room* room = &checked_house->rooms[from];
+    for (int i = 0; i < room->connection_count; i++) {
+        if (room->connections[i] == &checked_house->rooms[to]) return true;
+    }
+    return false;
+}
+
+static enum EvidenceType device_of(const char* text) {
+    if (!text) return 0;
+    const enum EvidenceType* types = NULL;
+    int count = get_all_evidence_types(&types);
+    for (int i = 0; i < count; i++) {
+        const char* name = evidence_to_string(types[i]);
+        if (name == text || strcmp(name, text) == 0) return types[i];
+    }
+    return 0;
+}
+
+static struct ShadowEntity* shadow_find(int id, bool is_ghost, bool create);
+
+static bool shadow_grow() {
+    int capacity = shadow_capacity ? shadow_capacity * 2 : 256;
+    struct ShadowEntity* old = shadow_entities;
+    int old_capacity = shadow_capacity;
+    shadow_entities = calloc(capacity, sizeof(struct ShadowEntity));
+    if (!shadow_entities) {
+        shadow_entities = old;
+        return false;
+    }
+    shadow_capacity = capacity;
+    shadow_count = 0;
+    for (int i = 0; i < old_capacity; i++) {
+        if (!old[i].used) continue;
+        struct ShadowEntity* moved = shadow_find(old[i].id, old[i].is_ghost, true);
+        *moved = old[i];
+    }
+    free(old);
+    return true;
+}
+
+// Hunters and ghosts can share an id, so the kind is part of the key
+static struct ShadowEntity* shadow_find(int id, bool is_ghost, bool create) {
+    if (create && (shadow_count + 1) * 2 > shadow_capacity && !shadow_grow()) return NULL;
+    if (shadow_capacity == 0) return NULL;
+    unsigned hash = ((unsigned)id * 0x9E3779B9u) ^ (is_ghost ? 0x5bd1e995u : 0);
+    for (int probe = 0; probe < shadow_capacity; probe++) {
+        struct ShadowEntity* entity = &shadow_entities[(hash + probe) & (shadow_capacity - 1)];
+        if (!entity->used) {
+            if (!create) return NULL;
+            memset(entity, 0, sizeof(*entity));
+            entity->used = true;
+            entity->is_ghost = is_ghost;
+            entity->id = id;
+            entity->room = -1;
+            shadow_count++;
+            return entity;
+        }
+        if (entity->id == id && entity->is_ghost == is_ghost) return entity;
+    }
+    return NULL;
+}
+
+static void path_push(struct ShadowEntity* entity, int room) {
+    if (entity->path_length == entity->path_capacity) {
+        int capacity = entity->path_capacity ? entity->path_capacity * 2 : 16;
+        int* path = realloc(entity->path, sizeof(int) * capacity);
+        if (!path) return;
+        entity->path = path;
+        entity->path_capacity = capacity;
+    }
+    entity->path[entity->path_length++] = room;
+}
+
+static void suspect(int room) {
+    struct ShadowRoom* shadow = &shadow_rooms[room];
+    int hunters = shadow->hunters;
+    bool over = hunters < 0 || hunters > checked_house->rooms[room].hunter_capacity;
+    bool owed = false;
+    for (int d = 0; d < EVIDENCE_TYPE_COUNT; d++) {
+        owed = owed || shadow->evidence[d] < 0;
+    }
+    bool listed = shadow->over_since || shadow->owed_since;
+    shadow->over_since = over ? (shadow->over_since ? shadow->over_since : event_clock) : 0;
+    shadow->owed_since = owed ? (shadow->owed_since ? shadow->owed_since : event_clock) : 0;
+    if (!listed && (shadow->over_since || shadow->owed_since)) {
+        suspects[suspect_count++] = room;
+    }
+}
+
+// Flags rooms that stayed wrong past the tolerance and forgets the ones that recovered
+static void settle_suspects(bool final) {
+    int kept = 0;
+    for (int i = 0; i < suspect_count; i++) {
+        int room = suspects[i];
+        struct ShadowRoom* shadow = &shadow_rooms[room];
+        if (shadow->over_since && (final || event_clock - shadow->over_since > CHECK_TOLERANCE_NS)) {
+            report(CHECK_OCCUPANCY, "%s holds %d hunters for capacity %d", room_name(room),
+                   shadow->hunters, checked_house->rooms[room].hunter_capacity);
+            shadow->over_since = 0;
+        }
+        if (shadow->owed_since && (final || event_clock - shadow->owed_since > CHECK_TOLERANCE_NS)) {
+            for (int d = 0; d < EVIDENCE_TYPE_COUNT; d++) {
+                if (shadow->evidence[d] >= 0) continue;
+                report(CHECK_EVIDENCE, "%s evidence picked up in %s where none was dropped",
+                       evidence_to_string((enum EvidenceType)(1 << d)), room_name(room));
+                shadow->evidence[d] = 0;
+            }
+            shadow->owed_since = 0;
+        }
+        if (shadow->over_since || shadow->owed_since) {
+            suspects[kept++] = room;
+        }
+    }
+    suspect_count = kept;
+}
+
+static void enter_room(struct ShadowEntity* entity, int room) {
+    entity->room = room;
+    if (room >= 0 && !entity->is_ghost) {
+        shadow_rooms[room].hunters++;
+        suspect(room);
+    }
+}
+
+static void leave_room(struct ShadowEntity* entity) {
+    int room = entity->room;
+    entity->room = -1;
+    if (room >= 0 && !entity->is_ghost) {
+        shadow_rooms[room].hunters--;
+        suspect(room);
+    }
+}
+
+// Every turn resets one of boredom and fear and raises the other, so after the first
+// turn exactly one of them is zero. A hunter can spend turns without logging anything
+// (a full room blocks its move), so how far they moved since its last event is open.
+static void check_hunter_stats(struct ShadowEntity* hunter, const struct CheckEvent* event) {
+    int boredom = event->boredom;
+    int fear = event->fear;
+    if ((boredom == 0) == (fear == 0)) {
+        report(CHECK_STATS, "hunter %d has boredom %d and fear %d after a turn", hunter->id, boredom, fear);
+    } else if (boredom > ENTITY_BOREDOM_MAX + 1 || fear > HUNTER_FEAR_MAX + 1) {
+        report(CHECK_STATS, "hunter %d stayed past boredom %d fear %d", hunter->id, boredom, fear);
+    }
+    hunter->boredom = boredom;
+    hunter->fear = fear;
+}
+
+static void check_room_matches(struct ShadowEntity* entity, int room, const char* action) {
+    if (room != entity->room) {
+        report(CHECK_MOVEMENT, "%s %d logged %s in %s but is in %s", entity->is_ghost ? "ghost" : "hunter",
+               entity->id, action, room_name(room), room_name(entity->room));
+    }
+}
+
+static void check_move(struct ShadowEntity* entity, int from, int to) {
+    check_room_matches(entity, from, "MOVE");
+    if (from < 0 || to < 0 || !rooms_adjacent(from, to)) {
+        report(CHECK_MOVEMENT, "%s %d moved along a missing connection %s->%s",
+               entity->is_ghost ? "ghost" : "hunter", entity->id, room_name(from), room_name(to));
+    }
+    leave_room(entity);
+    enter_room(entity, to);
+}
+
+static void check_hunter_event(const struct CheckEvent* event) {
+    struct ShadowEntity* hunter = shadow_find(event->entity_id, false, true);
+    if (!hunter) return;
+    const char* action = event->action;
+    int room = room_of(event->room);
+    int van = (int)(checked_house->starting_room - checked_house->rooms);
+    if (strcmp(action, "INIT") == 0) {
+        leave_room(hunter);
+        hunter->initialised = true;
+        hunter->device = device_of(event->device);
+        hunter->boredom = 0;
+        hunter->fear = 0;
+        hunter->returning = false;
+        hunter->path_length = 0;
+        if (room < 0) {
+            report(CHECK_MOVEMENT, "hunter %d starts in unknown room '%s'", hunter->id, event->room);
+        }
+        enter_room(hunter, room);
+        return;
+    }
+    if (!hunter->initialised) {
+        report(CHECK_MISSING_INIT, "hunter %d logged %s before INIT", hunter->id, action);
+        hunter->initialised = true;
+        hunter->room = room;
+    }
+    check_hunter_stats(hunter, event);
+
+    if (strcmp(action, "MOVE") == 0) {
+        int to = room_of(event->extra);
+        check_move(hunter, room, to);
+        if (hunter->returning) {
+            if (hunter->path_length > 0) {
+                int expected = hunter->path[--hunter->path_length];
+                if (expected != to) {
+                    report(CHECK_RETURN, "hunter %d returned to %s instead of %s", hunter->id,
+                           room_name(to), room_name(expected));
+                }
+            } else if (to != van) {
+                report(CHECK_RETURN, "hunter %d ran out of path and went to %s", hunter->id, room_name(to));
+            }
+        } else {
+            path_push(hunter, room);
+        }
+        if (to == van) {
+            hunter->path_length = 0;
+        }
+    } else if (strcmp(action, "EVIDENCE") == 0) {
+        check_room_matches(hunter, room, action);
+        enum EvidenceType device = device_of(event->device);
+        if (device != hunter->device) {
+            report(CHECK_EVIDENCE, "hunter %d read %s while carrying %s", hunter->id,
+                   evidence_to_string(device), evidence_to_string(hunter->device));
+        }
+        if (room >= 0 && device) {
+            shadow_rooms[room].evidence[evidence_to_index(device)]--;
+            suspect(room);
+        }
+        if (room != van) {
+            hunter->returning = true;
+        }
+    } else if (strcmp(action, "SWAP") == 0) {
+        if (hunter->room != van) {
+            report(CHECK_MOVEMENT, "hunter %d swapped devices in %s", hunter->id, room_name(hunter->room));
+        }
+        hunter->device = device_of(event->device);
+    } else if (strcmp(action, "RETURN_START") == 0) {
+        check_room_matches(hunter, room, action);
+        if (room != van) {
+            hunter->returning = true;
+        }
+    } else if (strcmp(action, "RETURN_COMPLETE") == 0) {
+        if (room != van) {
+            report(CHECK_RETURN, "hunter %d completed a return in %s", hunter->id, room_name(room));
+        } else if (hunter->path_length > 0) {
+            report(CHECK_RETURN, "hunter %d completed a return with %d rooms left on its path",
+                   hunter->id, hunter->path_length);
+        }
+        hunter->path_length = 0;
+        hunter->returning = false;
+    } else if (strcmp(action, "EXIT") == 0) {
+        check_room_matches(hunter, room, action);
+        const char* reason = event->extra ? event->extra : "";
+        if ((strcmp(reason, exit_reason_to_string(LR_BORED)) == 0 && hunter->boredom <= ENTITY_BOREDOM_MAX) ||
+            (strcmp(reason, exit_reason_to_string(LR_AFRAID)) == 0 && hunter->fear <= HUNTER_FEAR_MAX)) {
+            report(CHECK_STATS, "hunter %d left %s at boredom %d fear %d", hunter->id, reason,
+                   hunter->boredom, hunter->fear);
+        }
+        leave_room(hunter);
+        hunter->path_length = 0;
+        hunter->returning = false;
+    }
+}
+
+static void check_ghost_event(const struct CheckEvent* event) {
+    struct ShadowEntity* ghost = shadow_find(event->entity_id, true, true);
+    if (!ghost) return;
+    const char* action = event->action;
+    int room = room_of(event->room);
+    if (strcmp(action, "INIT") == 0) {
+        ghost->initialised = true;
+        ghost->boredom = 0;
+        if (room < 0) {
+            report(CHECK_MOVEMENT, "ghost %d starts in unknown room '%s'", ghost->id, event->room);
+        }
+        enter_room(ghost, room);
+        return;
+    }
+    if (!ghost->initialised) {
+        report(CHECK_MISSING_INIT, "ghost %d logged %s before INIT", ghost->id, action);
+        ghost->initialised = true;
+        ghost->room = room;
+    }
+    // A ghost logs every turn, so boredom either resets or goes up by one; only the
+    // EXIT of a ghost sent home with the house repeats the last value
+    bool repeated = event->boredom == ghost->boredom && strcmp(action, "EXIT") == 0;
+    if ((event->boredom != 0 && event->boredom != ghost->boredom + 1 && !repeated) ||
+        event->boredom > ENTITY_BOREDOM_MAX + 1) {
+        report(CHECK_STATS, "ghost %d went from boredom %d to %d", ghost->id, ghost->boredom, event->boredom);
+    }
+    ghost->boredom = event->boredom;
+
+    if (strcmp(action, "MOVE") == 0) {
+        check_move(ghost, room, room_of(event->extra));
+    } else if (strcmp(action, "EVIDENCE") == 0) {
+        check_room_matches(ghost, room, action);
+        enum EvidenceType evidence = device_of(event->extra);
+        if (room >= 0 && evidence) {
+            shadow_rooms[room].evidence[evidence_to_index(evidence)]++;
+            suspect(room);
+        }
+    } else if (strcmp(action, "EXIT") == 0) {
+        check_room_matches(ghost, room, action);
+        leave_room(ghost);
+    } else {
+        check_room_matches(ghost, room, action);
+    }
+}
+
+static bool ring_take(struct CheckEvent* event) {
+    struct CheckSlot* slot = &ring[dequeue_pos & ring_mask];
+    if (__atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE) != dequeue_pos + 1) return false;
+    *event = slot->event;
+    __atomic_store_n(&slot->sequence, dequeue_pos + ring_mask + 1, __ATOMIC_RELEASE);
+    dequeue_pos++;
+    return true;
+}
+
+static void* checker_thread(void* arg) {
+    (void)arg;
+    struct CheckEvent event;
+    while (true) {
+        bool stopping = __atomic_load_n(&checker_stopping, __ATOMIC_ACQUIRE);
+        int taken = 0;
+        while (ring_take(&event)) {
+            if (event.at_ns > event_clock) event_clock = event.at_ns;
+            if (event.is_ghost) {
+                check_ghost_event(&event);
+            } else {
+                check_hunter_event(&event);
+            }
+            events_checked++;
+            taken++;
+        }
+        settle_suspects(false);
+        if (stopping) break;
+        if (taken == 0) {
+            struct timespec pause = {0, CHECK_IDLE_NS};
+            nanosleep(&pause, NULL);
+        }
+    }
+    return NULL;
+}
+
+// Seeds the shadow state from a house that already holds entities, e.g. on --resume
+static void snapshot_house(struct House* house) {
+    for (int r = 0; r < house->room_count; r++) {
+        struct Room* room = &house->rooms[r];
+        for (int g = 0; g < room->evidence_slots; g++) {
+            for (int d = 0; d < EVIDENCE_TYPE_COUNT; d++) {
+                shadow_rooms[r].evidence[d] += (room->evidence[g] >> d) & 1;
+            }
+        }
+    }
+    for (int i = 0; i < house->ghost_count; i++) {
+        struct Ghost* ghost = house->ghosts[i];
+        struct ShadowEntity* shadow = shadow_find(ghost->id, true, true);
+        if (!shadow) continue;
+        shadow->initialised = true;
+        shadow->boredom = ghost->boredom;
+        if (ghost->is_running) enter_room(shadow, room_of(ghost->current_room->name));
+    }
+    for (int i = 0; i < house->hunter_count; i++) {
+        struct Hunter* hunter = house->hunters[i];
+        struct ShadowEntity* shadow = shadow_find(hunter->id, false, true);
+        if (!shadow) continue;
+        shadow->initialised = true;
+        shadow->device = hunter->device;
+        shadow->boredom = hunter->boredom;
+        shadow->fear = hunter->fear;
+        shadow->returning = hunter->return_to_van;
+        if (!hunter->is_running || !hunter->current_room) continue;
+        enter_room(shadow, room_of(hunter->current_room->name));
+        int depth = 0;
+        for (struct RoomNode* node = hunter->path.head; node; node = node->next) depth++;
+        for (int d = depth - 1; d >= 0; d--) {
+            struct RoomNode* node = hunter->path.head;
+            for (int k = 0; k < d; k++) node = node->next;
+            path_push(shadow, room_of(node->room->name));
+        }
+    }
+}
+
+static void free_checker() {
+    for (int i = 0; i < shadow_capacity; i++) {
+        free(shadow_entities[i].path);
+    }
+    free(shadow_entities);
+    free(shadow_rooms);
+    free(suspects);
+    free(ring);
+    shadow_entities = NULL;
+    shadow_capacity = 0;
+    shadow_count = 0;
+    shadow_rooms = NULL;
+    suspects = NULL;
+    ring = NULL;
+}
+
+bool checker_start(struct House* house) {
+    if (!house || checker_enabled || house->room_count == 0) return false;
+    checked_house = house;
+    ring = calloc(CHECK_RING_SIZE, sizeof(struct CheckSlot));
+    shadow_rooms = calloc(house->room_count, sizeof(struct ShadowRoom));
+    suspects = malloc(sizeof(int) * house->room_count);
+    if (!ring || !shadow_rooms || !suspects) {
+        fprintf(stderr, "Failed to allocate the invariant checker\n");
+        free_checker();
+        return false;
+    }
+    ring_mask = CHECK_RING_SIZE - 1;
+    for (unsigned long i = 0; i < CHECK_RING_SIZE; i++) {
+        ring[i].sequence = i;
+    }
+    enqueue_pos = 0;
+    dequeue_pos = 0;
+    checker_stopping = false;
+    snapshot_house(house);
+    if (pthread_create(&checker_tid, NULL, checker_thread, NULL) != 0) {
+        fprintf(stderr, "Failed to start the invariant checker\n");
+        // Also leaves ring NULL, so checker_stop() won't join a thread that never started
+        free_checker();
+        return false;
+    }
+    __atomic_store_n(&checker_enabled, true, __ATOMIC_RELEASE);
+    return true;
+}
+
+// Producers only wait when the checker is a whole ring behind
+void checker_submit(bool is_ghost, int entity_id, const char* action, const char* room,
+                    const char* extra, const char* device, int boredom, int fear) {
+    if (!__atomic_load_n(&checker_enabled, __ATOMIC_ACQUIRE)) return;
+    unsigned long pos = __atomic_load_n(&enqueue_pos, __ATOMIC_RELAXED);
+    struct CheckSlot* slot;
+    while (true) {
+        slot = &ring[pos & ring_mask];
+        unsigned long sequence = __atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE);
+        long difference = (long)(sequence - pos);
+        if (difference == 0) {
+            if (__atomic_compare_exchange_n(&enqueue_pos, &pos, pos + 1, true,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                break;
+            }
+        } else if (difference < 0) {
+            __atomic_add_fetch(&producer_stalls, 1, __ATOMIC_RELAXED);
+            sched_yield();
+            pos = __atomic_load_n(&enqueue_pos, __ATOMIC_RELAXED);
+        } else {
+            pos = __atomic_load_n(&enqueue_pos, __ATOMIC_RELAXED);
+        }
+    }
+    struct CheckEvent* event = &slot->event;
+    event->at_ns = monotonic_ns();
+    event->action = action;
+    event->room = room;
+    event->extra = extra;
+    event->device = device;
+    event->entity_id = entity_id;
+    event->boredom = boredom;
+    event->fear = fear;
+    event->is_ghost = is_ghost;
+    __atomic_store_n(&slot->sequence, pos + 1, __ATOMIC_RELEASE);
+}
+
+// A fork() child has no checker thread, so nothing may wait on the ring there
+void checker_detach() {
+    __atomic_store_n(&checker_enabled, false, __ATOMIC_RELEASE);
+}
+
+// Drains what is left, prints the verdict and returns the number of violations
+long checker_stop() {
+    if (!ring) return 0;
+    __atomic_store_n(&checker_stopping, true, __ATOMIC_RELEASE);
+    pthread_join(checker_tid, NULL);
+    checker_enabled = false;
+    settle_suspects(true);
+
+    long total = 0;
+    for (int i = 0; i < CHECK_ISSUE_COUNT; i++) {
+        total += issue_counts[i];
+    }
+    printf("Invariant checker: %ld events, %ld violations", events_checked, total);
+    for (int i = 0; i < CHECK_ISSUE_COUNT; i++) {
+        if (issue_counts[i] > 0) printf(", %s=%ld", issue_names[i], issue_counts[i]);
+    }
+    printf(", producers waited %ld times\n", producer_stalls);
+
+    free_checker();
+    return total;
+}
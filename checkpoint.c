@@ -0,0 +1,435 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "defs.h"
+#include "helpers.h"
+
+// Checkpoint file layout, native byte order, every field fixed width:
+//   "GHCK", version, simulation config, house counts
+//   rooms:   name, exit flag, capacity, connections as room indices, exploration map,
+//            one evidence mask per ghost
+//   ghosts:  identity, room index, random stream, stats, case file, log offset
+//   hunters: identity, room index, device, random stream, stats, path as room
+//            indices from the bottom of the stack, log offset
+// Who stands in which room is rebuilt from the entities, so a hunter that was between
+// two actor partitions at the cut simply resumes in the room it was walking into.
+#define CHECKPOINT_MAGIC "GHCK"
+#define CHECKPOINT_VERSION 2
+
+struct CheckpointWriter {
+    unsigned char* data;
+    size_t length;
+    size_t capacity;
+    bool failed;
+};
+
+struct CheckpointReader {
+    const unsigned char* data;
+    size_t length;
+    size_t position;
+    bool failed;
+};
+
+static void put_bytes(struct CheckpointWriter* writer, const void* bytes, size_t count) {
+    if (writer->failed) return;
+    if (writer->length + count > writer->capacity) {
+        size_t capacity = writer->capacity ? writer->capacity : 4096;
+        while (writer->length + count > capacity) {
+            capacity *= 2;
+        }
+        unsigned char* data = realloc(writer->data, capacity);
+        if (!data) {
+            writer->failed = true;
+            return;
+        }
+        writer->data = data;
+        writer->capacity = capacity;
+    }
+    memcpy(writer->data + writer->length, bytes, count);
+    writer->length += count;
+}
+
+static void put_i32(struct CheckpointWriter* writer, int32_t value) {
+    put_bytes(writer, &value, sizeof(value));
+}
+
+static void put_u32(struct CheckpointWriter* writer, uint32_t value) {
+    put_bytes(writer, &value, sizeof(value));
+}
+
+static void put_i64(struct CheckpointWriter* writer, int64_t value) {
+    put_bytes(writer, &value, sizeof(value));
+}
+
+static void put_string(struct CheckpointWriter* writer, const char* text) {
+    size_t full_length = strlen(text);
+    unsigned char length = (unsigned char)(full_length > 255 ? 255 : full_length);
+    put_bytes(writer, &length, 1);
+    put_bytes(writer, text, length);
+}
+
+static void get_bytes(struct CheckpointReader* reader, void* bytes, size_t count) {
+    if (reader->failed || reader->position + count > reader->length) {
+        reader->failed = true;
+        memset(bytes, 0, count);
+        return;
+    }
+    memcpy(bytes, reader->data + reader->position, count);
+    reader->position += count;
+}
+
+static int32_t get_i32(struct CheckpointReader* reader) {
+    int32_t value;
+    get_bytes(reader, &value, sizeof(value));
+    return value;
+}
+
+static uint32_t get_u32(struct CheckpointReader* reader) {
+    uint32_t value;
+    get_bytes(reader, &value, sizeof(value));
+    return value;
+}
+
+static int64_t get_i64(struct CheckpointReader* reader) {
+    int64_t value;
+    get_bytes(reader, &value, sizeof(value));
+    return value;
+}
+
+static void get_string(struct CheckpointReader* reader, char* buffer, size_t size) {
+    unsigned char length = 0;
+    get_bytes(reader, &length, 1);
+    char text[256];
+    get_bytes(reader, text, length);
+    size_t kept = length < size - 1 ? length : size - 1;
+    memcpy(buffer, text, kept);
+    buffer[kept] = '\0';
+}
+
+// A room index that doesn't fit the house marks the checkpoint as damaged
+static struct Room* room_at(struct House* house, struct CheckpointReader* reader, int32_t index) {
+    if (index < 0) return NULL;
+    if (index >= house->room_count) {
+        reader->failed = true;
+        return NULL;
+    }
+    return &house->rooms[index];
+}
+
+static int32_t index_of(struct House* house, struct Room* room) {
+    return room ? (int32_t)(room - house->rooms) : -1;
+}
+
+static void write_config(struct CheckpointWriter* writer, const struct SimConfig* config) {
+    put_i32(writer, config->device_policy);
+    put_i32(writer, config->explore_policy);
+    put_i32(writer, config->wake_mode);
+    put_u32(writer, config->seed);
+    put_i32(writer, config->room_capacity);
+    put_i32(writer, config->ghost_count);
+    put_i32(writer, config->layout_rooms);
+}
+
+static void write_room(struct CheckpointWriter* writer, struct House* house, struct Room* room) {
+    put_string(writer, room->name);
+    put_i32(writer, room->is_exit);
+    put_i32(writer, room->hunter_capacity);
+    put_i32(writer, room->connection_count);
+    for (int i = 0; i < room->connection_count; i++) {
+        put_i32(writer, index_of(house, room->connections[i]));
+    }
+    put_u32(writer, room->visits);
+    put_u32(writer, room->last_visit);
+    put_bytes(writer, &room->sighted, 1);
+    put_bytes(writer, room->evidence, house->ghost_count);
+}
+
+static void write_ghost(struct CheckpointWriter* writer, struct House* house, struct Ghost* ghost) {
+    put_i32(writer, ghost->id);
+    put_i32(writer, ghost->index);
+    put_i32(writer, ghost->type);
+    put_i32(writer, ghost->is_running ? index_of(house, ghost->current_room) : -1);
+    put_u32(writer, ghost->rng_state);
+    put_i32(writer, ghost->turns);
+    put_i32(writer, ghost->boredom);
+    put_i32(writer, ghost->is_running);
+    put_i32(writer, ghost->exit_reason);
+    put_bytes(writer, &ghost->case_file.collected, 1);
+    put_u32(writer, ghost->case_file.candidates);
+    put_i32(writer, ghost->case_file.solved);
+    put_i32(writer, ghost->case_file.solved_turn);
+    put_i64(writer, ghost->is_running ? log_get_offset(ghost->id) : -1);
+}
+
+static void write_hunter(struct CheckpointWriter* writer, struct House* house, struct Hunter* hunter) {
+    put_string(writer, hunter->name);
+    put_i32(writer, hunter->id);
+    put_i32(writer, hunter->is_running ? index_of(house, hunter->current_room) : -1);
+    put_i32(writer, hunter->device);
+    put_u32(writer, hunter->rng_state);
+    put_i32(writer, hunter->turns);
+    put_i32(writer, hunter->boredom);
+    put_i32(writer, hunter->fear);
+    put_i32(writer, hunter->return_to_van);
+    put_i32(writer, hunter->is_running);
+    put_i32(writer, hunter->exit_reason);
+
+    // The stack is stored bottom first so restoring is a plain series of pushes
+    int depth = 0;
+    for (struct RoomNode* node = hunter->path.head; node; node = node->next) {
+        depth++;
+    }
+    put_i32(writer, depth);
+    int32_t* path = malloc(sizeof(int32_t) * (depth > 0 ? depth : 1));
+    if (!path) {
+        writer->failed = true;
+        return;
+    }
+    int slot = depth;
+    for (struct RoomNode* node = hunter->path.head; node; node = node->next) {
+        path[--slot] = index_of(house, node->room);
+    }
+    put_bytes(writer, path, sizeof(int32_t) * depth);
+    free(path);
+    put_i64(writer, hunter->is_running ? log_get_offset(hunter->id) : -1);
+}
+
+// Pauses every entity between turns, serialises the house, then lets them carry on
+// before the file is written. The file is replaced atomically through a rename.
+bool house_checkpoint(struct House* house, const char* path, long* bytes_written) {
+    if (!house || !path) return false;
+    struct CheckpointWriter writer = { NULL, 0, 0, false };
+    if (!house_pause_turns(house)) return false;
+
+    put_bytes(&writer, CHECKPOINT_MAGIC, 4);
+    put_u32(&writer, CHECKPOINT_VERSION);
+    write_config(&writer, &house->config);
+    put_i32(&writer, house->room_count);
+    put_i32(&writer, index_of(house, house->starting_room));
+    put_u32(&writer, __atomic_load_n(&house->move_clock, __ATOMIC_RELAXED));
+    put_i32(&writer, house->ghost_count);
+    put_i32(&writer, house->hunter_count);
+    for (int i = 0; i < house->room_count; i++) {
+        write_room(&writer, house, &house->rooms[i]);
+    }
+    for (int i = 0; i < house->ghost_count; i++) {
+        write_ghost(&writer, house, house->ghosts[i]);
+    }
+    for (int i = 0; i < house->hunter_count; i++) {
+        write_hunter(&writer, house, house->hunters[i]);
+    }
+    house_resume_turns(house);
+
+    if (writer.failed) {
+        fprintf(stderr, "Out of memory while building checkpoint\n");
+        free(writer.data);
+        return false;
+    }
+    char temp_path[512];
+    snprintf(temp_path, sizeof(temp_path), "%s.tmp", path);
+    FILE* file = fopen(temp_path, "wb");
+    bool ok = file && fwrite(writer.data, 1, writer.length, file) == writer.length;
+    if (file && fclose(file) != 0) {
+        ok = false;
+    }
+    if (ok && rename(temp_path, path) != 0) {
+        ok = false;
+    }
+    if (!ok) {
+        fprintf(stderr, "Failed to write checkpoint %s\n", path);
+        remove(temp_path);
+    } else if (bytes_written) {
+        *bytes_written = (long)writer.length;
+    }
+    free(writer.data);
+    return ok;
+}
+
+// Connections may point at rooms not read yet; their addresses are already fixed
+static bool read_rooms(struct CheckpointReader* reader, struct House* house, int ghost_count) {
+    for (int i = 0; i < house->room_count && !reader->failed; i++) {
+        struct Room* room = &house->rooms[i];
+        char name[MAX_ROOM_NAME];
+        get_string(reader, name, sizeof(name));
+        bool is_exit = get_i32(reader) != 0;
+        room_init(room, name, is_exit);
+        if (!room_set_capacity(room, get_i32(reader)) ||
+            !room_set_evidence_slots(room, ghost_count)) {
+            return false;
+        }
+        int connection_count = get_i32(reader);
+        if (connection_count < 0 || connection_count > MAX_CONNECTIONS) {
+            return false;
+        }
+        room->connection_count = connection_count;
+        for (int c = 0; c < connection_count; c++) {
+            room->connections[c] = room_at(house, reader, get_i32(reader));
+        }
+        room->visits = get_u32(reader);
+        room->last_visit = get_u32(reader);
+        get_bytes(reader, &room->sighted, 1);
+        get_bytes(reader, room->evidence, ghost_count);
+        room->evidence_any = 0;
+        for (int g = 0; g < ghost_count; g++) {
+            room->evidence_any |= room->evidence[g];
+        }
+    }
+    return !reader->failed;
+}
+
+static struct Ghost* read_ghost(struct CheckpointReader* reader, struct House* house) {
+    struct Ghost* ghost = calloc(1, sizeof(struct Ghost));
+    if (!ghost) return NULL;
+    ghost->entity.kind = ENTITY_GHOST;
+    ghost->house = house;
+    ghost->id = get_i32(reader);
+    ghost->index = get_i32(reader);
+    ghost_set_type(ghost, (enum GhostType)get_i32(reader));
+    struct Room* room = room_at(house, reader, get_i32(reader));
+    ghost->rng_state = get_u32(reader);
+    ghost->turns = get_i32(reader);
+    ghost->boredom = get_i32(reader);
+    ghost->is_running = get_i32(reader) != 0;
+    ghost->exit_reason = (enum GhostExitReason)get_i32(reader);
+    casefile_init(&ghost->case_file);
+    get_bytes(reader, &ghost->case_file.collected, 1);
+    ghost->case_file.candidates = get_u32(reader);
+    ghost->case_file.solved = get_i32(reader) != 0;
+    ghost->case_file.solved_turn = get_i32(reader);
+    long long log_offset = get_i64(reader);
+    if (ghost->is_running && room) {
+        room_add_ghost(room, ghost);
+        log_rewind(ghost->id, log_offset);
+    } else {
+        ghost->is_running = false;
+    }
+    return ghost;
+}
+
+static struct Hunter* read_hunter(struct CheckpointReader* reader, struct House* house) {
+    struct Hunter* hunter = calloc(1, sizeof(struct Hunter));
+    if (!hunter) return NULL;
+    hunter->entity.kind = ENTITY_HUNTER;
+    hunter->house = house;
+    hunter->room_slot = -1;
+    roomstack_init(&hunter->path);
+    get_string(reader, hunter->name, sizeof(hunter->name));
+    hunter->id = get_i32(reader);
+    struct Room* room = room_at(house, reader, get_i32(reader));
+    hunter->device = (enum EvidenceType)get_i32(reader);
+    hunter->rng_state = get_u32(reader);
+    hunter->turns = get_i32(reader);
+    hunter->boredom = get_i32(reader);
+    hunter->fear = get_i32(reader);
+    hunter->return_to_van = get_i32(reader) != 0;
+    hunter->is_running = get_i32(reader) != 0;
+    hunter->exit_reason = (enum LogReason)get_i32(reader);
+    int depth = get_i32(reader);
+    for (int i = 0; i < depth && !reader->failed; i++) {
+        roomstack_push(&hunter->path, room_at(house, reader, get_i32(reader)));
+    }
+    long long log_offset = get_i64(reader);
+    if (reader->failed) {
+        hunter_cleanup(hunter);
+        return NULL;
+    }
+    if (hunter->is_running && room) {
+        if (!room_add_hunter(room, hunter)) {
+            hunter_cleanup(hunter);
+            return NULL;
+        }
+        __atomic_add_fetch(&house->device_holders[evidence_to_index(hunter->device)], 1, __ATOMIC_RELAXED);
+        log_rewind(hunter->id, log_offset);
+    } else {
+        hunter->is_running = false;
+    }
+    return hunter;
+}
+
+static bool read_entities(struct CheckpointReader* reader, struct House* house, int ghost_count, int hunter_count) {
+    house->ghosts = calloc(ghost_count, sizeof(struct Ghost*));
+    if (!house->ghosts) return false;
+    for (int i = 0; i < ghost_count && !reader->failed; i++) {
+        struct Ghost* ghost = read_ghost(reader, house);
+        if (!ghost) return false;
+        house->ghosts[house->ghost_count++] = ghost;
+    }
+    for (int i = 0; i < hunter_count && !reader->failed; i++) {
+        struct Hunter* hunter = read_hunter(reader, house);
+        if (!hunter) return false;
+        if (!hunter_collection_append(house, hunter)) {
+            if (hunter->current_room) {
+                room_remove_hunter(hunter->current_room, hunter);
+            }
+            hunter_cleanup(hunter);
+            return false;
+        }
+    }
+    return !reader->failed;
+}
+
+// Rebuilds a house from a checkpoint. The checkpoint decides everything that shapes the
+// simulation; options about how it runs (speed, output, execution mode) stay as given.
+struct House* house_restore(const char* path, struct SimConfig* config) {
+    if (!path || !config) return NULL;
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        fprintf(stderr, "Failed to open checkpoint %s\n", path);
+        return NULL;
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    unsigned char* data = size > 0 ? malloc(size) : NULL;
+    bool read_ok = data && fread(data, 1, size, file) == (size_t)size;
+    fclose(file);
+    if (!read_ok) {
+        fprintf(stderr, "Failed to read checkpoint %s\n", path);
+        free(data);
+        return NULL;
+    }
+
+    struct CheckpointReader reader = { data, (size_t)size, 0, false };
+    char magic[4];
+    get_bytes(&reader, magic, 4);
+    if (memcmp(magic, CHECKPOINT_MAGIC, 4) != 0 || get_u32(&reader) != CHECKPOINT_VERSION) {
+        fprintf(stderr, "%s is not a checkpoint this build can read\n", path);
+        free(data);
+        return NULL;
+    }
+    config->device_policy = (enum DevicePolicy)get_i32(&reader);
+    config->explore_policy = (enum ExplorePolicy)get_i32(&reader);
+    config->wake_mode = (enum WakeMode)get_i32(&reader);
+    config->seed = get_u32(&reader);
+    config->seeded = true;
+    config->room_capacity = get_i32(&reader);
+    config->ghost_count = get_i32(&reader);
+    config->layout_rooms = get_i32(&reader);
+    int room_count = get_i32(&reader);
+    int starting_room = get_i32(&reader);
+    unsigned move_clock = get_u32(&reader);
+    int ghost_count = get_i32(&reader);
+    int hunter_count = get_i32(&reader);
+
+    struct House* house = NULL;
+    bool ok = !reader.failed && room_count > 0 && ghost_count > 0 && ghost_count == config->ghost_count;
+    if (ok) {
+        house = house_init();
+        ok = house && house_reserve_rooms(house, room_count);
+    }
+    if (ok) {
+        house->config = *config;
+        house->room_count = room_count;
+        house->move_clock = move_clock;
+        ok = read_rooms(&reader, house, ghost_count);
+        house->starting_room = room_at(house, &reader, starting_room);
+        ok = ok && house->starting_room && read_entities(&reader, house, ghost_count, hunter_count);
+    }
+    free(data);
+    if (!ok) {
+        fprintf(stderr, "Checkpoint %s is damaged\n", path);
+        house_cleanup(house);
+        return NULL;
+    }
+    return house;
+}
@@ -0,0 +1,186 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <time.h>
+#include "defs.h"
+#include "helpers.h"
+
+// Lock contention profiler. Every room semaphore and case file mutex gets a slot; each
+// thread counts into its own block of slots, so taking a lock costs a trywait and one or
+// two clock reads but never a shared write. The blocks outlive their threads and are
+// merged when the report is printed. The timeline reuses the slots to show contended
+// waits without counting anything.
+
+struct LockCounters {
+    unsigned long acquisitions;
+    unsigned long contended;    // the trywait failed and the thread had to block
+    long long wait_ns;
+    long long max_wait_ns;
+    long long hold_ns;
+    long long max_hold_ns;
+    long long held_since;       // monotonic ns of the current acquisition by this thread
+};
+
+struct ThreadLockStats {
+    struct ThreadLockStats* next;
+    struct LockCounters counters[];
+};
+
+static bool contention_enabled = false;     // locks have slots
+static bool counting_waits = false;
+static const struct House* profiled_house = NULL;
+static int slot_count = 0;          // rooms first, then one case file per ghost
+static struct ThreadLockStats* all_stats = NULL;
+static pthread_mutex_t all_stats_lock = PTHREAD_MUTEX_INITIALIZER;
+static _Thread_local struct ThreadLockStats* local_stats = NULL;
+
+static long long monotonic_ns() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long long)now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+static struct LockCounters* counters_for(int slot) {
+    if (!local_stats) {
+        local_stats = calloc(1, sizeof(struct ThreadLockStats) + (size_t)slot_count * sizeof(struct LockCounters));
+        if (!local_stats) return NULL;
+        pthread_mutex_lock(&all_stats_lock);
+        local_stats->next = all_stats;
+        all_stats = local_stats;
+        pthread_mutex_unlock(&all_stats_lock);
+    }
+    return &local_stats->counters[slot];
+}
+
+// Has to run before the entity threads start; setup before it isn't counted
+void contention_start(const struct House* house, bool count_waits) {
+    if (!house) return;
+    profiled_house = house;
+    slot_count = house->room_count + house->ghost_count;
+    contention_enabled = slot_count > 0;
+    counting_waits = counting_waits || count_waits;
+}
+
+int contention_room_slot(const struct Room* room) {
+    if (!contention_enabled || !room) return -1;
+    const struct Room* rooms = profiled_house->rooms;
+    if (room < rooms || room >= rooms + profiled_house->room_count) return -1;
+    return (int)(room - rooms);
+}
+
+int contention_casefile_slot(const struct CaseFile* case_file) {
+    if (!contention_enabled || !case_file) return -1;
+    for (int i = 0; i < profiled_house->ghost_count; i++) {
+        if (&profiled_house->ghosts[i]->case_file == case_file) {
+            return profiled_house->room_count + i;
+        }
+    }
+    return -1;
+}
+
+bool contention_slot_name(int slot, char* buffer, size_t size) {
+    if (!contention_enabled || slot < 0 || slot >= slot_count) return false;
+    if (slot < profiled_house->room_count) {
+        snprintf(buffer, size, "%s", profiled_house->rooms[slot].name);
+    } else {
+        snprintf(buffer, size, "case file %d", profiled_house->ghosts[slot - profiled_house->room_count]->id);
+    }
+    return true;
+}
+
+void contention_wait(sem_t* sem, int slot) {
+    if (slot < 0) {
+        while (sem_wait(sem) != 0 && errno == EINTR) {}
+        return;
+    }
+    struct LockCounters* counters = counting_waits ? counters_for(slot) : NULL;
+    if (sem_trywait(sem) == 0) {
+        if (counters) {
+            counters->held_since = monotonic_ns();
+            counters->acquisitions++;
+        }
+        return;
+    }
+    long long began = monotonic_ns();
+    while (sem_wait(sem) != 0 && errno == EINTR) {}
+    long long acquired = monotonic_ns();
+    timeline_lock_wait(slot, began, acquired);
+    if (!counters) return;
+    long long waited = acquired - began;
+    counters->contended++;
+    counters->wait_ns += waited;
+    if (waited > counters->max_wait_ns) counters->max_wait_ns = waited;
+    counters->held_since = acquired;
+    counters->acquisitions++;
+}
+
+void contention_post(sem_t* sem, int slot) {
+    struct LockCounters* counters = slot >= 0 && local_stats ? &local_stats->counters[slot] : NULL;
+    if (counters && counters->held_since > 0) {
+        long long held = monotonic_ns() - counters->held_since;
+        counters->hold_ns += held;
+        if (held > counters->max_hold_ns) counters->max_hold_ns = held;
+        counters->held_since = 0;
+    }
+    sem_post(sem);
+}
+
+struct LockReportRow {
+    int slot;
+    struct LockCounters counters;
+};
+
+static int compare_wait(const void* a, const void* b) {
+    const struct LockCounters* x = &((const struct LockReportRow*)a)->counters;
+    const struct LockCounters* y = &((const struct LockReportRow*)b)->counters;
+    if (x->wait_ns != y->wait_ns) return x->wait_ns < y->wait_ns ? 1 : -1;
+    return (x->acquisitions < y->acquisitions) - (x->acquisitions > y->acquisitions);
+}
+
+// Prints one line per lock that was taken, most time spent waiting first
+void contention_report() {
+    if (!counting_waits) return;
+    struct LockReportRow* rows = calloc(slot_count, sizeof(struct LockReportRow));
+    if (!rows) return;
+    for (int s = 0; s < slot_count; s++) {
+        rows[s].slot = s;
+    }
+    pthread_mutex_lock(&all_stats_lock);
+    for (struct ThreadLockStats* stats = all_stats; stats; stats = stats->next) {
+        for (int s = 0; s < slot_count; s++) {
+            const struct LockCounters* counters = &stats->counters[s];
+            struct LockCounters* merged = &rows[s].counters;
+            merged->acquisitions += counters->acquisitions;
+            merged->contended += counters->contended;
+            merged->wait_ns += counters->wait_ns;
+            merged->hold_ns += counters->hold_ns;
+            if (counters->max_wait_ns > merged->max_wait_ns) merged->max_wait_ns = counters->max_wait_ns;
+            if (counters->max_hold_ns > merged->max_hold_ns) merged->max_hold_ns = counters->max_hold_ns;
+        }
+    }
+    pthread_mutex_unlock(&all_stats_lock);
+    qsort(rows, slot_count, sizeof(struct LockReportRow), compare_wait);
+
+    printf("\n--- Lock Contention ---\n");
+    printf("%-24s %10s %10s %7s %11s %11s %11s %11s\n", "lock", "acquired", "contended", "rate",
+           "wait ms", "max wait us", "hold ms", "max hold us");
+    int printed = 0;
+    for (int i = 0; i < slot_count; i++) {
+        const struct LockCounters* counters = &rows[i].counters;
+        if (counters->acquisitions == 0) continue;
+        char name[MAX_ROOM_NAME + 16];
+        contention_slot_name(rows[i].slot, name, sizeof(name));
+        printf("%-24.24s %10lu %10lu %6.1f%% %11.2f %11.1f %11.2f %11.1f\n", name, counters->acquisitions,
+               counters->contended, 100.0 * counters->contended / counters->acquisitions,
+               counters->wait_ns / 1e6, counters->max_wait_ns / 1e3, counters->hold_ns / 1e6,
+               counters->max_hold_ns / 1e3);
+        printed++;
+    }
+    if (printed == 0) {
+        printf("No profiled locks were taken\n");
+    }
+    free(rows);
+}
@@ -2,8 +2,11 @@
 #define DEFS_H
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <semaphore.h>
 #include <pthread.h>
+#include <time.h>
+#include <sys/types.h>
 
 #define MAX_ROOM_NAME 64
 #define MAX_HUNTER_NAME 64
@@ -13,15 +16,51 @@
 #define ENTITY_BOREDOM_MAX 15
 #define HUNTER_FEAR_MAX 15
 #define DEFAULT_GHOST_ID 68057
+#define HUNTER_TURN_NS 100000000L
+#define GHOST_TURN_NS 150000000L
+#define EVIDENCE_MASK_COUNT 128
+#define GHOST_EVIDENCE_COUNT 3
+#define EVIDENCE_TYPE_COUNT 7
+#define ACTOR_IDLE_NS 2000000L
+#define CHECK_RING_SIZE 65536UL             // events in flight to the checker, a power of two
+#define CHECK_TOLERANCE_NS 250000000LL      // how long cross-entity state may look wrong
+#define CHECK_IDLE_NS 1000000L
+#define CHECK_REPORT_LIMIT 5                // violations of one kind printed as they happen
+#define TELEMETRY_MAGIC 0x31544847u         // "GHT1" at the start of a published segment
+#define TELEMETRY_VERSION 1
+#define TELEMETRY_PUBLISH_NS 100000000L     // how often the run-wide counters are refreshed
+#define TELEMETRY_NAME_LENGTH 16
 
 typedef unsigned char EvidenceByte;
 
+enum EntityKind {
+    ENTITY_HUNTER = 0,
+    ENTITY_GHOST = 1
+};
+
+// Stored as the first member of Hunter and Ghost so code handed a bare entity
+// pointer can tell which one it has
+struct Entity {
+    enum EntityKind kind;
+    struct Entity* next_message;    // actor mode: link while queued in a worker's inbox
+    long long next_turn_ns;         // actor mode: monotonic time the next turn is due
+    struct TraceStream* trace;      // record/replay stream of this entity, NULL when off
+};
+
 enum LogReason {
     LR_EVIDENCE = 0,
     LR_BORED = 1,
     LR_AFRAID = 2
 };
 
+// Why a ghost left the house
+enum GhostExitReason {
+    GHOST_EXIT_NONE = 0,        // still haunting
+    GHOST_EXIT_BORED,
+    GHOST_EXIT_HUNTERS_LEFT,
+    GHOST_EXIT_SHUTDOWN         // the run was stopped with hunters still inside
+};
+
 enum EvidenceType {
     EV_EMF          = 1 << 0,
     EV_ORBS         = 1 << 1,
@@ -59,9 +98,85 @@ enum GhostType {
     GH_SPIRIT       = EV_WRITING      | EV_RADIO       | EV_EMF,
 };
 
+enum DevicePolicy {
+    DEVICE_POLICY_RANDOM = 0,
+    DEVICE_POLICY_INFORMED = 1
+};
+
+enum ExplorePolicy {
+    EXPLORE_POLICY_RANDOM = 0,
+    EXPLORE_POLICY_FRONTIER = 1
+};
+
+enum WakeMode {
+    WAKE_MODE_TICK = 0,     // sleep a fixed interval between turns
+    WAKE_MODE_EVENT = 1     // sleep until the interval ends or the current room changes
+};
+
+enum ExecMode {
+    EXEC_MODE_THREADS = 0,  // one thread per entity, rooms guarded by semaphores
+    EXEC_MODE_ACTORS = 1    // one worker per room partition, entities migrate between workers
+};
+
+enum TraceMode {
+    TRACE_OFF = 0,
+    TRACE_RECORD = 1,   // every entity appends its nondeterministic inputs to its stream
+    TRACE_REPLAY = 2    // every entity reads them back instead of the live values
+};
+
+// Timed parts of a turn; each whole turn is timed as well
+enum TurnPhase {
+    PHASE_HUNTER_TURN = 0,
+    PHASE_HUNTER_UPDATE_STATS,
+    PHASE_HUNTER_EXIT_CHECK,
+    PHASE_HUNTER_VAN_CHECK,
+    PHASE_HUNTER_GATHER,
+    PHASE_HUNTER_MOVE,
+    PHASE_GHOST_TURN,
+    PHASE_GHOST_UPDATE_STATS,
+    PHASE_GHOST_EXIT_CHECK,
+    PHASE_GHOST_ACTION,
+    PHASE_COUNT
+};
+
+// Room state changes entities can wait for
+enum RoomEvent {
+    ROOM_EVENT_HUNTER   = 1 << 0,   // a hunter entered or left
+    ROOM_EVENT_GHOST    = 1 << 1,   // a ghost arrived or left
+    ROOM_EVENT_EVIDENCE = 1 << 2,   // evidence was dropped
+};
+#define ROOM_EVENT_KINDS 3
+
+struct SimConfig {
+    enum DevicePolicy device_policy;
+    enum ExplorePolicy explore_policy;
+    enum WakeMode wake_mode;
+    bool fast;          // skip the per-turn sleeps and log pacing
+    bool seeded;
+    unsigned seed;
+    int room_capacity;  // hunters per room; the van grows to fit everyone
+    size_t stack_size;  // bytes per entity thread, 0 for the system default
+    bool quiet;         // no per-event console output
+    bool log_files;     // write log_<id>.csv files
+    bool check;         // run the online invariant checker
+    bool contention;    // profile waits on room and case file locks
+    bool phase_times;   // histogram how long every phase of a turn takes
+    bool perf_counters; // read hardware performance counters around every phase of a turn
+    bool evidence_latency; // measure how long dropped evidence waits for a hunter
+    int ghost_count;
+    enum ExecMode exec_mode;
+    int worker_count;   // actor mode workers, 0 for one per online CPU
+    int layout_rooms;   // rooms in a generated grid layout, 0 for Willow House
+};
+
+// Bit i of a GhostSet refers to the i-th entry of get_all_ghost_types()
+typedef uint32_t GhostSet;
+
 struct CaseFile {
     EvidenceByte collected;
+    GhostSet candidates;
     bool solved;
+    int solved_turn;
     sem_t mutex;
 };
 
@@ -78,22 +193,41 @@ struct Room {
     char name[MAX_ROOM_NAME];
     struct Room* connections[MAX_CONNECTIONS];
     int connection_count;
-    struct Hunter* hunters[MAX_ROOM_OCCUPANCY];
+    struct Hunter** hunters;
     int hunter_count;
-    struct Ghost* ghost;
-    EvidenceByte evidence;
+    int hunter_capacity;
+    int ghost_count;
+    EvidenceByte* evidence;     // one mask per ghost, indexed by Ghost::index
+    int evidence_slots;
+    EvidenceByte evidence_any;  // union of every ghost's mask
     bool is_exit;
     sem_t sem;
+    // Shared exploration map, written with atomics outside of sem
+    unsigned visits;
+    unsigned last_visit;        // house move clock value at the latest hunter arrival
+    EvidenceByte sighted;       // evidence hunters have seen here but not yet collected
+    // Change notifications, one counter per RoomEvent kind
+    unsigned event_counts[ROOM_EVENT_KINDS];
+    int waiters;
+    pthread_mutex_t wait_lock;
+    pthread_cond_t changed;
+    // Actor mode: only the owning worker touches the room, so sem is skipped
+    struct Worker* owner;
+    int occupancy;              // hunters present or on their way in, reserved atomically
 };
 
 struct Hunter {
+    struct Entity entity;
     char name[MAX_HUNTER_NAME];
     int id;
+    int index;                  // position in House::hunters
     struct Room* current_room;
+    int room_slot;              // index in current_room->hunters, for O(1) removal
     struct House* house;
-    struct CaseFile* case_file;
     enum EvidenceType device;
     struct RoomStack path;
+    unsigned rng_state;
+    int turns;
     int boredom;
     int fear;
     bool return_to_van;
@@ -102,41 +236,199 @@ struct Hunter {
 };
 
 struct Ghost {
+    struct Entity entity;
     int id;
+    int index;                  // position in House::ghosts
+    struct CaseFile case_file;  // what hunters have found out about this ghost
     enum GhostType type;
+    enum EvidenceType evidence[GHOST_EVIDENCE_COUNT];
+    int evidence_count;
     struct Room* current_room;
+    struct House* house;
+    unsigned rng_state;
+    int turns;
     int boredom;
     bool is_running;
+    enum GhostExitReason exit_reason;
+};
+
+// Actor mode: runs the turns of every entity standing in one partition of the rooms
+struct Worker {
+    int index;
+    struct House* house;
+    struct Entity* inbox;       // entities handed over by other workers, pushed lock-free
+    struct Entity** residents;  // entities in this worker's rooms, only touched by the worker
+    int resident_count;
+    int resident_capacity;
+    int room_count;
+    long turns;
+    long handoffs;              // entities this worker passed to another partition
+    pthread_t thread;
+    bool started;
+};
+
+// Recorded inputs of one entity, written only by the thread running its turn
+struct TraceStream {
+    unsigned char* data;
+    size_t length;
+    size_t capacity;
+    size_t position;            // replay read position
+    long long last_clock;       // timestamps are stored as deltas from this
+    int entity_id;
+    struct Entity* owner;       // replay: the entity whose turns this stream drives
+};
+
+// Live telemetry segment, shared read-only with ghost_hunter_top. Every record that
+// changes during the run starts with a seqlock counter: its one writer makes it odd
+// while it stores, so a reader retries whenever it sees an odd or changed value.
+// Names are written once before the header's magic is, and never change.
+struct TelemetryHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t size;                  // bytes in the whole segment
+    int32_t pid;
+    int32_t room_count;
+    int32_t hunter_count;
+    int32_t ghost_count;
+    uint32_t rooms_offset;
+    uint32_t hunters_offset;
+    uint32_t ghosts_offset;
+    uint32_t cases_offset;
+    char device_names[EVIDENCE_TYPE_COUNT][TELEMETRY_NAME_LENGTH];
+    long long started_ns;           // CLOCK_MONOTONIC when publishing began
+    // Refreshed every TELEMETRY_PUBLISH_NS by the simulator's publisher thread
+    uint32_t seq;
+    int32_t finished;
+    long long updated_ns;
+    long long events;               // events logged so far
+};
+
+struct TelemetryRoom {
+    uint32_t seq;                   // written by whoever holds the room
+    int32_t hunters;
+    int32_t ghosts;
+    uint32_t evidence;              // union of every ghost's evidence mask
+    char name[MAX_ROOM_NAME];
+};
+
+struct TelemetryHunter {
+    uint32_t seq;                   // written by the thread running the hunter's turn
+    int32_t room;                   // index of the room, -1 once the hunter left
+    int32_t boredom;
+    int32_t fear;
+    int32_t device;                 // evidence_to_index() of the device held
+    int32_t turns;
+    int32_t running;
+    int32_t id;
+    char name[MAX_HUNTER_NAME];
+};
+
+struct TelemetryGhost {
+    uint32_t seq;                   // written by the thread running the ghost's turn
+    int32_t room;
+    int32_t boredom;
+    int32_t turns;
+    int32_t running;
+    int32_t id;
+    char type[TELEMETRY_NAME_LENGTH];
+};
+
+struct TelemetryCase {
+    uint32_t seq;                   // written under the case file's mutex
+    uint32_t collected;
+    uint32_t candidates;            // GhostSet still consistent with the evidence
+    int32_t solved;
+    int32_t solved_turn;
+};
+
+// Alternative futures forked from one paused moment of a run
+struct BranchSet {
+    int count;
+    pid_t* pids;
+    int* outcome_fds;           // read end of each branch's outcome pipe
+    double fork_ms;             // how long the run stood paused while forking
 };
 
 struct House {
-    struct Room rooms[MAX_ROOMS];
+    struct Room* rooms;
     int room_count;
+    int max_rooms;
     struct Hunter** hunters;
     int hunter_count;
     int hunter_capacity;
-    struct CaseFile case_file;
-    struct Ghost* ghost;
+    struct Ghost** ghosts;
+    int ghost_count;
     struct Room* starting_room;
+    struct SimConfig config;
+    int device_holders[EVIDENCE_TYPE_COUNT];
+    unsigned move_clock;
+    // Shutdown coordination: the run ends once every ghost leaves or no hunter is left
+    int live_hunters;
+    int live_ghosts;
+    bool shutdown;
+    struct timespec shutdown_at;
+    pthread_mutex_t done_lock;
+    pthread_cond_t done;
+    // Checkpoints pause every entity between turns to get a consistent cut. Only a run
+    // started with pausing allowed brackets its turns, so other runs share no counter.
+    bool pausable;
+    bool pause_turns;
+    int active_turns;
+    pthread_cond_t turns_quiet;
+    pthread_cond_t turns_resumed;
+    struct Worker* workers;
+    int worker_count;
 };
 
 // House functions
+void simconfig_init(struct SimConfig* config);
 struct House* house_init();
+bool house_reserve_rooms(struct House* house, int count);
+bool house_apply_config(struct House* house);
+bool house_add_ghosts(struct House* house, int count);
+bool house_all_cases_solved(struct House* house);
 void house_cleanup(struct House* house);
-void hunter_collection_append(struct House* house, struct Hunter* hunter);
+bool hunter_collection_append(struct House* house, struct Hunter* hunter);
+void house_request_shutdown(struct House* house);
+bool house_is_shutting_down(struct House* house);
+void house_hunter_started(struct House* house);
+void house_hunter_exited(struct House* house);
+void house_ghost_started(struct House* house);
+void house_ghost_exited(struct House* house);
+void house_wait_done(struct House* house);
+bool house_wait_done_for(struct House* house, long timeout_ms);
+bool house_wait_done_ns(struct House* house, long long timeout_ns);
+void house_turn_begin(struct House* house);
+void house_turn_end(struct House* house);
+bool house_pause_turns(struct House* house);
+void house_resume_turns(struct House* house);
+void house_reset_after_fork(struct House* house);
 
 // Room functions
 void room_init(struct Room* room, const char* name, bool is_exit);
 void rooms_connect(struct Room* a, struct Room* b);
+bool room_set_capacity(struct Room* room, int capacity);
+bool room_set_evidence_slots(struct Room* room, int slots);
 bool room_add_hunter(struct Room* room, struct Hunter* hunter);
 void room_remove_hunter(struct Room* room, struct Hunter* hunter);
-void room_set_ghost(struct Room* room, struct Ghost* ghost);
-void room_remove_ghost(struct Room* room);
-void room_add_evidence(struct Room* room, enum EvidenceType evidence);
-bool room_remove_evidence(struct Room* room, enum EvidenceType evidence);
+void room_add_ghost(struct Room* room, struct Ghost* ghost);
+void room_remove_ghost(struct Room* room, struct Ghost* ghost);
+void room_add_evidence(struct Room* room, int ghost_index, enum EvidenceType evidence);
+bool room_remove_evidence(struct Room* room, int ghost_index, enum EvidenceType evidence);
 bool room_has_evidence(struct Room* room, enum EvidenceType evidence);
+EvidenceByte room_get_evidence(struct Room* room);
+void room_record_visit(struct Room* room, unsigned clock);
+void room_record_sighting(struct Room* room, EvidenceByte seen);
+void room_clear_sighting(struct Room* room, enum EvidenceType evidence);
 bool room_move_entity(struct Room* from, struct Room* to, void* entity);
+void room_accept_entity(struct Room* room, struct Entity* entity);
+void room_notify(struct Room* room, unsigned events);
+unsigned room_event_snapshot(struct Room* room, unsigned interest);
+bool room_wait_event(struct Room* room, unsigned interest, unsigned snapshot, long timeout_ns, const bool* cancel);
+void room_interrupt_waiters(struct Room* room);
 struct Room* room_get_random_connection(struct Room* room);
+struct Room* room_get_frontier_connection(struct Room* room, unsigned clock, enum EvidenceType device);
+void room_reset_after_fork(struct Room* room);
 void room_cleanup(struct Room* room);
 
 // Evidence functions
@@ -146,10 +438,16 @@ bool evidence_contains(EvidenceByte mask, enum EvidenceType evidence);
 int evidence_count_unique(EvidenceByte mask);
 bool evidence_has_three_unique(EvidenceByte mask);
 enum EvidenceType evidence_get_random_type();
+int evidence_to_index(enum EvidenceType evidence);
+GhostSet evidence_candidates(EvidenceByte mask);
+int evidence_candidate_count(EvidenceByte mask);
+enum GhostType evidence_identify_ghost(EvidenceByte mask);
+EvidenceByte evidence_discriminating_devices(EvidenceByte mask);
 void casefile_init(struct CaseFile* case_file);
-void casefile_add_evidence(struct CaseFile* case_file, enum EvidenceType evidence);
+void casefile_add_evidence(struct CaseFile* case_file, enum EvidenceType evidence, int turn);
 bool casefile_is_solved(struct CaseFile* case_file);
 EvidenceByte casefile_get_evidence(struct CaseFile* case_file);
+GhostSet casefile_get_candidates(struct CaseFile* case_file);
 void casefile_cleanup(struct CaseFile* case_file);
 
 // RoomStack functions
@@ -165,19 +463,121 @@ void hunter_cleanup(struct Hunter* hunter);
 void hunter_update_stats(struct Hunter* hunter);
 bool hunter_check_exit_conditions(struct Hunter* hunter);
 void hunter_van_check(struct Hunter* hunter);
+enum EvidenceType hunter_choose_device(struct Hunter* hunter);
 void hunter_gather_evidence(struct Hunter* hunter);
 void hunter_move(struct Hunter* hunter);
 void hunter_take_turn(struct Hunter* hunter);
+void hunter_leave_house(struct Hunter* hunter);
 void* hunter_thread(void* arg);
 
 // Ghost functions
-struct Ghost* ghost_init(struct House* house);
+struct Ghost* ghost_init(struct House* house, int index);
+void ghost_set_type(struct Ghost* ghost, enum GhostType type);
 void ghost_cleanup(struct Ghost* ghost);
 void ghost_update_stats(struct Ghost* ghost);
 bool ghost_check_exit_condition(struct Ghost* ghost);
 void ghost_take_action(struct Ghost* ghost);
 void ghost_take_turn(struct Ghost* ghost);
+void ghost_leave_house(struct Ghost* ghost);
 void* ghost_thread(void* arg);
 EvidenceByte ghost_get_evidence_requirements(struct Ghost* ghost);
 
+// Checkpoint functions
+bool house_checkpoint(struct House* house, const char* path, long* bytes_written);
+struct House* house_restore(const char* path, struct SimConfig* config);
+
+// Actor execution functions
+int actor_partition_rooms(struct House* house, int parts, int* assignment);
+bool actors_start(struct House* house);
+void actors_join(struct House* house);
+void actors_release_rooms(struct House* house);
+void actors_cleanup(struct House* house);
+
+// Branch functions
+bool house_branch(struct House* house, int count, struct BranchSet* branches);
+long house_run_inline(struct House* house);
+void branches_collect(struct BranchSet* branches);
+
+// Batch functions
+typedef struct House* (*BatchHouseFactory)(const struct SimConfig* config, const void* context);
+bool batch_run(const struct SimConfig* config, long long runs, int workers, double precision,
+               BatchHouseFactory create, const void* context);
+
+// Invariant checker functions
+bool checker_start(struct House* house);
+void checker_submit(bool is_ghost, int entity_id, const char* action, const char* room,
+                    const char* extra, const char* device, int boredom, int fear);
+void checker_detach();
+long checker_stop();
+
+// Contention profiler functions
+void contention_start(const struct House* house, bool count_waits);
+bool contention_slot_name(int slot, char* buffer, size_t size);
+int contention_room_slot(const struct Room* room);
+int contention_casefile_slot(const struct CaseFile* case_file);
+void contention_wait(sem_t* sem, int slot);
+void contention_post(sem_t* sem, int slot);
+void contention_report();
+
+// Turn phase timing functions
+bool phase_timing_start();
+void phase_timing_emit_spans();
+void phase_timing_read_counters();
+const char* phase_name(enum TurnPhase phase);
+long long phase_clock();
+long long phase_end(enum TurnPhase phase, long long began);
+void phase_timing_report(const char* title);
+void phase_timing_stop();
+
+// Performance counter functions
+bool perf_counters_start();
+void perf_counters_turn_begin();
+void perf_counters_phase_end(enum TurnPhase phase);
+void perf_counters_report();
+
+// Evidence lifecycle functions
+bool lifecycle_start(const struct House* house);
+void lifecycle_dropped(const struct Room* room, int ghost_index, enum EvidenceType evidence);
+void lifecycle_collected(const struct Room* room, int ghost_index, enum EvidenceType evidence);
+void lifecycle_report();
+void lifecycle_free();
+
+// Telemetry functions
+bool telemetry_start(const struct House* house, const char* name);
+void telemetry_room(const struct Room* room);
+void telemetry_hunter(const struct Hunter* hunter);
+void telemetry_ghost(const struct Ghost* ghost);
+void telemetry_case(const struct CaseFile* case_file);
+void telemetry_detach();
+void telemetry_stop();
+
+// Timeline functions
+bool timeline_start(const struct House* house);
+void timeline_enter(enum EntityKind kind, int entity_id);
+void timeline_span(enum TurnPhase phase, long long began, long long ended);
+void timeline_lock_wait(int slot, long long began, long long acquired);
+void timeline_instant(bool is_ghost, int entity_id, const char* action, const char* room,
+                      const char* device, const char* extra);
+bool timeline_write(const char* path, long* events_written);
+void timeline_free();
+
+// Trace functions
+enum TraceMode trace_get_mode();
+void trace_bind(struct TraceStream* stream);
+void trace_turn();
+int trace_random(int value);
+int trace_observe(int value);
+bool trace_move(bool moved);
+long long trace_clock(long long timestamp);
+bool trace_has_diverged();
+void trace_start_recording();
+bool trace_attach_entities(struct House* house);
+bool trace_save(const char* path, struct House* house, long* bytes_written);
+bool trace_load(const char* path, struct SimConfig* config);
+int trace_hunter_count();
+const char* trace_hunter_name(int index);
+int trace_hunter_id(int index);
+int trace_replay(struct House* house);
+void trace_free();
+
 #endif
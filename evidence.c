@@ -1,80 +1,193 @@
-#include <stdio.h>
-#include <stdlib.h>
-#include "defs.h"
-#include "helpers.h"
-
-EvidenceByte evidence_add(EvidenceByte mask, enum EvidenceType evidence) {
-    return mask | evidence;
-}
-
-EvidenceByte evidence_remove(EvidenceByte mask, enum EvidenceType evidence) {
-    return mask & ~evidence;
-}
-
-bool evidence_contains(EvidenceByte mask, enum EvidenceType evidence) {
-    return (mask & evidence) != 0;
-}
-
-int evidence_count_unique(EvidenceByte mask) {
-    int count = 0;
-    const enum EvidenceType* evidence_types = NULL;
-    int type_count = get_all_evidence_types(&evidence_types);
-    for (int i = 0; i < type_count; i++) {
-        if (evidence_contains(mask, evidence_types[i])) {
-            count++;
-        }
-    }
-    return count;
-}
-
-bool evidence_has_three_unique(EvidenceByte mask) {
-    return evidence_count_unique(mask) >= 3;
-}
-
-enum EvidenceType evidence_get_random_type() {
-    const enum EvidenceType* evidence_types = NULL;
-    int count = get_all_evidence_types(&evidence_types);
-    if (count == 0) return 0;
-    int index = rand_int_threadsafe(0, count);
-    return evidence_types[index];
-}
-
-void casefile_init(struct CaseFile* case_file) {
-    if (!case_file) return;
-    case_file->collected = 0;
-    case_file->solved = false;
-    if (sem_init(&case_file->mutex, 0, 1) != 0) {
-        fprintf(stderr, "Failed to initialize case file semaphore\n");
-    }
-}
-
-void casefile_add_evidence(struct CaseFile* case_file, enum EvidenceType evidence) {
-    if (!case_file) return;
-    sem_wait(&case_file->mutex);
-    case_file->collected |= evidence;
-    if (evidence_count_unique(case_file->collected) >= 3) {
-        case_file->solved = true;
-    }
-    sem_post(&case_file->mutex);
-}
-
-bool casefile_is_solved(struct CaseFile* case_file) {
-    if (!case_file) return false;
-    sem_wait(&case_file->mutex);
-    bool solved = case_file->solved;
-    sem_post(&case_file->mutex);
-    return solved;
-}
-
-EvidenceByte casefile_get_evidence(struct CaseFile* case_file) {
-    if (!case_file) return 0;
-    sem_wait(&case_file->mutex);
-    EvidenceByte collected = case_file->collected;
-    sem_post(&case_file->mutex);
-    return collected;
-}
-
-void casefile_cleanup(struct CaseFile* case_file) {
-    if (!case_file) return;
-    sem_destroy(&case_file->mutex);
+#include <stdio.h>
+#include <stdlib.h>
+#include "defs.h"
+#include "helpers.h"
+
+EvidenceByte evidence_add(EvidenceByte mask, enum EvidenceType evidence) {
+    return mask | evidence;
+}
+
+EvidenceByte evidence_remove(EvidenceByte mask, enum EvidenceType evidence) {
+    return mask & ~evidence;
+}
+
+bool evidence_contains(EvidenceByte mask, enum EvidenceType evidence) {
+    return (mask & evidence) != 0;
+}
+
+// ---- Precomputed evidence tables ----
+// Every table below is indexed by a 7-bit evidence mask and is built entirely from
+// constant expressions, so identifying a ghost never has to scan the ghost list.
+
+#define EVIDENCE_ALL_MASK 0x7F
+
+#define MASK_POPCOUNT(m) \
+    ((((m) >> 0) & 1) + (((m) >> 1) & 1) + (((m) >> 2) & 1) + (((m) >> 3) & 1) + \
+     (((m) >> 4) & 1) + (((m) >> 5) & 1) + (((m) >> 6) & 1))
+
+// A ghost stays a candidate while every collected bit is part of its evidence
+#define GHOST_FITS(m, ghost, bit) \
+    ((((m) & ~(ghost) & EVIDENCE_ALL_MASK) == 0) ? (1u << (bit)) : 0u)
+
+// Bit order must match the ghost list in get_all_ghost_types()
+#define GHOST_CANDIDATES(m) \
+    (GHOST_FITS(m, GH_POLTERGEIST, 0)  | GHOST_FITS(m, GH_THE_MIMIC, 1)  | \
+     GHOST_FITS(m, GH_HANTU, 2)        | GHOST_FITS(m, GH_JINN, 3)       | \
+     GHOST_FITS(m, GH_PHANTOM, 4)      | GHOST_FITS(m, GH_BANSHEE, 5)    | \
+     GHOST_FITS(m, GH_GORYO, 6)        | GHOST_FITS(m, GH_BULLIES, 7)    | \
+     GHOST_FITS(m, GH_MYLING, 8)       | GHOST_FITS(m, GH_OBAKE, 9)      | \
+     GHOST_FITS(m, GH_YUREI, 10)       | GHOST_FITS(m, GH_ONI, 11)       | \
+     GHOST_FITS(m, GH_MOROI, 12)       | GHOST_FITS(m, GH_REVENANT, 13)  | \
+     GHOST_FITS(m, GH_SHADE, 14)       | GHOST_FITS(m, GH_ONRYO, 15)     | \
+     GHOST_FITS(m, GH_THE_TWINS, 16)   | GHOST_FITS(m, GH_DEOGEN, 17)    | \
+     GHOST_FITS(m, GH_THAYE, 18)       | GHOST_FITS(m, GH_YOKAI, 19)     | \
+     GHOST_FITS(m, GH_WRAITH, 20)      | GHOST_FITS(m, GH_RAIJU, 21)     | \
+     GHOST_FITS(m, GH_MARE, 22)        | GHOST_FITS(m, GH_SPIRIT, 23))
+
+// A device still discriminates when finding it would shrink, but not empty, the candidate set
+#define DEVICE_SPLITS(m, ev) \
+    ((((m) & (ev)) == 0 && GHOST_CANDIDATES((m) | (ev)) != 0 && \
+      GHOST_CANDIDATES((m) | (ev)) != GHOST_CANDIDATES(m)) ? (ev) : 0)
+
+#define DISCRIMINATING_DEVICES(m) \
+    (DEVICE_SPLITS(m, EV_EMF) | DEVICE_SPLITS(m, EV_ORBS) | DEVICE_SPLITS(m, EV_RADIO) | \
+     DEVICE_SPLITS(m, EV_TEMPERATURE) | DEVICE_SPLITS(m, EV_FINGERPRINTS) | \
+     DEVICE_SPLITS(m, EV_WRITING) | DEVICE_SPLITS(m, EV_INFRARED))
+
+#define TABLE_ROW(F, b) F((b) + 0), F((b) + 1), F((b) + 2), F((b) + 3), \
+                        F((b) + 4), F((b) + 5), F((b) + 6), F((b) + 7)
+#define TABLE_128(F) \
+    TABLE_ROW(F, 0),  TABLE_ROW(F, 8),   TABLE_ROW(F, 16),  TABLE_ROW(F, 24), \
+    TABLE_ROW(F, 32), TABLE_ROW(F, 40),  TABLE_ROW(F, 48),  TABLE_ROW(F, 56), \
+    TABLE_ROW(F, 64), TABLE_ROW(F, 72),  TABLE_ROW(F, 80),  TABLE_ROW(F, 88), \
+    TABLE_ROW(F, 96), TABLE_ROW(F, 104), TABLE_ROW(F, 112), TABLE_ROW(F, 120)
+
+static const unsigned char evidence_popcount_table[EVIDENCE_MASK_COUNT] = {
+    TABLE_128(MASK_POPCOUNT)
+};
+
+static const GhostSet candidate_table[EVIDENCE_MASK_COUNT] = {
+    TABLE_128(GHOST_CANDIDATES)
+};
+
+static const EvidenceByte discriminating_table[EVIDENCE_MASK_COUNT] = {
+    TABLE_128(DISCRIMINATING_DEVICES)
+};
+
+// Only the 24 exact ghost masks are filled in, everything else stays 0
+static const enum GhostType ghost_by_mask[EVIDENCE_MASK_COUNT] = {
+    [GH_POLTERGEIST] = GH_POLTERGEIST, [GH_THE_MIMIC] = GH_THE_MIMIC,
+    [GH_HANTU] = GH_HANTU,             [GH_JINN] = GH_JINN,
+    [GH_PHANTOM] = GH_PHANTOM,         [GH_BANSHEE] = GH_BANSHEE,
+    [GH_GORYO] = GH_GORYO,             [GH_BULLIES] = GH_BULLIES,
+    [GH_MYLING] = GH_MYLING,           [GH_OBAKE] = GH_OBAKE,
+    [GH_YUREI] = GH_YUREI,             [GH_ONI] = GH_ONI,
+    [GH_MOROI] = GH_MOROI,             [GH_REVENANT] = GH_REVENANT,
+    [GH_SHADE] = GH_SHADE,             [GH_ONRYO] = GH_ONRYO,
+    [GH_THE_TWINS] = GH_THE_TWINS,     [GH_DEOGEN] = GH_DEOGEN,
+    [GH_THAYE] = GH_THAYE,             [GH_YOKAI] = GH_YOKAI,
+    [GH_WRAITH] = GH_WRAITH,           [GH_RAIJU] = GH_RAIJU,
+    [GH_MARE] = GH_MARE,               [GH_SPIRIT] = GH_SPIRIT,
+};
+
+int evidence_count_unique(EvidenceByte mask) {
+    return evidence_popcount_table[mask & EVIDENCE_ALL_MASK];
+}
+
+bool evidence_has_three_unique(EvidenceByte mask) {
+    return evidence_count_unique(mask) >= 3;
+}
+
+enum EvidenceType evidence_get_random_type() {
+    const enum EvidenceType* evidence_types = NULL;
+    int count = get_all_evidence_types(&evidence_types);
+    if (count == 0) return 0;
+    int index = rand_int_threadsafe(0, count);
+    return evidence_types[index];
+}
+
+int evidence_to_index(enum EvidenceType evidence) {
+    int index = 0;
+    unsigned bits = (unsigned)evidence & EVIDENCE_ALL_MASK;
+    if (bits == 0) return -1;
+    while (!(bits & 1u)) {
+        bits >>= 1;
+        index++;
+    }
+    return index;
+}
+
+GhostSet evidence_candidates(EvidenceByte mask) {
+    return candidate_table[mask & EVIDENCE_ALL_MASK];
+}
+
+int evidence_candidate_count(EvidenceByte mask) {
+    GhostSet set = evidence_candidates(mask);
+    int count = 0;
+    while (set) {
+        set &= set - 1;
+        count++;
+    }
+    return count;
+}
+
+enum GhostType evidence_identify_ghost(EvidenceByte mask) {
+    return ghost_by_mask[mask & EVIDENCE_ALL_MASK];
+}
+
+EvidenceByte evidence_discriminating_devices(EvidenceByte mask) {
+    return discriminating_table[mask & EVIDENCE_ALL_MASK];
+}
+
+void casefile_init(struct CaseFile* case_file) {
+    if (!case_file) return;
+    case_file->collected = 0;
+    case_file->candidates = evidence_candidates(0);
+    case_file->solved = false;
+    case_file->solved_turn = -1;
+    if (sem_init(&case_file->mutex, 0, 1) != 0) {
+        fprintf(stderr, "Failed to initialize case file semaphore\n");
+    }
+}
+
+void casefile_add_evidence(struct CaseFile* case_file, enum EvidenceType evidence, int turn) {
+    if (!case_file) return;
+    contention_wait(&case_file->mutex, contention_casefile_slot(case_file));
+    case_file->collected |= evidence;
+    case_file->candidates = evidence_candidates(case_file->collected);
+    if (!case_file->solved && evidence_count_unique(case_file->collected) >= 3) {
+        case_file->solved = true;
+        case_file->solved_turn = turn;
+    }
+    telemetry_case(case_file);
+    contention_post(&case_file->mutex, contention_casefile_slot(case_file));
+}
+
+bool casefile_is_solved(struct CaseFile* case_file) {
+    if (!case_file) return false;
+    contention_wait(&case_file->mutex, contention_casefile_slot(case_file));
+    bool solved = case_file->solved;
+    contention_post(&case_file->mutex, contention_casefile_slot(case_file));
+    return solved;
+}
+
+EvidenceByte casefile_get_evidence(struct CaseFile* case_file) {
+    if (!case_file) return 0;
+    contention_wait(&case_file->mutex, contention_casefile_slot(case_file));
+    EvidenceByte collected = case_file->collected;
+    contention_post(&case_file->mutex, contention_casefile_slot(case_file));
+    return collected;
+}
+
+GhostSet casefile_get_candidates(struct CaseFile* case_file) {
+    if (!case_file) return 0;
+    contention_wait(&case_file->mutex, contention_casefile_slot(case_file));
+    GhostSet candidates = case_file->candidates;
+    contention_post(&case_file->mutex, contention_casefile_slot(case_file));
+    return candidates;
+}
+
+void casefile_cleanup(struct CaseFile* case_file) {
+    if (!case_file) return;
+    sem_destroy(&case_file->mutex);
 }
\ No newline at end of file
@@ -1,126 +1,206 @@
-#define _POSIX_C_SOURCE 200112L
-
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-#include <unistd.h>
-#include <pthread.h>
-#include <time.h>
-#include "defs.h"
-#include "helpers.h"
-
-struct Ghost* ghost_init(struct House* house) {
-    if (!house || house->room_count == 0) return NULL;
-    struct Ghost* ghost = malloc(sizeof(struct Ghost));
-    if (!ghost) return NULL;
-
-    ghost->id = DEFAULT_GHOST_ID;
-    const enum GhostType* ghost_types = NULL;
-    int ghost_count = get_all_ghost_types(&ghost_types);
-    if (ghost_count > 0) {
-        ghost->type = ghost_types[rand_int_threadsafe(0, ghost_count)];
-    } else {
-        ghost->type = GH_POLTERGEIST;
-    }
-    int start_room_index = rand_int_threadsafe(0, house->room_count);
-    ghost->current_room = &house->rooms[start_room_index];
-    ghost->boredom = 0;
-    ghost->is_running = true;
-
-    room_set_ghost(ghost->current_room, ghost);
-
-    log_ghost_init(ghost->id, ghost->current_room->name, ghost->type);
-
-    return ghost;
-}
-
-void ghost_cleanup(struct Ghost* ghost) {
-    if (ghost && ghost->current_room) {
-        room_remove_ghost(ghost->current_room);
-    }
-    free(ghost);
-}
-
-void ghost_update_stats(struct Ghost* ghost) {
-    if (!ghost || !ghost->current_room) return;
-    if (ghost->current_room->hunter_count > 0) {
-        ghost->boredom = 0;
-    } else {
-        ghost->boredom++;
-    }
-}
-
-bool ghost_check_exit_condition(struct Ghost* ghost) {
-    if (!ghost) return false;
-    if (ghost->boredom > ENTITY_BOREDOM_MAX) {
-        ghost->is_running = false;
-        log_ghost_exit(ghost->id, ghost->boredom, ghost->current_room->name);
-        return true;
-    }
-    return false;
-}
-
-void ghost_take_action(struct Ghost* ghost) {
-    if (!ghost || !ghost->current_room) return;
-    int action = rand_int_threadsafe(0, 3);
-    switch (action) {
-        case 0:
-            log_ghost_idle(ghost->id, ghost->boredom, ghost->current_room->name);
-            break;
-        case 1: {
-            EvidenceByte ghost_evidence = (EvidenceByte)ghost->type;
-            const enum EvidenceType* all_evidence = NULL;
-            int evidence_count = get_all_evidence_types(&all_evidence);
-            enum EvidenceType available_evidence[7];
-            int available_count = 0;
-            for (int i = 0; i < evidence_count; i++) {
-                if (ghost_evidence & all_evidence[i]) {
-                    available_evidence[available_count++] = all_evidence[i];
-                }
-            }
-            if (available_count > 0) {
-                enum EvidenceType chosen_evidence =
-                    available_evidence[rand_int_threadsafe(0, available_count)];
-                room_add_evidence(ghost->current_room, chosen_evidence);
-                log_ghost_evidence(ghost->id, ghost->boredom,
-                                   ghost->current_room->name, chosen_evidence);
-            }
-            break;
-        }
-        case 2:
-            if (ghost->current_room->hunter_count == 0) {
-                struct Room* target_room = room_get_random_connection(ghost->current_room);
-                if (target_room && target_room != ghost->current_room) {
-                    const char* from_room = ghost->current_room->name;
-                    if (room_move_entity(ghost->current_room, target_room, ghost)) {
-                        log_ghost_move(ghost->id, ghost->boredom, from_room, target_room->name);
-                    }
-                }
-            } else {
-                log_ghost_idle(ghost->id, ghost->boredom, ghost->current_room->name);
-            }
-            break;
-    }
-}
-
-void* ghost_thread(void* arg) {
-    struct Ghost* ghost = (struct Ghost*)arg;
-    if (!ghost) return NULL;
-    printf("Ghost %d thread started\n", ghost->id);
-    while (ghost->is_running) {
-        ghost_update_stats(ghost);
-        if (ghost_check_exit_condition(ghost)) {
-            break;
-        }
-        ghost_take_action(ghost);
-	struct timespec ts = { .tv_sec = 0, .tv_nsec = 150000000L };
-        nanosleep(&ts, NULL);
-    }
-    printf("Ghost %d thread exiting\n", ghost->id);
-    return NULL;
-}
-
-EvidenceByte ghost_get_evidence_requirements(struct Ghost* ghost) {
-    if (!ghost) return 0;
-    return (EvidenceByte)ghost->type;
-}
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+#include "defs.h"
+#include "helpers.h"
+
+struct Ghost* ghost_init(struct House* house, int index) {
+    if (!house || house->room_count == 0) return NULL;
+    struct Ghost* ghost = malloc(sizeof(struct Ghost));
+    if (!ghost) return NULL;
+
+    ghost->entity.kind = ENTITY_GHOST;
+    ghost->entity.next_message = NULL;
+    ghost->entity.next_turn_ns = 0;
+    ghost->entity.trace = NULL;
+    ghost->id = DEFAULT_GHOST_ID + index;
+    ghost->index = index;
+    casefile_init(&ghost->case_file);
+    ghost->house = house;
+    ghost->rng_state = rand_stream_seed(house->config.seed, ghost->id);
+    ghost->turns = 0;
+    unsigned* previous_stream = rand_bind_stream(&ghost->rng_state);
+    const enum GhostType* ghost_types = NULL;
+    int ghost_count = get_all_ghost_types(&ghost_types);
+    if (ghost_count > 0) {
+        ghost_set_type(ghost, ghost_types[rand_int_threadsafe(0, ghost_count)]);
+    } else {
+        ghost_set_type(ghost, GH_POLTERGEIST);
+    }
+
+    int start_room_index = rand_int_threadsafe(0, house->room_count);
+    ghost->current_room = &house->rooms[start_room_index];
+    ghost->boredom = 0;
+    ghost->is_running = true;
+    ghost->exit_reason = GHOST_EXIT_NONE;
+    rand_bind_stream(previous_stream);
+
+    room_add_ghost(ghost->current_room, ghost);
+
+    log_ghost_init(ghost->id, ghost->current_room->name, ghost->type);
+
+    return ghost;
+}
+
+// The ghost's evidence never changes, so split it into single devices once
+void ghost_set_type(struct Ghost* ghost, enum GhostType type) {
+    if (!ghost) return;
+    ghost->type = type;
+    const enum EvidenceType* all_evidence = NULL;
+    int evidence_count = get_all_evidence_types(&all_evidence);
+    ghost->evidence_count = 0;
+    for (int i = 0; i < evidence_count && ghost->evidence_count < GHOST_EVIDENCE_COUNT; i++) {
+        if ((EvidenceByte)type & all_evidence[i]) {
+            ghost->evidence[ghost->evidence_count++] = all_evidence[i];
+        }
+    }
+}
+
+void ghost_cleanup(struct Ghost* ghost) {
+    if (!ghost) return;
+    if (ghost->current_room) {
+        room_remove_ghost(ghost->current_room, ghost);
+    }
+    casefile_cleanup(&ghost->case_file);
+    free(ghost);
+}
+
+void ghost_update_stats(struct Ghost* ghost) {
+    if (!ghost || !ghost->current_room) return;
+    if (trace_observe(ghost->current_room->hunter_count > 0)) {
+        ghost->boredom = 0;
+    } else {
+        ghost->boredom++;
+    }
+}
+
+bool ghost_check_exit_condition(struct Ghost* ghost) {
+    if (!ghost) return false;
+    if (ghost->boredom > ENTITY_BOREDOM_MAX) {
+        ghost->is_running = false;
+        ghost->exit_reason = GHOST_EXIT_BORED;
+        log_ghost_exit(ghost->id, ghost->boredom, ghost->current_room->name);
+        return true;
+    }
+    return false;
+}
+
+void ghost_take_action(struct Ghost* ghost) {
+    if (!ghost || !ghost->current_room) return;
+    int action = rand_int_threadsafe(0, 3);
+    switch (action) {
+        case 0:
+            log_ghost_idle(ghost->id, ghost->boredom, ghost->current_room->name);
+            break;
+        case 1: {
+            if (ghost->evidence_count > 0) {
+                enum EvidenceType chosen_evidence =
+                    ghost->evidence[rand_int_threadsafe(0, ghost->evidence_count)];
+                room_add_evidence(ghost->current_room, ghost->index, chosen_evidence);
+                log_ghost_evidence(ghost->id, ghost->boredom,
+                                   ghost->current_room->name, chosen_evidence);
+            }
+            break;
+        }
+        case 2:
+            if (trace_observe(ghost->current_room->hunter_count == 0)) {
+                struct Room* target_room = room_get_random_connection(ghost->current_room);
+                if (target_room && target_room != ghost->current_room) {
+                    const char* from_room = ghost->current_room->name;
+                    if (room_move_entity(ghost->current_room, target_room, ghost)) {
+                        log_ghost_move(ghost->id, ghost->boredom, from_room, target_room->name);
+                    }
+                }
+            } else {
+                log_ghost_idle(ghost->id, ghost->boredom, ghost->current_room->name);
+            }
+            break;
+    }
+}
+
+// One full turn; is_running is cleared when the ghost gets bored and leaves
+void ghost_take_turn(struct Ghost* ghost) {
+    if (!ghost || !ghost->is_running) return;
+    trace_turn();
+    ghost->turns++;
+    long long turn_began = phase_clock();
+    if (turn_began) timeline_enter(ENTITY_GHOST, ghost->id);
+    ghost_update_stats(ghost);
+    long long began = phase_end(PHASE_GHOST_UPDATE_STATS, turn_began);
+    bool exiting = ghost_check_exit_condition(ghost);
+    began = phase_end(PHASE_GHOST_EXIT_CHECK, began);
+    if (!exiting) {
+        ghost_take_action(ghost);
+        phase_end(PHASE_GHOST_ACTION, began);
+    }
+    phase_end(PHASE_GHOST_TURN, turn_began);
+    telemetry_ghost(ghost);
+}
+
+void ghost_leave_house(struct Ghost* ghost) {
+    if (!ghost) return;
+    if (ghost->is_running) {
+        // Usually every hunter has left, so there is nobody left to haunt
+        ghost->is_running = false;
+        bool hunters_left = __atomic_load_n(&ghost->house->live_hunters, __ATOMIC_ACQUIRE) == 0;
+        ghost->exit_reason = hunters_left ? GHOST_EXIT_HUNTERS_LEFT : GHOST_EXIT_SHUTDOWN;
+        log_ghost_exit(ghost->id, ghost->boredom, ghost->current_room->name);
+    }
+    // Leave the house so a departed ghost can't keep scaring hunters
+    if (ghost->current_room) {
+        room_remove_ghost(ghost->current_room, ghost);
+    }
+    telemetry_ghost(ghost);
+    house_ghost_exited(ghost->house);
+}
+
+void* ghost_thread(void* arg) {
+    struct Ghost* ghost = (struct Ghost*)arg;
+    if (!ghost) return NULL;
+    if (!ghost->house->config.quiet) {
+        printf("Ghost %d thread started\n", ghost->id);
+    }
+    rand_bind_stream(&ghost->rng_state);
+    trace_bind(ghost->entity.trace);
+    timeline_enter(ENTITY_GHOST, ghost->id);
+    // The ghost only reacts to hunters coming and going
+    const unsigned interest = ROOM_EVENT_HUNTER;
+    struct House* house = ghost->house;
+    while (ghost->is_running && !house_is_shutting_down(house)) {
+        struct Room* turn_room = ghost->current_room;
+        unsigned seen = room_event_snapshot(turn_room, interest);
+        house_turn_begin(house);
+        ghost_take_turn(ghost);
+        house_turn_end(house);
+        if (!ghost->is_running) {
+            break;
+        }
+        if (house->config.fast) {
+            continue;
+        }
+        if (ghost->current_room != turn_room) {
+            turn_room = ghost->current_room;
+            seen = room_event_snapshot(turn_room, interest);
+        }
+        if (house->config.wake_mode == WAKE_MODE_EVENT) {
+            room_wait_event(turn_room, interest, seen, GHOST_TURN_NS, &house->shutdown);
+        } else {
+            house_wait_done_ns(house, GHOST_TURN_NS);
+        }
+    }
+    ghost_leave_house(ghost);
+    if (!house->config.quiet) {
+        printf("Ghost %d thread exiting\n", ghost->id);
+    }
+    return NULL;
+}
+
+EvidenceByte ghost_get_evidence_requirements(struct Ghost* ghost) {
+    if (!ghost) return 0;
+    return (EvidenceByte)ghost->type;
+}
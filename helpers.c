@@ -2,6 +2,9 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/time.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include <time.h>
 #include <pthread.h>
 #include <stdint.h>
@@ -41,6 +44,39 @@ void house_populate_rooms(struct House* house) {
     house->starting_room = house->rooms; // Van is at index 0
 }
 
+// Van plus a near-square grid of rooms, for houses far larger than Willow
+void house_populate_generated(struct House* house, int room_count) {
+    if (room_count < 2 || !house_reserve_rooms(house, room_count)) {
+        house->room_count = 0;
+        house->starting_room = NULL;
+        return;
+    }
+    int grid_rooms = room_count - 1;
+    int width = 1;
+    while (width * width < grid_rooms) {
+        width++;
+    }
+    house->room_count = room_count;
+
+    room_init(house->rooms+0, "Van", true);
+    char name[MAX_ROOM_NAME];
+    for (int i = 0; i < grid_rooms; i++) {
+        snprintf(name, sizeof(name), "Room %d-%d", i / width, i % width);
+        room_init(house->rooms+1+i, name, false);
+    }
+    rooms_connect(house->rooms+0, house->rooms+1);    // Van - top left corner
+    for (int i = 0; i < grid_rooms; i++) {
+        if ((i + 1) % width != 0 && i + 1 < grid_rooms) {
+            rooms_connect(house->rooms+1+i, house->rooms+2+i);          // east
+        }
+        if (i + width < grid_rooms) {
+            rooms_connect(house->rooms+1+i, house->rooms+1+i+width);    // south
+        }
+    }
+
+    house->starting_room = house->rooms;
+}
+
 
 // ---- to_string functions ----
 const char* evidence_to_string(enum EvidenceType evidence) {
@@ -132,6 +168,19 @@ const char* exit_reason_to_string(enum LogReason reason) {
     }
 }
 
+const char* ghost_exit_to_string(enum GhostExitReason reason) {
+    switch (reason) {
+        case GHOST_EXIT_BORED:
+            return "boredom";
+        case GHOST_EXIT_HUNTERS_LEFT:
+            return "no hunters left";
+        case GHOST_EXIT_SHUTDOWN:
+            return "run stopped";
+        default:
+            return "still haunting";
+    }
+}
+
 // ---- enum retrieval functions ----
 int get_all_evidence_types(const enum EvidenceType** list) {
     // Stored in the data segment so that we can point to it safely
@@ -187,6 +236,10 @@ int get_all_ghost_types(const enum GhostType** list) {
 }
 
 // ---- Thread-safe random number generation ----
+// Each entity owns a stream and binds it to whichever thread runs its turn, so a
+// seeded run draws the same numbers per entity no matter which thread it is on.
+static _Thread_local unsigned* bound_stream = NULL;
+
 int rand_int_threadsafe(int lower_inclusive, int upper_exclusive) {
     static _Thread_local unsigned seed = 0;
 
@@ -194,30 +247,42 @@ int rand_int_threadsafe(int lower_inclusive, int upper_exclusive) {
         return lower_inclusive;
     }
 
-    if (seed == 0) {
-        seed = (unsigned)time(NULL) ^ (unsigned)(uintptr_t)pthread_self();
+    unsigned* state = bound_stream;
+    if (!state) {
         if (seed == 0) {
-            seed = 0xA5A5A5A5u;
+            seed = (unsigned)time(NULL) ^ (unsigned)(uintptr_t)pthread_self();
+            if (seed == 0) {
+                seed = 0xA5A5A5A5u;
+            }
         }
+        state = &seed;
     }
 
     unsigned span = (unsigned)(upper_exclusive - lower_inclusive);
-    unsigned value = (unsigned)rand_r(&seed) % span;
-    return lower_inclusive + (int)value;
+    unsigned value = (unsigned)rand_r(state) % span;
+    return trace_random(lower_inclusive + (int)value);
 }
 
-// ---- Evidence helpers ----
-bool evidence_is_valid_ghost(EvidenceByte mask) {
-    const enum GhostType* ghost_types = NULL;
-    int ghost_count = get_all_ghost_types(&ghost_types);
+unsigned rand_stream_seed(unsigned base, int stream) {
+    // Mix so neighbouring ids don't start on neighbouring rand_r states
+    unsigned x = base ^ ((unsigned)stream * 0x9E3779B9u);
+    x ^= x >> 16;
+    x *= 0x85EBCA6Bu;
+    x ^= x >> 13;
+    x *= 0xC2B2AE35u;
+    x ^= x >> 16;
+    return x ? x : 0xA5A5A5A5u;
+}
 
-    for (int index = 0; index < ghost_count; index++) {
-        if (mask == (EvidenceByte)ghost_types[index]) {
-            return true;
-        }
-    }
+unsigned* rand_bind_stream(unsigned* state) {
+    unsigned* previous = bound_stream;
+    bound_stream = state;
+    return previous;
+}
 
-    return false;
+// ---- Evidence helpers ----
+bool evidence_is_valid_ghost(EvidenceByte mask) {
+    return evidence_identify_ghost(mask) != 0;
 }
 
 // ---- Logging (Writes CSV logs, DO NOT MODIFY the file outputs: timestamp,type,id,room,device,boredom,fear,action,extra) ----
@@ -250,16 +315,113 @@ static const char* log_entity_type_to_string(enum LogEntityType type) {
     }
 }
 
+static bool log_pacing = true;
+static bool log_console = true;
+static bool log_files = true;
+static char log_prefix[32] = "";
+
+// Every thread counts the events it logs on its own; log_event_count() adds them up, so
+// logging never writes a cache line that other threads share
+struct ThreadEventCount {
+    long events;
+    struct ThreadEventCount* next;
+};
+
+static struct ThreadEventCount* all_event_counts = NULL;
+static pthread_mutex_t all_event_counts_lock = PTHREAD_MUTEX_INITIALIZER;
+static _Thread_local struct ThreadEventCount* local_event_count = NULL;
+
+void log_set_pacing(bool enabled) {
+    log_pacing = enabled;
+}
+
+void log_set_console(bool enabled) {
+    log_console = enabled;
+}
+
+void log_set_files(bool enabled) {
+    log_files = enabled;
+}
+
+long log_event_count() {
+    long total = 0;
+    pthread_mutex_lock(&all_event_counts_lock);
+    for (const struct ThreadEventCount* count = all_event_counts; count; count = count->next) {
+        total += __atomic_load_n(&count->events, __ATOMIC_RELAXED);
+    }
+    pthread_mutex_unlock(&all_event_counts_lock);
+    return total;
+}
+
+static void count_event() {
+    if (!local_event_count) {
+        local_event_count = calloc(1, sizeof(struct ThreadEventCount));
+        if (!local_event_count) return;
+        pthread_mutex_lock(&all_event_counts_lock);
+        local_event_count->next = all_event_counts;
+        all_event_counts = local_event_count;
+        pthread_mutex_unlock(&all_event_counts_lock);
+    }
+    // Only this thread writes its count, so a plain add is enough; the store is atomic
+    // for the readers summing it mid-run
+    __atomic_store_n(&local_event_count->events, local_event_count->events + 1, __ATOMIC_RELAXED);
+}
+
+void log_set_prefix(const char* prefix) {
+    snprintf(log_prefix, sizeof(log_prefix), "%s", prefix ? prefix : "");
+}
+
+static void log_filename(char* buffer, size_t size, int entity_id) {
+    snprintf(buffer, size, "%slog_%d.csv", log_prefix, entity_id);
+}
+
+long long log_get_offset(int entity_id) {
+    if (!log_files) return -1;
+    char filename[64];
+    log_filename(filename, sizeof(filename), entity_id);
+    struct stat info;
+    if (stat(filename, &info) != 0) return 0;
+    return (long long)info.st_size;
+}
+
+bool log_rewind(int entity_id, long long offset) {
+    if (!log_files || offset < 0) return true;
+    char filename[64];
+    log_filename(filename, sizeof(filename), entity_id);
+    int fd = open(filename, O_WRONLY | O_CREAT, 0644);
+    if (fd < 0) return false;
+    bool ok = ftruncate(fd, (off_t)offset) == 0;
+    close(fd);
+    return ok;
+}
+
 static void write_log_record(const struct LogRecord* record) {
     static _Thread_local unsigned line_count = 0;
+    count_event();
+
+    // SWAP formats its extra text on the stack; the checker reads the new device instead
+    bool is_swap = record->action && strcmp(record->action, "SWAP") == 0;
+    checker_submit(record->entity_type == LOG_ENTITY_GHOST, record->entity_id, record->action,
+                   record->room, is_swap ? NULL : record->extra, record->device,
+                   record->boredom, record->fear);
+    timeline_instant(record->entity_type == LOG_ENTITY_GHOST, record->entity_id, record->action,
+                     record->room, record->device, is_swap ? NULL : record->extra);
 
-    if (line_count >= 100000) {
+    if (!log_files) {
+        return;
+    }
+
+    // INIT lines are written once per entity (all hunters' from the main thread), so
+    // only the lines a running entity keeps producing count towards the cap
+    bool is_init = record->action && strcmp(record->action, "INIT") == 0;
+    // A replay only reproduces a run that already ended, but runs every entity on one thread
+    if (!is_init && line_count >= 100000 && trace_get_mode() != TRACE_REPLAY) {
         fprintf(stderr, "Log capped for entity %d; stopping to prevent infinite growth.\n", record->entity_id);
         exit(1);
     }
 
     char filename[64];
-    snprintf(filename, sizeof(filename), "log_%d.csv", record->entity_id);
+    log_filename(filename, sizeof(filename), record->entity_id);
 
     FILE* log_file = fopen(filename, "a");
 
@@ -269,7 +431,7 @@ static void write_log_record(const struct LogRecord* record) {
 
     struct timeval tv;
     gettimeofday(&tv, NULL);
-    long long timestamp = (long long)tv.tv_sec * 1000LL + (long long)tv.tv_usec / 1000LL;
+    long long timestamp = trace_clock((long long)tv.tv_sec * 1000LL + (long long)tv.tv_usec / 1000LL);
 
     const char* entity = log_entity_type_to_string(record->entity_type);
     const char* room = record->room ? record->room : "";
@@ -290,11 +452,15 @@ static void write_log_record(const struct LogRecord* record) {
             extra);
 
     fclose(log_file);
-    line_count++;
+    if (!is_init) {
+        line_count++;
+    }
 
     // Short pause helps ensure successive logs receive distinct timestamps.
-    struct timespec pause = {0, 2 * 1000 * 1000}; // 2 ms
-    nanosleep(&pause, NULL);
+    if (log_pacing) {
+        struct timespec pause = {0, 2 * 1000 * 1000}; // 2 ms
+        nanosleep(&pause, NULL);
+    }
 }
 
 void log_move(int hunter_id, int boredom, int fear, const char* from_room, const char* to_room, enum EvidenceType device) {
@@ -310,6 +476,7 @@ void log_move(int hunter_id, int boredom, int fear, const char* from_room, const
     };
 
     write_log_record(&record);
+    if (!log_console) return;
 
     printf("Hunter %d using %s moved from %s to %s (bored=%d fear=%d)\n",
            hunter_id,
@@ -334,6 +501,7 @@ void log_evidence(int hunter_id, int boredom, int fear, const char* room_name, e
     };
 
     write_log_record(&record);
+    if (!log_console) return;
 
     printf("Hunter %d using %s gathered evidence in %s (bored=%d fear=%d)\n",
            hunter_id,
@@ -361,6 +529,7 @@ void log_swap(int hunter_id, int boredom, int fear, enum EvidenceType from_devic
     };
 
     write_log_record(&record);
+    if (!log_console) return;
 
     printf("Hunter %d swapped devices: %s -> %s (bored=%d fear=%d)\n",
            hunter_id,
@@ -386,6 +555,7 @@ void log_exit(int hunter_id, int boredom, int fear, const char* room_name, enum
     };
 
     write_log_record(&record);
+    if (!log_console) return;
 
     printf("Hunter %d using %s exited at %s (reason=%s, bored=%d fear=%d)\n",
            hunter_id,
@@ -413,6 +583,7 @@ void log_return_to_van(int hunter_id, int boredom, int fear, const char* room_na
     };
 
     write_log_record(&record);
+    if (!log_console) return;
 
     if (heading_home) {
         printf("Hunter %d using %s heading to van from %s (bored=%d fear=%d)\n",
@@ -445,6 +616,7 @@ void log_hunter_init(int hunter_id, const char* room_name, const char* hunter_na
     };
 
     write_log_record(&record);
+    if (!log_console) return;
     printf("Hunter %d (%s) initialized in %s with %s\n",
            hunter_id,
            hunter_name ? hunter_name : "unknown",
@@ -466,6 +638,7 @@ void log_ghost_init(int ghost_id, const char* room_name, enum GhostType type) {
     };
 
     write_log_record(&record);
+    if (!log_console) return;
     printf("Ghost %d (%s) initialized in %s\n",
            ghost_id,
            type_text,
@@ -485,6 +658,7 @@ void log_ghost_move(int ghost_id, int boredom, const char* from_room, const char
     };
 
     write_log_record(&record);
+    if (!log_console) return;
 
     printf("Ghost %d [bored=%d] MOVE %s -> %s\n",
            ghost_id,
@@ -508,6 +682,7 @@ void log_ghost_evidence(int ghost_id, int boredom, const char* room_name, enum E
     };
 
     write_log_record(&record);
+    if (!log_console) return;
 
     printf("Ghost %d [bored=%d] EVIDENCE %s in %s\n",
            ghost_id,
@@ -529,6 +704,7 @@ void log_ghost_exit(int ghost_id, int boredom, const char* room_name) {
     };
 
     write_log_record(&record);
+    if (!log_console) return;
 
     printf("Ghost %d [bored=%d] EXIT %s\n",
            ghost_id,
@@ -549,6 +725,7 @@ void log_ghost_idle(int ghost_id, int boredom, const char* room_name) {
     };
 
     write_log_record(&record);
+    if (!log_console) return;
 
     printf("Ghost %d [bored=%d] IDLE in %s\n",
            ghost_id,
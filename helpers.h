@@ -23,6 +23,7 @@ const char* ghost_to_string(enum GhostType ghost);
  * @return Static string like "bored".
  */
 const char* exit_reason_to_string(enum LogReason reason);
+const char* ghost_exit_to_string(enum GhostExitReason reason);
 
 /**
  * @brief Expose every evidence device.
@@ -46,6 +47,21 @@ int get_all_ghost_types(const enum GhostType** list);
  */
 int rand_int_threadsafe(int lower_inclusive, int upper_exclusive);
 
+/**
+ * @brief Derive the starting state of one random stream from a base seed.
+ * @param[in] base Run-wide seed.
+ * @param[in] stream Stream identifier, usually an entity id.
+ * @return Non-zero seed for the stream.
+ */
+unsigned rand_stream_seed(unsigned base, int stream);
+
+/**
+ * @brief Make rand_int_threadsafe() draw from the given state on this thread.
+ * @param[in] state Stream state owned by the caller, or NULL for the thread default.
+ * @return The previously bound state so callers can restore it.
+ */
+unsigned* rand_bind_stream(unsigned* state);
+
 /**
  * @brief Verify whether an evidence mask matches a supported ghost type.
  * @param[in] mask Combined evidence mask.
@@ -59,6 +75,59 @@ bool evidence_is_valid_ghost(EvidenceByte mask);
  */
 void house_populate_rooms(struct House* house);
 
+/**
+ * @brief Populate the house with the van and a generated grid of rooms.
+ * @param[in,out] house House to populate; starting_room is set to the van.
+ * @param[in] room_count Total rooms including the van, at least 2.
+ * @note room_count is left at 0 when the rooms can't be allocated.
+ */
+void house_populate_generated(struct House* house, int room_count);
+
+/**
+ * @brief Enable or disable the short pause after every log write.
+ * @param[in] enabled false when running without sleeps.
+ */
+void log_set_pacing(bool enabled);
+
+/**
+ * @brief Enable or disable the console line printed for every logged event.
+ * @param[in] enabled false for quiet runs.
+ */
+void log_set_console(bool enabled);
+
+/**
+ * @brief Enable or disable writing log_<id>.csv files.
+ * @param[in] enabled false to skip all file output.
+ */
+void log_set_files(bool enabled);
+
+/**
+ * @brief Put a prefix in front of every log file name, as in <prefix>log_<id>.csv.
+ * @param[in] prefix Prefix of at most 31 characters, or NULL for none.
+ */
+void log_set_prefix(const char* prefix);
+
+/**
+ * @brief Number of events logged so far, whether or not they went to a file.
+ * @return Events since the program started.
+ */
+long log_event_count();
+
+/**
+ * @brief Current size of an entity's log file, for checkpoints.
+ * @param[in] entity_id Hunter or ghost id.
+ * @return Size in bytes, 0 when the file doesn't exist yet, -1 when file logging is off.
+ */
+long long log_get_offset(int entity_id);
+
+/**
+ * @brief Cut an entity's log file back to a checkpointed size.
+ * @param[in] entity_id Hunter or ghost id.
+ * @param[in] offset Size returned by log_get_offset(); negative leaves the file alone.
+ * @return false when the file couldn't be truncated.
+ */
+bool log_rewind(int entity_id, long long offset);
+
 /**
  * @brief Append a MOVE entry for a hunter.
  * @param[in] id Hunter identifier.
@@ -1,69 +1,331 @@
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-#include "defs.h"
-#include "helpers.h"
-
-struct House* house_init() {
-    struct House* house = calloc(1, sizeof(struct House));
-    if (!house) return NULL;
-
-    // Initialize case file
-    casefile_init(&house->case_file);
-
-    // Initialize hunter collection, a collection of hunter structs
-    house->hunter_capacity = 4;
-    house->hunters = malloc(sizeof(struct Hunter*) * house->hunter_capacity);
-    if (!house->hunters) {
-        free(house);
-        return NULL;
-    }
-    house->hunter_count = 0;
-    house->room_count = 0;
-    house->ghost = NULL;
-    house->starting_room = NULL;
-
-    return house;
-}
-
-void house_cleanup(struct House* house) {
-    if (!house) return;
-
-    // Cleanup ghost
-    if (house->ghost) {
-        ghost_cleanup(house->ghost);
-    }
-
-    // Cleanup hunters
-    for (int i = 0; i < house->hunter_count; i++) {
-        if (house->hunters[i]) {
-            hunter_cleanup(house->hunters[i]);
-        }
-    }
-    free(house->hunters);
-
-    // Cleanup case file
-    casefile_cleanup(&house->case_file);
-
-    // Cleanup rooms, at the index of the room until max count
-    for (int i = 0; i < house->room_count; i++) {
-        room_cleanup(&house->rooms[i]);
-    }
-
-    free(house);
-}
-
-void hunter_collection_append(struct House* house, struct Hunter* hunter) {
-    if (!house || !hunter) return;
-    // Grow array if needed, honestly pretty cool since it just doubles the capacity. Bad if it grows to the size of the ssd
-    if (house->hunter_count >= house->hunter_capacity) {
-        int new_capacity = house->hunter_capacity * 2;
-        struct Hunter** new_hunters = realloc(house->hunters, 
-                                            sizeof(struct Hunter*) * new_capacity);
-        if (!new_hunters) return;
-        house->hunters = new_hunters;
-        house->hunter_capacity = new_capacity;
-    }
-    house->hunters[house->hunter_count++] = hunter;
-
-}
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "defs.h"
+#include "helpers.h"
+
+void simconfig_init(struct SimConfig* config) {
+    if (!config) return;
+    config->device_policy = DEVICE_POLICY_RANDOM;
+    config->explore_policy = EXPLORE_POLICY_RANDOM;
+    config->wake_mode = WAKE_MODE_TICK;
+    config->fast = false;
+    config->seeded = false;
+    config->seed = 0;
+    config->room_capacity = MAX_ROOM_OCCUPANCY;
+    config->stack_size = 64 * 1024;
+    config->quiet = false;
+    config->log_files = true;
+    config->check = false;
+    config->contention = false;
+    config->phase_times = false;
+    config->perf_counters = false;
+    config->evidence_latency = false;
+    config->ghost_count = 1;
+    config->exec_mode = EXEC_MODE_THREADS;
+    config->worker_count = 0;
+    config->layout_rooms = 0;
+}
+
+struct House* house_init() {
+    struct House* house = calloc(1, sizeof(struct House));
+    if (!house) return NULL;
+
+    // Initialize hunter collection, a collection of hunter structs
+    house->hunter_capacity = 4;
+    house->hunters = malloc(sizeof(struct Hunter*) * house->hunter_capacity);
+    if (!house->hunters) {
+        free(house);
+        return NULL;
+    }
+    house->hunter_count = 0;
+    house->max_rooms = MAX_ROOMS;
+    house->rooms = calloc(house->max_rooms, sizeof(struct Room));
+    if (!house->rooms) {
+        free(house->hunters);
+        free(house);
+        return NULL;
+    }
+    house->room_count = 0;
+    house->ghosts = NULL;
+    house->ghost_count = 0;
+    house->starting_room = NULL;
+    simconfig_init(&house->config);
+    house->live_hunters = 0;
+    house->live_ghosts = 0;
+    house->shutdown = false;
+    house->workers = NULL;
+    house->worker_count = 0;
+    house->pausable = false;
+    house->pause_turns = false;
+    house->active_turns = 0;
+    // Tick sleeps time out on done, so it runs on the monotonic clock like the room waits
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_mutex_init(&house->done_lock, NULL);
+    pthread_cond_init(&house->done, &attr);
+    pthread_condattr_destroy(&attr);
+    pthread_cond_init(&house->turns_quiet, NULL);
+    pthread_cond_init(&house->turns_resumed, NULL);
+
+    return house;
+}
+
+void house_cleanup(struct House* house) {
+    if (!house) return;
+
+    // Cleanup ghosts, each one takes its case file with it
+    for (int i = 0; i < house->ghost_count; i++) {
+        ghost_cleanup(house->ghosts[i]);
+    }
+    free(house->ghosts);
+
+    // Cleanup hunters
+    for (int i = 0; i < house->hunter_count; i++) {
+        if (house->hunters[i]) {
+            hunter_cleanup(house->hunters[i]);
+        }
+    }
+    free(house->hunters);
+    actors_cleanup(house);
+
+    // Cleanup rooms, at the index of the room until max count
+    for (int i = 0; i < house->room_count; i++) {
+        room_cleanup(&house->rooms[i]);
+    }
+    free(house->rooms);
+
+    pthread_cond_destroy(&house->turns_resumed);
+    pthread_cond_destroy(&house->turns_quiet);
+    pthread_cond_destroy(&house->done);
+    pthread_mutex_destroy(&house->done_lock);
+    free(house);
+}
+
+// Rooms are referenced by address everywhere, so the storage can only be resized
+// before the layout is built
+bool house_reserve_rooms(struct House* house, int count) {
+    if (!house || count < 1 || house->room_count > 0) return false;
+    if (count <= house->max_rooms) return true;
+    struct Room* rooms = calloc(count, sizeof(struct Room));
+    if (!rooms) return false;
+    free(house->rooms);
+    house->rooms = rooms;
+    house->max_rooms = count;
+    return true;
+}
+
+// Room sizes depend on the configuration, so they are set after the layout is built
+bool house_apply_config(struct House* house) {
+    if (!house) return false;
+    for (int i = 0; i < house->room_count; i++) {
+        if (!room_set_capacity(&house->rooms[i], house->config.room_capacity) ||
+            !room_set_evidence_slots(&house->rooms[i], house->config.ghost_count)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool house_add_ghosts(struct House* house, int count) {
+    if (!house || count < 1) return false;
+    house->ghosts = calloc(count, sizeof(struct Ghost*));
+    if (!house->ghosts) return false;
+    for (int i = 0; i < count; i++) {
+        house->ghosts[i] = ghost_init(house, i);
+        if (!house->ghosts[i]) return false;
+        house->ghost_count++;
+    }
+    return true;
+}
+
+bool house_all_cases_solved(struct House* house) {
+    if (!house || house->ghost_count == 0) return false;
+    for (int i = 0; i < house->ghost_count; i++) {
+        if (!casefile_is_solved(&house->ghosts[i]->case_file)) return false;
+    }
+    return true;
+}
+
+bool hunter_collection_append(struct House* house, struct Hunter* hunter) {
+    if (!house || !hunter) return false;
+    // Grow array if needed, honestly pretty cool since it just doubles the capacity. Bad if it grows to the size of the ssd
+    if (house->hunter_count >= house->hunter_capacity) {
+        int new_capacity = house->hunter_capacity * 2;
+        struct Hunter** new_hunters = realloc(house->hunters, 
+                                            sizeof(struct Hunter*) * new_capacity);
+        if (!new_hunters) return false;
+        house->hunters = new_hunters;
+        house->hunter_capacity = new_capacity;
+    }
+    hunter->index = house->hunter_count;
+    house->hunters[house->hunter_count++] = hunter;
+    return true;
+}
+
+// Only the first caller does the work; everyone blocked in a room wait or in
+// house_wait_done() is woken so they notice straight away
+void house_request_shutdown(struct House* house) {
+    if (!house) return;
+    pthread_mutex_lock(&house->done_lock);
+    if (house->shutdown) {
+        pthread_mutex_unlock(&house->done_lock);
+        return;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &house->shutdown_at);
+    __atomic_store_n(&house->shutdown, true, __ATOMIC_RELEASE);
+    pthread_cond_broadcast(&house->done);
+    pthread_cond_broadcast(&house->turns_quiet);
+    pthread_cond_broadcast(&house->turns_resumed);
+    pthread_mutex_unlock(&house->done_lock);
+
+    for (int i = 0; i < house->room_count; i++) {
+        room_interrupt_waiters(&house->rooms[i]);
+    }
+}
+
+bool house_is_shutting_down(struct House* house) {
+    return house && __atomic_load_n(&house->shutdown, __ATOMIC_ACQUIRE);
+}
+
+void house_hunter_started(struct House* house) {
+    if (!house) return;
+    __atomic_add_fetch(&house->live_hunters, 1, __ATOMIC_ACQ_REL);
+}
+
+void house_hunter_exited(struct House* house) {
+    if (!house) return;
+    if (__atomic_sub_fetch(&house->live_hunters, 1, __ATOMIC_ACQ_REL) == 0) {
+        house_request_shutdown(house);
+    }
+}
+
+void house_ghost_started(struct House* house) {
+    if (!house) return;
+    __atomic_add_fetch(&house->live_ghosts, 1, __ATOMIC_ACQ_REL);
+}
+
+void house_ghost_exited(struct House* house) {
+    if (!house) return;
+    if (__atomic_sub_fetch(&house->live_ghosts, 1, __ATOMIC_ACQ_REL) == 0) {
+        house_request_shutdown(house);
+    }
+}
+
+void house_wait_done(struct House* house) {
+    if (!house) return;
+    pthread_mutex_lock(&house->done_lock);
+    while (!house->shutdown) {
+        pthread_cond_wait(&house->done, &house->done_lock);
+    }
+    pthread_mutex_unlock(&house->done_lock);
+}
+
+// Returns false when the timeout ran out before the run ended
+bool house_wait_done_for(struct House* house, long timeout_ms) {
+    return house_wait_done_ns(house, timeout_ms * 1000000LL);
+}
+
+// Tick-mode entities sleep here rather than on their room, so room changes never wake
+// them for nothing; only the shutdown broadcast cuts the sleep short
+bool house_wait_done_ns(struct House* house, long long timeout_ns) {
+    if (!house) return true;
+    if (__atomic_load_n(&house->shutdown, __ATOMIC_ACQUIRE)) return true;
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += timeout_ns / 1000000000LL;
+    deadline.tv_nsec += timeout_ns % 1000000000LL;
+    if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+    pthread_mutex_lock(&house->done_lock);
+    while (!house->shutdown) {
+        if (pthread_cond_timedwait(&house->done, &house->done_lock, &deadline) != 0) break;
+    }
+    bool done = house->shutdown;
+    pthread_mutex_unlock(&house->done_lock);
+    return done;
+}
+
+// Turns are bracketed by begin/end so a checkpoint can wait for every turn in flight
+// to finish. Both sides publish their flag before reading the other's, so either the
+// turn sees the pause or the checkpoint sees the turn.
+void house_turn_begin(struct House* house) {
+    if (!house || !house->pausable) return;
+    while (true) {
+        __atomic_add_fetch(&house->active_turns, 1, __ATOMIC_SEQ_CST);
+        if (!__atomic_load_n(&house->pause_turns, __ATOMIC_SEQ_CST)) return;
+        house_turn_end(house);
+        pthread_mutex_lock(&house->done_lock);
+        while (house->pause_turns && !house->shutdown) {
+            pthread_cond_wait(&house->turns_resumed, &house->done_lock);
+        }
+        pthread_mutex_unlock(&house->done_lock);
+        if (house_is_shutting_down(house)) {
+            // Let the entity run into its loop condition instead of parking again
+            __atomic_add_fetch(&house->active_turns, 1, __ATOMIC_SEQ_CST);
+            return;
+        }
+    }
+}
+
+void house_turn_end(struct House* house) {
+    if (!house || !house->pausable) return;
+    if (__atomic_sub_fetch(&house->active_turns, 1, __ATOMIC_SEQ_CST) == 0 &&
+        __atomic_load_n(&house->pause_turns, __ATOMIC_SEQ_CST)) {
+        pthread_mutex_lock(&house->done_lock);
+        pthread_cond_broadcast(&house->turns_quiet);
+        pthread_mutex_unlock(&house->done_lock);
+    }
+}
+
+// Returns once no turn is running, or false if the run ended first
+bool house_pause_turns(struct House* house) {
+    if (!house) return false;
+    if (!house->pausable) {
+        fprintf(stderr, "This run was started without pausing allowed, so its turns can't be paused\n");
+        return false;
+    }
+    pthread_mutex_lock(&house->done_lock);
+    __atomic_store_n(&house->pause_turns, true, __ATOMIC_SEQ_CST);
+    while (__atomic_load_n(&house->active_turns, __ATOMIC_SEQ_CST) > 0 && !house->shutdown) {
+        pthread_cond_wait(&house->turns_quiet, &house->done_lock);
+    }
+    bool paused = !house->shutdown;
+    pthread_mutex_unlock(&house->done_lock);
+    if (!paused) {
+        house_resume_turns(house);
+    }
+    return paused;
+}
+
+void house_resume_turns(struct House* house) {
+    if (!house) return;
+    pthread_mutex_lock(&house->done_lock);
+    __atomic_store_n(&house->pause_turns, false, __ATOMIC_SEQ_CST);
+    pthread_cond_broadcast(&house->turns_resumed);
+    pthread_mutex_unlock(&house->done_lock);
+}
+
+// Makes the copy of a paused house in a fork() child usable from its one thread: the
+// entity threads and workers the parent had are gone, and so is whoever waited on
+// the house or its rooms, so every wait primitive starts over
+void house_reset_after_fork(struct House* house) {
+    if (!house) return;
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_mutex_init(&house->done_lock, NULL);
+    pthread_cond_init(&house->done, &attr);
+    pthread_condattr_destroy(&attr);
+    pthread_cond_init(&house->turns_quiet, NULL);
+    pthread_cond_init(&house->turns_resumed, NULL);
+    house->pause_turns = false;
+    house->active_turns = 0;
+    actors_release_rooms(house);
+    for (int i = 0; i < house->room_count; i++) {
+        room_reset_after_fork(&house->rooms[i]);
+    }
+}
@@ -1,216 +1,357 @@
-#define _POSIX_C_SOURCE 200112L
-
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-#include <unistd.h>
-#include <pthread.h>
-#include <time.h>
-#include "defs.h"
-#include "helpers.h"
-
-void roomstack_init(struct RoomStack* stack) {
-    if (!stack) return;
-    stack->head = NULL;
-}
-
-void roomstack_push(struct RoomStack* stack, struct Room* room) {
-    if (!stack || !room) return;
-    struct RoomNode* new_node = malloc(sizeof(struct RoomNode));
-    if (!new_node) return;
-    new_node->room = room;
-    new_node->next = stack->head;
-    stack->head = new_node;
-}
-
-struct Room* roomstack_pop(struct RoomStack* stack) {
-    if (!stack || !stack->head) return NULL;
-    struct RoomNode* node = stack->head;
-    struct Room* room = node->room;
-    stack->head = node->next;
-    free(node);
-    return room;
-}
-
-void roomstack_clear(struct RoomStack* stack) {
-    if (!stack) return;
-    while (stack->head) {
-        roomstack_pop(stack);
-    }
-}
-
-bool roomstack_is_empty(struct RoomStack* stack) {
-    return !stack || !stack->head;
-}
-
-struct Hunter* hunter_init(const char* name, int id, struct House* house) {
-    if (!house || !house->starting_room) return NULL;
-    struct Hunter* hunter = malloc(sizeof(struct Hunter));
-    if (!hunter) return NULL;
-
-    strncpy(hunter->name, name, MAX_HUNTER_NAME - 1);
-    hunter->name[MAX_HUNTER_NAME - 1] = '\0';
-    hunter->id = id;
-    hunter->current_room = NULL; // so room_add_hunter sets this
-    hunter->house = house;
-    hunter->case_file = &house->case_file;
-    hunter->boredom = 0;
-    hunter->fear = 0;
-    hunter->is_running = true;
-    hunter->exit_reason = LR_BORED;
-    hunter->return_to_van = false;
-
-    roomstack_init(&hunter->path);
-
-    const enum EvidenceType* evidence_types = NULL;
-    int evidence_count = get_all_evidence_types(&evidence_types);
-    if (evidence_count > 0) {
-        hunter->device = evidence_types[rand_int_threadsafe(0, evidence_count)];
-    } else {
-        hunter->device = EV_EMF;
-    }
-
-    if (!room_add_hunter(house->starting_room, hunter)) {
-        free(hunter);
-        return NULL;
-    }
-    return hunter;
-}
-
-void hunter_cleanup(struct Hunter* hunter) {
-    if (!hunter) return;
-    roomstack_clear(&hunter->path);
-    free(hunter);
-}
-
-void hunter_update_stats(struct Hunter* hunter) {
-    if (!hunter || !hunter->current_room) return;
-    if (hunter->current_room->ghost) {
-        hunter->boredom = 0;
-        hunter->fear++;
-    } else {
-        hunter->boredom++;
-        hunter->fear = 0;
-    }
-}
-
-bool hunter_check_exit_conditions(struct Hunter* hunter) {
-    if (!hunter) return false;
-    if (hunter->boredom > ENTITY_BOREDOM_MAX) {
-        hunter->exit_reason = LR_BORED;
-        hunter->is_running = false;
-        log_exit(hunter->id, hunter->boredom, hunter->fear,
-                 hunter->current_room->name, hunter->device, LR_BORED);
-        return true;
-    }
-    if (hunter->fear > HUNTER_FEAR_MAX) {
-        hunter->exit_reason = LR_AFRAID;
-        hunter->is_running = false;
-        log_exit(hunter->id, hunter->boredom, hunter->fear,
-                 hunter->current_room->name, hunter->device, LR_AFRAID);
-        return true;
-    }
-    return false;
-}
-
-void hunter_van_check(struct Hunter* hunter) {
-    if (!hunter || !hunter->house) return;
-    if (hunter->current_room == hunter->house->starting_room) {
-        roomstack_clear(&hunter->path);
-        hunter->return_to_van = false;
-        log_return_to_van(hunter->id, hunter->boredom, hunter->fear,
-                          hunter->current_room->name, hunter->device, false);
-        if (casefile_is_solved(hunter->case_file)) {
-            hunter->exit_reason = LR_EVIDENCE;
-            hunter->is_running = false;
-            log_exit(hunter->id, hunter->boredom, hunter->fear,
-                     hunter->current_room->name, hunter->device, LR_EVIDENCE);
-            return;
-        }
-        enum EvidenceType old_device = hunter->device;
-        const enum EvidenceType* evidence_types = NULL;
-        int evidence_count = get_all_evidence_types(&evidence_types);
-        if (evidence_count > 0) {
-            enum EvidenceType new_device;
-            do {
-                new_device = evidence_types[rand_int_threadsafe(0, evidence_count)];
-            } while (new_device == old_device && evidence_count > 1);
-            hunter->device = new_device;
-            log_swap(hunter->id, hunter->boredom, hunter->fear, old_device, new_device);
-        }
-    }
-}
-
-void hunter_gather_evidence(struct Hunter* hunter) {
-    if (!hunter || !hunter->current_room) return;
-    if (room_has_evidence(hunter->current_room, hunter->device)) {
-        if (room_remove_evidence(hunter->current_room, hunter->device)) {
-            casefile_add_evidence(hunter->case_file, hunter->device);
-            log_evidence(hunter->id, hunter->boredom, hunter->fear,
-                         hunter->current_room->name, hunter->device);
-            if (!hunter->current_room->is_exit) {
-                hunter->return_to_van = true;
-                log_return_to_van(hunter->id, hunter->boredom, hunter->fear,
-                                 hunter->current_room->name, hunter->device, true);
-            }
-        }
-    } else {
-        if (rand_int_threadsafe(0, 100) < 10) {
-            hunter->return_to_van = true;
-            log_return_to_van(hunter->id, hunter->boredom, hunter->fear,
-                             hunter->current_room->name, hunter->device, true);
-        }
-    }
-}
-
-void hunter_move(struct Hunter* hunter) {
-    if (!hunter || !hunter->current_room) return;
-    struct Room* target_room = NULL;
-    struct Room* prev_room = hunter->current_room;
-    if (hunter->return_to_van) {
-        target_room = roomstack_pop(&hunter->path);
-        if (!target_room) {
-            hunter->return_to_van = false;
-            return;
-        }
-    } else {
-        target_room = room_get_random_connection(hunter->current_room);
-        if (!target_room) return;
-    }
-    if (room_move_entity(hunter->current_room, target_room, hunter)) {
-        log_move(hunter->id, hunter->boredom, hunter->fear,
-                 prev_room->name, target_room->name, hunter->device);
-
-        if (!hunter->return_to_van) {
-            roomstack_push(&hunter->path, prev_room);
-        }
-    }
-}
-
-void* hunter_thread(void* arg) {
-    struct Hunter* hunter = (struct Hunter*)arg;
-    if (!hunter) return NULL;
-
-    printf("Hunter %d thread started\n", hunter->id);
-
-    while (hunter->is_running) {
-        hunter_update_stats(hunter);
-        if (hunter_check_exit_conditions(hunter)) {
-            break;
-        }
-        hunter_van_check(hunter);
-        if (!hunter->is_running) {
-            break;
-        }
-        hunter_gather_evidence(hunter);
-        hunter_move(hunter);
-        struct timespec ts = { .tv_sec = 0, .tv_nsec = 100000000L };
-        nanosleep(&ts, NULL);
-    }
-
-    if (hunter->current_room) {
-        room_remove_hunter(hunter->current_room, hunter);
-    }
-    printf("Hunter %d thread exiting\n", hunter->id);
-    return NULL;
-}
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+#include "defs.h"
+#include "helpers.h"
+
+void roomstack_init(struct RoomStack* stack) {
+    if (!stack) return;
+    stack->head = NULL;
+}
+
+void roomstack_push(struct RoomStack* stack, struct Room* room) {
+    if (!stack || !room) return;
+    struct RoomNode* new_node = malloc(sizeof(struct RoomNode));
+    if (!new_node) return;
+    new_node->room = room;
+    new_node->next = stack->head;
+    stack->head = new_node;
+}
+
+struct Room* roomstack_pop(struct RoomStack* stack) {
+    if (!stack || !stack->head) return NULL;
+    struct RoomNode* node = stack->head;
+    struct Room* room = node->room;
+    stack->head = node->next;
+    free(node);
+    return room;
+}
+
+void roomstack_clear(struct RoomStack* stack) {
+    if (!stack) return;
+    while (stack->head) {
+        roomstack_pop(stack);
+    }
+}
+
+bool roomstack_is_empty(struct RoomStack* stack) {
+    return !stack || !stack->head;
+}
+
+struct Hunter* hunter_init(const char* name, int id, struct House* house) {
+    if (!house || !house->starting_room) return NULL;
+    struct Hunter* hunter = malloc(sizeof(struct Hunter));
+    if (!hunter) return NULL;
+
+    strncpy(hunter->name, name, MAX_HUNTER_NAME - 1);
+    hunter->name[MAX_HUNTER_NAME - 1] = '\0';
+    hunter->entity.kind = ENTITY_HUNTER;
+    hunter->entity.next_message = NULL;
+    hunter->entity.next_turn_ns = 0;
+    hunter->entity.trace = NULL;
+    hunter->id = id;
+    hunter->index = -1;
+    hunter->current_room = NULL; // so room_add_hunter sets this
+    hunter->room_slot = -1;
+    hunter->house = house;
+    hunter->rng_state = rand_stream_seed(house->config.seed, id);
+    hunter->turns = 0;
+    hunter->boredom = 0;
+    hunter->fear = 0;
+    hunter->is_running = true;
+    hunter->exit_reason = LR_BORED;
+    hunter->return_to_van = false;
+
+    roomstack_init(&hunter->path);
+
+    unsigned* previous_stream = rand_bind_stream(&hunter->rng_state);
+    const enum EvidenceType* evidence_types = NULL;
+    int evidence_count = get_all_evidence_types(&evidence_types);
+    if (evidence_count > 0) {
+        hunter->device = evidence_types[rand_int_threadsafe(0, evidence_count)];
+    } else {
+        hunter->device = EV_EMF;
+    }
+    rand_bind_stream(previous_stream);
+
+    if (!room_add_hunter(house->starting_room, hunter)) {
+        free(hunter);
+        return NULL;
+    }
+    __atomic_add_fetch(&house->device_holders[evidence_to_index(hunter->device)], 1, __ATOMIC_RELAXED);
+    return hunter;
+}
+
+void hunter_cleanup(struct Hunter* hunter) {
+    if (!hunter) return;
+    roomstack_clear(&hunter->path);
+    free(hunter);
+}
+
+void hunter_update_stats(struct Hunter* hunter) {
+    if (!hunter || !hunter->current_room) return;
+    if (trace_observe(hunter->current_room->ghost_count > 0)) {
+        hunter->boredom = 0;
+        hunter->fear++;
+    } else {
+        hunter->boredom++;
+        hunter->fear = 0;
+    }
+}
+
+bool hunter_check_exit_conditions(struct Hunter* hunter) {
+    if (!hunter) return false;
+    if (hunter->boredom > ENTITY_BOREDOM_MAX) {
+        hunter->exit_reason = LR_BORED;
+        hunter->is_running = false;
+        log_exit(hunter->id, hunter->boredom, hunter->fear,
+                 hunter->current_room->name, hunter->device, LR_BORED);
+        return true;
+    }
+    if (hunter->fear > HUNTER_FEAR_MAX) {
+        hunter->exit_reason = LR_AFRAID;
+        hunter->is_running = false;
+        log_exit(hunter->id, hunter->boredom, hunter->fear,
+                 hunter->current_room->name, hunter->device, LR_AFRAID);
+        return true;
+    }
+    return false;
+}
+
+void hunter_van_check(struct Hunter* hunter) {
+    if (!hunter || !hunter->house) return;
+    if (hunter->current_room == hunter->house->starting_room) {
+        roomstack_clear(&hunter->path);
+        hunter->return_to_van = false;
+        log_return_to_van(hunter->id, hunter->boredom, hunter->fear,
+                          hunter->current_room->name, hunter->device, false);
+        if (trace_observe(house_all_cases_solved(hunter->house))) {
+            hunter->exit_reason = LR_EVIDENCE;
+            hunter->is_running = false;
+            log_exit(hunter->id, hunter->boredom, hunter->fear,
+                     hunter->current_room->name, hunter->device, LR_EVIDENCE);
+            return;
+        }
+        enum EvidenceType old_device = hunter->device;
+        enum EvidenceType new_device = hunter_choose_device(hunter);
+        if (new_device != 0 && new_device != old_device) {
+            int* holders = hunter->house->device_holders;
+            __atomic_sub_fetch(&holders[evidence_to_index(old_device)], 1, __ATOMIC_RELAXED);
+            __atomic_add_fetch(&holders[evidence_to_index(new_device)], 1, __ATOMIC_RELAXED);
+            hunter->device = new_device;
+            log_swap(hunter->id, hunter->boredom, hunter->fear, old_device, new_device);
+        }
+    }
+}
+
+// Random policy: any device but the current one.
+// Informed policy: for every unsolved ghost, the devices that would still split its
+// remaining candidates are considered, or once nothing splits them, the missing devices
+// that confirm them. Each is weighted by how many of those candidates share it, summed
+// over the ghosts. Devices other hunters carry, and the one this hunter just came back
+// empty-handed with, are only used when nothing else is left.
+enum EvidenceType hunter_choose_device(struct Hunter* hunter) {
+    if (!hunter || !hunter->house) return 0;
+    enum EvidenceType old_device = hunter->device;
+    const enum EvidenceType* evidence_types = NULL;
+    int evidence_count = get_all_evidence_types(&evidence_types);
+    if (evidence_count == 0) return 0;
+
+    struct House* house = hunter->house;
+    if (house->config.device_policy == DEVICE_POLICY_INFORMED) {
+        const int* holders = house->device_holders;
+        int weights[EVIDENCE_TYPE_COUNT] = {0};
+        int tier_total[3] = {0};
+        int tiers[EVIDENCE_TYPE_COUNT];
+        for (int g = 0; g < house->ghost_count; g++) {
+            struct CaseFile* case_file = &house->ghosts[g]->case_file;
+            if (trace_observe(casefile_is_solved(case_file))) continue;
+            EvidenceByte collected = (EvidenceByte)trace_observe(casefile_get_evidence(case_file));
+            GhostSet candidates = (GhostSet)trace_observe((int)casefile_get_candidates(case_file));
+            EvidenceByte splitting = evidence_discriminating_devices(collected);
+            for (int i = 0; i < evidence_count; i++) {
+                enum EvidenceType device = evidence_types[i];
+                if (evidence_contains(collected, device)) continue;
+                if (splitting != 0 && !evidence_contains(splitting, device)) continue;
+                weights[i] += __builtin_popcount(candidates & evidence_candidates(device));
+            }
+        }
+        for (int i = 0; i < evidence_count; i++) {
+            enum EvidenceType device = evidence_types[i];
+            if (weights[i] == 0) continue;
+            int others = trace_observe(__atomic_load_n(&holders[i], __ATOMIC_RELAXED)) - (device == old_device);
+            // Tier 0 is uncovered, 1 is carried by someone else, 2 is our own last device
+            tiers[i] = (device == old_device) ? 2 : (others > 0 ? 1 : 0);
+            tier_total[tiers[i]] += weights[i];
+        }
+        for (int tier = 0; tier < 3; tier++) {
+            if (tier_total[tier] == 0) continue;
+            int pick = rand_int_threadsafe(0, tier_total[tier]);
+            for (int i = 0; i < evidence_count; i++) {
+                if (weights[i] == 0 || tiers[i] != tier) continue;
+                if (pick < weights[i]) return evidence_types[i];
+                pick -= weights[i];
+            }
+        }
+    }
+
+    enum EvidenceType new_device;
+    do {
+        new_device = evidence_types[rand_int_threadsafe(0, evidence_count)];
+    } while (new_device == old_device && evidence_count > 1);
+    return new_device;
+}
+
+// A single reading picks up this device's evidence for every ghost that left it here
+void hunter_gather_evidence(struct Hunter* hunter) {
+    if (!hunter || !hunter->current_room) return;
+    struct Room* room = hunter->current_room;
+    struct House* house = hunter->house;
+    EvidenceByte present = (EvidenceByte)trace_observe(room_get_evidence(room));
+    room_record_sighting(room, evidence_remove(present, hunter->device));
+    bool collected = false;
+    if (evidence_contains(present, hunter->device)) {
+        for (int g = 0; g < house->ghost_count; g++) {
+            if (!trace_observe(room_remove_evidence(room, g, hunter->device))) continue;
+            collected = true;
+            casefile_add_evidence(&house->ghosts[g]->case_file, hunter->device, hunter->turns);
+            log_evidence(hunter->id, hunter->boredom, hunter->fear,
+                         room->name, hunter->device);
+        }
+    }
+    if (collected) {
+        room_clear_sighting(room, hunter->device);
+        if (!room->is_exit) {
+            hunter->return_to_van = true;
+            log_return_to_van(hunter->id, hunter->boredom, hunter->fear,
+                             room->name, hunter->device, true);
+        }
+    } else if (!evidence_contains(present, hunter->device)) {
+        if (rand_int_threadsafe(0, 100) < 10) {
+            hunter->return_to_van = true;
+            log_return_to_van(hunter->id, hunter->boredom, hunter->fear,
+                             room->name, hunter->device, true);
+        }
+    }
+}
+
+void hunter_move(struct Hunter* hunter) {
+    if (!hunter || !hunter->current_room) return;
+    struct Room* target_room = NULL;
+    struct Room* prev_room = hunter->current_room;
+    struct House* house = hunter->house;
+    if (hunter->return_to_van) {
+        target_room = roomstack_pop(&hunter->path);
+        if (!target_room) {
+            hunter->return_to_van = false;
+            return;
+        }
+    } else if (house->config.explore_policy == EXPLORE_POLICY_FRONTIER) {
+        unsigned clock = __atomic_load_n(&house->move_clock, __ATOMIC_RELAXED);
+        target_room = room_get_frontier_connection(hunter->current_room, clock, hunter->device);
+        if (!target_room) return;
+    } else {
+        target_room = room_get_random_connection(hunter->current_room);
+        if (!target_room) return;
+    }
+    if (room_move_entity(hunter->current_room, target_room, hunter)) {
+        unsigned clock = __atomic_add_fetch(&house->move_clock, 1, __ATOMIC_RELAXED);
+        room_record_visit(target_room, clock);
+        log_move(hunter->id, hunter->boredom, hunter->fear,
+                 prev_room->name, target_room->name, hunter->device);
+
+        if (!hunter->return_to_van) {
+            roomstack_push(&hunter->path, prev_room);
+        }
+    } else if (hunter->return_to_van) {
+        // The room was full; keep it on the path and try again next turn
+        roomstack_push(&hunter->path, target_room);
+    }
+}
+
+// One full turn; is_running is cleared when the hunter decides to leave
+void hunter_take_turn(struct Hunter* hunter) {
+    if (!hunter || !hunter->is_running) return;
+    trace_turn();
+    hunter->turns++;
+    long long turn_began = phase_clock();
+    if (turn_began) timeline_enter(ENTITY_HUNTER, hunter->id);
+    hunter_update_stats(hunter);
+    long long began = phase_end(PHASE_HUNTER_UPDATE_STATS, turn_began);
+    bool exiting = hunter_check_exit_conditions(hunter);
+    began = phase_end(PHASE_HUNTER_EXIT_CHECK, began);
+    if (!exiting) {
+        hunter_van_check(hunter);
+        began = phase_end(PHASE_HUNTER_VAN_CHECK, began);
+    }
+    if (!exiting && hunter->is_running) {
+        hunter_gather_evidence(hunter);
+        began = phase_end(PHASE_HUNTER_GATHER, began);
+        hunter_move(hunter);
+        phase_end(PHASE_HUNTER_MOVE, began);
+    }
+    phase_end(PHASE_HUNTER_TURN, turn_began);
+    telemetry_hunter(hunter);
+}
+
+// Hands back the device and the hunter's place in the room, then counts it out
+void hunter_leave_house(struct Hunter* hunter) {
+    if (!hunter) return;
+    struct House* house = hunter->house;
+    __atomic_sub_fetch(&house->device_holders[evidence_to_index(hunter->device)], 1, __ATOMIC_RELAXED);
+    if (hunter->current_room) {
+        room_remove_hunter(hunter->current_room, hunter);
+    }
+    telemetry_hunter(hunter);
+    house_hunter_exited(house);
+}
+
+void* hunter_thread(void* arg) {
+    struct Hunter* hunter = (struct Hunter*)arg;
+    if (!hunter) return NULL;
+
+    if (!hunter->house->config.quiet) {
+        printf("Hunter %d thread started\n", hunter->id);
+    }
+    rand_bind_stream(&hunter->rng_state);
+    trace_bind(hunter->entity.trace);
+    timeline_enter(ENTITY_HUNTER, hunter->id);
+
+    // Hunters care about the ghost showing up and evidence appearing where they stand
+    const unsigned interest = ROOM_EVENT_GHOST | ROOM_EVENT_EVIDENCE;
+    struct House* house = hunter->house;
+    while (hunter->is_running && !house_is_shutting_down(house)) {
+        struct Room* turn_room = hunter->current_room;
+        unsigned seen = room_event_snapshot(turn_room, interest);
+        house_turn_begin(house);
+        hunter_take_turn(hunter);
+        house_turn_end(house);
+        if (!hunter->is_running) {
+            break;
+        }
+        if (house->config.fast) {
+            continue;
+        }
+        // Changes that happened in a room we just left don't matter any more
+        if (hunter->current_room != turn_room) {
+            turn_room = hunter->current_room;
+            seen = room_event_snapshot(turn_room, interest);
+        }
+        if (house->config.wake_mode == WAKE_MODE_EVENT) {
+            room_wait_event(turn_room, interest, seen, HUNTER_TURN_NS, &house->shutdown);
+        } else {
+            house_wait_done_ns(house, HUNTER_TURN_NS);
+        }
+    }
+
+    hunter_leave_house(hunter);
+    if (!house->config.quiet) {
+        printf("Hunter %d thread exiting\n", hunter->id);
+    }
+    return NULL;
+}
@@ -0,0 +1,301 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+#include "defs.h"
+#include "helpers.h"
+
+// Evidence lifecycle: how long a piece of evidence lies in a room between the ghost
+// dropping it and a hunter with the matching device picking it up. The drop stamps are
+// kept per room, ghost and evidence bit and are only touched by whoever holds the room,
+// inside room_add_evidence() and room_remove_evidence(), so they need no locking of
+// their own. Every pickup becomes a sample in the collecting thread's own buffer; there
+// are few enough of them to keep every one and report exact percentiles.
+//
+// Two clocks are kept: wall time, and the house move clock (hunter arrivals anywhere in
+// the house), which doesn't depend on --fast or the turn pacing and so compares
+// exploration policies on equal terms.
+
+struct DropStamp {
+    long long dropped_ns;       // 0 while nothing of this kind lies in the room
+    unsigned dropped_tick;
+};
+
+struct PickupSample {
+    int room;
+    int device;                 // evidence_to_index() of the evidence and its device
+    long long wait_ns;
+    unsigned wait_ticks;
+};
+
+struct ThreadPickups {
+    struct ThreadPickups* next;
+    struct PickupSample* samples;
+    int count;
+    int capacity;
+};
+
+struct LifecycleRow {
+    long drops;
+    long pickups;
+    long left;                  // still lying there when the run ended
+};
+
+static bool lifecycle_enabled = false;
+static const struct House* lifecycle_house = NULL;
+static struct DropStamp* stamps = NULL;     // [room][ghost][device]
+static long* drop_counts = NULL;            // [room][device], written like the stamps
+static struct ThreadPickups* all_pickups = NULL;
+static pthread_mutex_t all_pickups_lock = PTHREAD_MUTEX_INITIALIZER;
+static _Thread_local struct ThreadPickups* local_pickups = NULL;
+
+static long long monotonic_ns() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long long)now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+static int room_index(const struct Room* room) {
+    const struct Room* first = lifecycle_house->rooms;
+    if (!room || room < first || room >= first + lifecycle_house->room_count) return -1;
+    return (int)(room - first);
+}
+
+static struct DropStamp* stamp_for(int room, int ghost_index, int device) {
+    return &stamps[((size_t)room * lifecycle_house->ghost_count + ghost_index) * EVIDENCE_TYPE_COUNT + device];
+}
+
+// Has to run before the entity threads start; evidence already lying in the house, as
+// after --resume, has no drop time and isn't counted when it's picked up
+bool lifecycle_start(const struct House* house) {
+    if (!house || house->room_count == 0 || house->ghost_count == 0) return false;
+    size_t stamp_count = (size_t)house->room_count * house->ghost_count * EVIDENCE_TYPE_COUNT;
+    stamps = calloc(stamp_count, sizeof(struct DropStamp));
+    drop_counts = calloc((size_t)house->room_count * EVIDENCE_TYPE_COUNT, sizeof(long));
+    if (!stamps || !drop_counts) {
+        fprintf(stderr, "Failed to allocate evidence lifecycle tracking; running without it\n");
+        free(stamps);
+        free(drop_counts);
+        stamps = NULL;
+        drop_counts = NULL;
+        return false;
+    }
+    lifecycle_house = house;
+    lifecycle_enabled = true;
+    return true;
+}
+
+// Called with the room held when evidence the room didn't have of this ghost is dropped
+void lifecycle_dropped(const struct Room* room, int ghost_index, enum EvidenceType evidence) {
+    if (!lifecycle_enabled) return;
+    int index = room_index(room);
+    int device = evidence_to_index(evidence);
+    if (index < 0 || device < 0 || ghost_index < 0 || ghost_index >= lifecycle_house->ghost_count) return;
+    struct DropStamp* stamp = stamp_for(index, ghost_index, device);
+    stamp->dropped_ns = monotonic_ns();
+    stamp->dropped_tick = __atomic_load_n(&lifecycle_house->move_clock, __ATOMIC_RELAXED);
+    drop_counts[(size_t)index * EVIDENCE_TYPE_COUNT + device]++;
+}
+
+// Called with the room held when a hunter takes evidence out of it
+void lifecycle_collected(const struct Room* room, int ghost_index, enum EvidenceType evidence) {
+    if (!lifecycle_enabled) return;
+    int index = room_index(room);
+    int device = evidence_to_index(evidence);
+    if (index < 0 || device < 0 || ghost_index < 0 || ghost_index >= lifecycle_house->ghost_count) return;
+    struct DropStamp* stamp = stamp_for(index, ghost_index, device);
+    if (stamp->dropped_ns == 0) return;
+    struct PickupSample sample = {
+        .room = index,
+        .device = device,
+        .wait_ns = monotonic_ns() - stamp->dropped_ns,
+        .wait_ticks = __atomic_load_n(&lifecycle_house->move_clock, __ATOMIC_RELAXED) - stamp->dropped_tick,
+    };
+    stamp->dropped_ns = 0;
+
+    if (!local_pickups) {
+        local_pickups = calloc(1, sizeof(struct ThreadPickups));
+        if (!local_pickups) return;
+        pthread_mutex_lock(&all_pickups_lock);
+        local_pickups->next = all_pickups;
+        all_pickups = local_pickups;
+        pthread_mutex_unlock(&all_pickups_lock);
+    }
+    struct ThreadPickups* pickups = local_pickups;
+    if (pickups->count == pickups->capacity) {
+        int capacity = pickups->capacity ? pickups->capacity * 2 : 64;
+        struct PickupSample* grown = realloc(pickups->samples, (size_t)capacity * sizeof(struct PickupSample));
+        if (!grown) return;
+        pickups->samples = grown;
+        pickups->capacity = capacity;
+    }
+    pickups->samples[pickups->count++] = sample;
+}
+
+static int compare_by_room(const void* a, const void* b) {
+    const struct PickupSample* x = a;
+    const struct PickupSample* y = b;
+    if (x->room != y->room) return x->room < y->room ? -1 : 1;
+    return (x->wait_ns > y->wait_ns) - (x->wait_ns < y->wait_ns);
+}
+
+static int compare_by_device(const void* a, const void* b) {
+    const struct PickupSample* x = a;
+    const struct PickupSample* y = b;
+    if (x->device != y->device) return x->device < y->device ? -1 : 1;
+    return (x->wait_ns > y->wait_ns) - (x->wait_ns < y->wait_ns);
+}
+
+static int compare_by_wait(const void* a, const void* b) {
+    const struct PickupSample* x = a;
+    const struct PickupSample* y = b;
+    return (x->wait_ns > y->wait_ns) - (x->wait_ns < y->wait_ns);
+}
+
+static int compare_ticks(const void* a, const void* b) {
+    unsigned x = *(const unsigned*)a;
+    unsigned y = *(const unsigned*)b;
+    return (x > y) - (x < y);
+}
+
+// One table line; samples are sorted by wait time and ticks is scratch space for them
+static void print_row(const char* name, const struct LifecycleRow* row, const struct PickupSample* samples,
+                      int count, unsigned* ticks) {
+    printf("%-24.24s %6ld %7ld %5ld", name, row->drops, row->pickups, row->left);
+    if (count == 0) {
+        printf(" %9s %9s %9s %7s %7s\n", "-", "-", "-", "-", "-");
+        return;
+    }
+    for (int i = 0; i < count; i++) {
+        ticks[i] = samples[i].wait_ticks;
+    }
+    qsort(ticks, count, sizeof(unsigned), compare_ticks);
+    printf(" %9.3f %9.3f %9.3f %7u %7u\n", samples[count / 2].wait_ns / 1e6,
+           samples[(int)(count * 0.9)].wait_ns / 1e6, samples[count - 1].wait_ns / 1e6,
+           ticks[count / 2], ticks[(int)(count * 0.9)]);
+}
+
+static void print_header(const char* title, const char* key) {
+    printf("\n%s\n", title);
+    printf("%-24s %6s %7s %5s %9s %9s %9s %7s %7s\n", key, "drops", "pickups", "left", "p50 ms", "p90 ms",
+           "max ms", "p50 mv", "p90 mv");
+}
+
+// Only once every entity has stopped; the stamps are read without the room locks
+void lifecycle_report() {
+    if (!lifecycle_enabled) return;
+    const struct House* house = lifecycle_house;
+    int room_count = house->room_count;
+
+    int total = 0;
+    pthread_mutex_lock(&all_pickups_lock);
+    for (const struct ThreadPickups* pickups = all_pickups; pickups; pickups = pickups->next) {
+        total += pickups->count;
+    }
+    struct PickupSample* samples = malloc((size_t)(total > 0 ? total : 1) * sizeof(struct PickupSample));
+    unsigned* ticks = malloc((size_t)(total > 0 ? total : 1) * sizeof(unsigned));
+    struct LifecycleRow* rows = calloc((size_t)room_count * EVIDENCE_TYPE_COUNT, sizeof(struct LifecycleRow));
+    if (!samples || !ticks || !rows) {
+        pthread_mutex_unlock(&all_pickups_lock);
+        free(samples);
+        free(ticks);
+        free(rows);
+        return;
+    }
+    int filled = 0;
+    for (const struct ThreadPickups* pickups = all_pickups; pickups; pickups = pickups->next) {
+        memcpy(samples + filled, pickups->samples, (size_t)pickups->count * sizeof(struct PickupSample));
+        filled += pickups->count;
+    }
+    pthread_mutex_unlock(&all_pickups_lock);
+
+    // rows[room][device]; the room and device tables add them up either way
+    for (int r = 0; r < room_count; r++) {
+        for (int d = 0; d < EVIDENCE_TYPE_COUNT; d++) {
+            struct LifecycleRow* row = &rows[(size_t)r * EVIDENCE_TYPE_COUNT + d];
+            row->drops = drop_counts[(size_t)r * EVIDENCE_TYPE_COUNT + d];
+            for (int g = 0; g < house->ghost_count; g++) {
+                row->left += stamp_for(r, g, d)->dropped_ns != 0;
+            }
+        }
+    }
+    for (int i = 0; i < total; i++) {
+        rows[(size_t)samples[i].room * EVIDENCE_TYPE_COUNT + samples[i].device].pickups++;
+    }
+
+    printf("\n--- Evidence Lifecycle (drop to pickup) ---\n");
+    printf("Waits in milliseconds (ms) and in house moves (mv), the hunter arrivals in between\n");
+    print_header("By room:", "room");
+    qsort(samples, total, sizeof(struct PickupSample), compare_by_room);
+    int start = 0;
+    for (int r = 0; r < room_count; r++) {
+        struct LifecycleRow sum = {0, 0, 0};
+        for (int d = 0; d < EVIDENCE_TYPE_COUNT; d++) {
+            const struct LifecycleRow* row = &rows[(size_t)r * EVIDENCE_TYPE_COUNT + d];
+            sum.drops += row->drops;
+            sum.pickups += row->pickups;
+            sum.left += row->left;
+        }
+        int end = start;
+        while (end < total && samples[end].room == r) end++;
+        if (sum.drops > 0 || end > start) {
+            print_row(house->rooms[r].name, &sum, samples + start, end - start, ticks);
+        }
+        start = end;
+    }
+
+    print_header("By device:", "device");
+    qsort(samples, total, sizeof(struct PickupSample), compare_by_device);
+    const enum EvidenceType* devices = NULL;
+    int device_count = get_all_evidence_types(&devices);
+    struct LifecycleRow overall = {0, 0, 0};
+    start = 0;
+    for (int d = 0; d < EVIDENCE_TYPE_COUNT; d++) {
+        struct LifecycleRow sum = {0, 0, 0};
+        for (int r = 0; r < room_count; r++) {
+            const struct LifecycleRow* row = &rows[(size_t)r * EVIDENCE_TYPE_COUNT + d];
+            sum.drops += row->drops;
+            sum.pickups += row->pickups;
+            sum.left += row->left;
+        }
+        overall.drops += sum.drops;
+        overall.pickups += sum.pickups;
+        overall.left += sum.left;
+        int end = start;
+        while (end < total && samples[end].device == d) end++;
+        const char* name = "unknown";
+        for (int i = 0; i < device_count; i++) {
+            if (evidence_to_index(devices[i]) == d) name = evidence_to_string(devices[i]);
+        }
+        if (sum.drops > 0 || end > start) {
+            print_row(name, &sum, samples + start, end - start, ticks);
+        }
+        start = end;
+    }
+
+    qsort(samples, total, sizeof(struct PickupSample), compare_by_wait);
+    print_row("all", &overall, samples, total, ticks);
+
+    free(samples);
+    free(ticks);
+    free(rows);
+}
+
+void lifecycle_free() {
+    pthread_mutex_lock(&all_pickups_lock);
+    struct ThreadPickups* pickups = all_pickups;
+    all_pickups = NULL;
+    pthread_mutex_unlock(&all_pickups_lock);
+    while (pickups) {
+        struct ThreadPickups* next = pickups->next;
+        free(pickups->samples);
+        free(pickups);
+        pickups = next;
+    }
+    free(stamps);
+    free(drop_counts);
+    stamps = NULL;
+    drop_counts = NULL;
+    lifecycle_enabled = false;
+}
@@ -1,162 +1,914 @@
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-#include <pthread.h>
-#include "defs.h"
-#include "helpers.h"
-
-int main() {
-    struct House* house = NULL;
-    pthread_t ghost_tid;
-    pthread_t* hunter_tids = NULL;
-
-    printf("=== Ghost Hunter Simulation Starting ===\n");
-
-    // 1. Initialize a House structure
-    house = house_init();
-    if (!house) {
-        fprintf(stderr, "Failed to initialize house\n");
-        return EXIT_FAILURE;
-    }
-
-    // 2. Populate the House with rooms using the provided helper function
-    house_populate_rooms(house);
-    printf("House populated with %d rooms\n", house->room_count);
-
-    // 3. Initialize the ghost data
-    house->ghost = ghost_init(house);
-    if (house->ghost == NULL) {
-        fprintf(stderr, "Failed to initialize ghost\n");
-        house_cleanup(house);
-        return EXIT_FAILURE;
-    }
-
-    // 4. Initialize hunters based on user input
-    printf("\n--- Hunter Registration ---\n");
-    printf("Enter hunter details (type 'done' for name to finish):\n");
-
-    char name_buffer[MAX_HUNTER_NAME];
-    int hunter_id;
-
-    while (house->hunter_count < MAX_ROOM_OCCUPANCY) {
-        printf("\nHunter name: ");
-        if (scanf("%63s", name_buffer) != 1) break;
-
-        if (strcmp(name_buffer, "done") == 0) {
-            break;
-        }
-
-        printf("Hunter ID: ");
-        if (scanf("%d", &hunter_id) != 1) {
-            fprintf(stderr, "Invalid ID input\n");
-            int c;
-            while ((c = getchar()) != '\n' && c != EOF);
-            continue;
-        }
-
-        struct Hunter* new_hunter = hunter_init(name_buffer, hunter_id, house);
-        if (!new_hunter) {
-            fprintf(stderr, "Failed to create hunter %s\n", name_buffer);
-            continue;
-        }
-
-        hunter_collection_append(house, new_hunter);
-        log_hunter_init(hunter_id, house->starting_room->name, name_buffer, new_hunter->device);
-    }
-
-    if (house->hunter_count == 0) {
-        printf("No hunters created. Simulation ending.\n");
-        house_cleanup(house);
-        return EXIT_SUCCESS;
-    }
-
-    printf("\n--- Starting Simulation with %d hunters ---\n", house->hunter_count);
-
-    // 5. Create threads for the ghost and each hunter
-    hunter_tids = malloc(sizeof(pthread_t) * house->hunter_count);
-    if (!hunter_tids) {
-        fprintf(stderr, "Failed to allocate thread array\n");
-        house_cleanup(house);
-        return EXIT_FAILURE;
-    }
-
-    // Start ghost thread
-    if (pthread_create(&ghost_tid, NULL, ghost_thread, house->ghost) != 0) {
-        fprintf(stderr, "Failed to create ghost thread\n");
-        free(hunter_tids);
-        house_cleanup(house);
-        return EXIT_FAILURE;
-    }
-
-    // Start hunter threads
-    for (int i = 0; i < house->hunter_count; i++) {
-        if (pthread_create(&hunter_tids[i], NULL, hunter_thread, house->hunters[i]) != 0) {
-            fprintf(stderr, "Failed to create hunter thread %d\n", i);
-            // Signal all previously created threads to end
-            for (int j = 0; j < i; j++) {
-                house->hunters[j]->is_running = false;
-            }
-            house->ghost->is_running = false;
-            break;
-        }
-    }
-
-    printf("\n--- Simulation Running ---\n");
-    pthread_join(ghost_tid, NULL);
-
-    for (int i = 0; i < house->hunter_count; i++) {
-        if (house->hunters[i]) {
-            house->hunters[i]->is_running = false;
-        }
-    }
-    for (int i = 0; i < house->hunter_count; i++) {
-        pthread_join(hunter_tids[i], NULL);
-    }
-    free(hunter_tids);
-
-    printf("\n--- Simulation Complete ---\n");
-
-    // 7. Print final results to the console
-    printf("\n=== FINAL RESULTS ===\n");
-    printf("Ghost Type: %s\n", ghost_to_string(house->ghost->type));
-    printf("Ghost ID: %d\n", house->ghost->id);
-    printf("Ghost exited due to: %s\n",
-           house->ghost->boredom > ENTITY_BOREDOM_MAX ? "boredom" : "hunters won");
-
-    printf("\n--- Hunter Results ---\n");
-    for (int i = 0; i < house->hunter_count; i++) {
-        struct Hunter* h = house->hunters[i];
-        printf("Hunter %d (%s):\n", h->id, h->name);
-        printf("  Exit reason: %s\n", exit_reason_to_string(h->exit_reason));
-        printf("  Final device: %s\n", evidence_to_string(h->device));
-        printf("  Final stats: boredom=%d, fear=%d\n", h->boredom, h->fear);
-    }
-
-    printf("\n--- Evidence Analysis ---\n");
-    printf("Collected evidence bits: 0x%02X\n", house->case_file.collected);
-    printf("Evidence matches known ghost: %s\n",
-           evidence_is_valid_ghost(house->case_file.collected) ? "YES" : "NO");
-
-    const enum GhostType* ghost_types = NULL;
-    int ghost_count = get_all_ghost_types(&ghost_types);
-    enum GhostType matched_ghost = 0;
-    for (int i = 0; i < ghost_count; i++) {
-        if (house->case_file.collected == (EvidenceByte)ghost_types[i]) {
-            matched_ghost = ghost_types[i];
-            break;
-        }
-    }
-    if (matched_ghost != 0) {
-        printf("Evidence identifies ghost as: %s\n", ghost_to_string(matched_ghost));
-        printf("Correct identification: %s\n",
-               matched_ghost == house->ghost->type ? "YES" : "NO");
-    } else {
-        printf("Evidence is insufficient or inconsistent to identify a specific ghost.\n");
-    }
-
-    // 8. Clean up all dynamically allocated resources
-    house_cleanup(house);
-
-    printf("\n=== Simulation Cleanup Complete ===\n");
-    return EXIT_SUCCESS;
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <limits.h>
+#include <time.h>
+#include <unistd.h>
+#include "defs.h"
+#include "helpers.h"
+
+#define STACK_KB_MAX (1024L * 1024L)    // 1 GiB per entity thread is already far past useful
+
+static void print_usage(const char* program) {
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  --device-policy random|informed  How hunters pick a device at the van (default random)\n"
+            "  --explore random|frontier        How hunters choose their next room (default random)\n"
+            "  --wake tick|event                Sleep a fixed tick, or until the entity's room changes (default tick)\n"
+            "  --fast                           Run without per-turn sleeps or log pacing\n"
+            "  --seed N                         Seed every entity's random stream from N\n"
+            "  --hunters N                      Register N generated hunters instead of reading stdin\n"
+            "  --scenario FILE                  Register hunters from FILE, one 'name id' per line\n"
+            "  --room-capacity N                Hunters allowed per room (default %d; the van always fits everyone)\n"
+            "  --stack-kb N                     Stack size of each entity thread in KiB (default 64, 0 = system)\n"
+            "  --quiet                          Don't print a console line for every event\n"
+            "  --no-log                         Don't write log_<id>.csv files\n"
+            "  --check                          Check the simulation's invariants while it runs\n"
+            "  --contention                     Report how long entities waited on each room and case file lock\n"
+            "  --phase-times                    Report latency percentiles of every turn phase at the end,\n"
+            "                                   and mid-run whenever the process gets SIGUSR1\n"
+            "  --perf-counters                  Report cycles, instructions, IPC, cache and branch misses and\n"
+            "                                   context switches of every turn phase; counters the machine\n"
+            "                                   doesn't offer are left out\n"
+            "  --evidence-latency               Report how long dropped evidence lay in each room, and per\n"
+            "                                   device, before a hunter picked it up\n"
+            "  --timeline FILE                  Write every turn phase, contended lock wait and event to FILE\n"
+            "                                   as a Chrome trace, one track per entity (chrome://tracing,\n"
+            "                                   ui.perfetto.dev)\n"
+            "  --telemetry NAME                 Publish live state in shared memory segment NAME for\n"
+            "                                   ghost_hunter_top NAME to watch\n"
+            "  --ghosts N                       Number of ghosts haunting the house (default 1)\n"
+            "  --exec threads|actors            One thread per entity, or workers that own groups of rooms (default threads)\n"
+            "  --workers N                      Actor workers (default one per online CPU)\n"
+            "  --rooms N                        Generated grid layout with N rooms instead of Willow House\n"
+            "  --checkpoint FILE                Keep a snapshot of the running simulation in FILE\n"
+            "  --checkpoint-interval MS         Time between snapshots (default 1000)\n"
+            "  --resume FILE                    Continue the simulation saved in FILE; its layout, ghosts,\n"
+            "                                   hunters, policies and seed replace the options above\n"
+            "  --record FILE                    Save everything the run's outcome depended on to FILE\n"
+            "  --replay FILE                    Rerun the trace in FILE on one thread without sleeping;\n"
+            "                                   it rewrites the same log files as the recorded run\n"
+            "  --branches K                     Fork K alternative futures of the run, each with its own\n"
+            "                                   random streams and branch<k>_log_<id>.csv files\n"
+            "  --branch-at MS                   How far into the run to branch (default 1000)\n"
+            "  --batch N                        Run N independent simulations with seeds derived from --seed\n"
+            "                                   and print aggregate outcomes instead of one run's results;\n"
+            "                                   needs --hunters or --scenario\n"
+            "  --batch-workers N                Processes running batch simulations (default one per online CPU)\n"
+            "  --batch-precision P              Treat --batch N as a budget and stop once the 95%% intervals of\n"
+            "                                   identification, win and fear exit rates are within +/- P\n"
+            "                                   (a proportion, e.g. 0.01)\n",
+            program, MAX_ROOM_OCCUPANCY);
+}
+
+struct HunterSource {
+    int generated;          // > 0 to register this many generated hunters
+    const char* scenario;   // path of a scenario file, or NULL
+    const char* resume;     // checkpoint to continue from instead of registering, or NULL
+    const char* replay;     // trace whose hunters, and every turn, are replayed, or NULL
+};
+
+struct CheckpointOptions {
+    const char* path;       // where to keep the latest checkpoint, or NULL
+    long interval_ms;
+    const char* record;     // where to save the run's trace, or NULL
+    const char* timeline;   // where to write the Chrome trace timeline, or NULL
+    const char* telemetry;  // shared memory segment to publish live state in, or NULL
+};
+
+struct BranchOptions {
+    int count;              // futures to fork, 0 for none
+    long at_ms;             // time into the run to fork them at
+};
+
+struct BatchOptions {
+    long long runs;         // independent simulations to aggregate, 0 for a single ordinary run
+    int workers;            // processes running them, 0 for one per online CPU
+    double precision;       // interval half-width to stop at, 0 to run all of them
+};
+
+static bool parse_arguments(int argc, char* argv[], struct SimConfig* config, struct HunterSource* source,
+                            struct CheckpointOptions* checkpoint, struct BranchOptions* branching,
+                            struct BatchOptions* batch) {
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* value = (i + 1 < argc) ? argv[i + 1] : NULL;
+        if (strcmp(arg, "--device-policy") == 0 && value) {
+            if (strcmp(value, "random") == 0) {
+                config->device_policy = DEVICE_POLICY_RANDOM;
+            } else if (strcmp(value, "informed") == 0) {
+                config->device_policy = DEVICE_POLICY_INFORMED;
+            } else {
+                fprintf(stderr, "Unknown device policy '%s'\n", value);
+                return false;
+            }
+            i++;
+        } else if (strcmp(arg, "--explore") == 0 && value) {
+            if (strcmp(value, "random") == 0) {
+                config->explore_policy = EXPLORE_POLICY_RANDOM;
+            } else if (strcmp(value, "frontier") == 0) {
+                config->explore_policy = EXPLORE_POLICY_FRONTIER;
+            } else {
+                fprintf(stderr, "Unknown exploration policy '%s'\n", value);
+                return false;
+            }
+            i++;
+        } else if (strcmp(arg, "--wake") == 0 && value) {
+            if (strcmp(value, "tick") == 0) {
+                config->wake_mode = WAKE_MODE_TICK;
+            } else if (strcmp(value, "event") == 0) {
+                config->wake_mode = WAKE_MODE_EVENT;
+            } else {
+                fprintf(stderr, "Unknown wake mode '%s'\n", value);
+                return false;
+            }
+            i++;
+        } else if (strcmp(arg, "--fast") == 0) {
+            config->fast = true;
+        } else if (strcmp(arg, "--seed") == 0 && value) {
+            config->seed = (unsigned)strtoul(value, NULL, 10);
+            config->seeded = true;
+            i++;
+        } else if (strcmp(arg, "--hunters") == 0 && value) {
+            source->generated = atoi(value);
+            if (source->generated < 1) {
+                fprintf(stderr, "--hunters needs a positive count\n");
+                return false;
+            }
+            i++;
+        } else if (strcmp(arg, "--scenario") == 0 && value) {
+            source->scenario = value;
+            i++;
+        } else if (strcmp(arg, "--room-capacity") == 0 && value) {
+            config->room_capacity = atoi(value);
+            if (config->room_capacity < 1) {
+                fprintf(stderr, "--room-capacity needs a positive count\n");
+                return false;
+            }
+            i++;
+        } else if (strcmp(arg, "--stack-kb") == 0 && value) {
+            // 0 keeps the system default; anything else has to be big enough to start a thread
+            char* end = NULL;
+            long kb = strtol(value, &end, 10);
+            unsigned long min_kb = ((unsigned long)PTHREAD_STACK_MIN + 1023) / 1024;
+            if (end == value || *end != '\0' || kb < 0 || kb > STACK_KB_MAX ||
+                (kb > 0 && (unsigned long)kb < min_kb)) {
+                fprintf(stderr, "--stack-kb needs 0 or a size from %lu to %ld KiB\n", min_kb, STACK_KB_MAX);
+                return false;
+            }
+            config->stack_size = (size_t)kb * 1024;
+            i++;
+        } else if (strcmp(arg, "--ghosts") == 0 && value) {
+            config->ghost_count = atoi(value);
+            if (config->ghost_count < 1) {
+                fprintf(stderr, "--ghosts needs a positive count\n");
+                return false;
+            }
+            i++;
+        } else if (strcmp(arg, "--exec") == 0 && value) {
+            if (strcmp(value, "threads") == 0) {
+                config->exec_mode = EXEC_MODE_THREADS;
+            } else if (strcmp(value, "actors") == 0) {
+                config->exec_mode = EXEC_MODE_ACTORS;
+            } else {
+                fprintf(stderr, "Unknown execution mode '%s'\n", value);
+                return false;
+            }
+            i++;
+        } else if (strcmp(arg, "--workers") == 0 && value) {
+            config->worker_count = atoi(value);
+            if (config->worker_count < 1) {
+                fprintf(stderr, "--workers needs a positive count\n");
+                return false;
+            }
+            i++;
+        } else if (strcmp(arg, "--rooms") == 0 && value) {
+            config->layout_rooms = atoi(value);
+            if (config->layout_rooms < 2) {
+                fprintf(stderr, "--rooms needs at least 2 rooms\n");
+                return false;
+            }
+            i++;
+        } else if (strcmp(arg, "--checkpoint") == 0 && value) {
+            checkpoint->path = value;
+            i++;
+        } else if (strcmp(arg, "--checkpoint-interval") == 0 && value) {
+            checkpoint->interval_ms = atol(value);
+            if (checkpoint->interval_ms < 1) {
+                fprintf(stderr, "--checkpoint-interval needs a positive number of milliseconds\n");
+                return false;
+            }
+            i++;
+        } else if (strcmp(arg, "--resume") == 0 && value) {
+            source->resume = value;
+            i++;
+        } else if (strcmp(arg, "--branches") == 0 && value) {
+            branching->count = atoi(value);
+            if (branching->count < 1) {
+                fprintf(stderr, "--branches needs a positive count\n");
+                return false;
+            }
+            i++;
+        } else if (strcmp(arg, "--branch-at") == 0 && value) {
+            branching->at_ms = atol(value);
+            if (branching->at_ms < 0) {
+                fprintf(stderr, "--branch-at can't be negative\n");
+                return false;
+            }
+            i++;
+        } else if (strcmp(arg, "--record") == 0 && value) {
+            checkpoint->record = value;
+            i++;
+        } else if (strcmp(arg, "--batch") == 0 && value) {
+            batch->runs = atoll(value);
+            if (batch->runs < 1) {
+                fprintf(stderr, "--batch needs a positive number of runs\n");
+                return false;
+            }
+            i++;
+        } else if (strcmp(arg, "--batch-workers") == 0 && value) {
+            batch->workers = atoi(value);
+            if (batch->workers < 1) {
+                fprintf(stderr, "--batch-workers needs a positive count\n");
+                return false;
+            }
+            i++;
+        } else if (strcmp(arg, "--batch-precision") == 0 && value) {
+            batch->precision = atof(value);
+            if (batch->precision <= 0.0 || batch->precision >= 0.5) {
+                fprintf(stderr, "--batch-precision needs a proportion between 0 and 0.5\n");
+                return false;
+            }
+            i++;
+        } else if (strcmp(arg, "--timeline") == 0 && value) {
+            checkpoint->timeline = value;
+            i++;
+        } else if (strcmp(arg, "--telemetry") == 0 && value) {
+            checkpoint->telemetry = value;
+            i++;
+        } else if (strcmp(arg, "--replay") == 0 && value) {
+            source->replay = value;
+            i++;
+        } else if (strcmp(arg, "--quiet") == 0) {
+            config->quiet = true;
+        } else if (strcmp(arg, "--no-log") == 0) {
+            config->log_files = false;
+        } else if (strcmp(arg, "--check") == 0) {
+            config->check = true;
+        } else if (strcmp(arg, "--contention") == 0) {
+            config->contention = true;
+        } else if (strcmp(arg, "--phase-times") == 0) {
+            config->phase_times = true;
+        } else if (strcmp(arg, "--perf-counters") == 0) {
+            config->perf_counters = true;
+        } else if (strcmp(arg, "--evidence-latency") == 0) {
+            config->evidence_latency = true;
+        } else {
+            fprintf(stderr, "Unknown or incomplete option '%s'\n", arg);
+            return false;
+        }
+    }
+    // A trace starts at registration, so it can't pick up a resumed run or another trace
+    if ((checkpoint->record || source->replay) && source->resume) {
+        fprintf(stderr, "--record and --replay can't be combined with --resume\n");
+        return false;
+    }
+    if (checkpoint->record && source->replay) {
+        fprintf(stderr, "--record and --replay can't be combined\n");
+        return false;
+    }
+    if (branching->count > 0 && source->replay) {
+        fprintf(stderr, "--branches can't be combined with --replay\n");
+        return false;
+    }
+    if (batch->precision > 0.0 && batch->runs == 0) {
+        fprintf(stderr, "--batch-precision needs --batch N as its run budget\n");
+        return false;
+    }
+    // Batch runs are built from scratch in worker processes and only report aggregates
+    if (batch->runs > 0) {
+        if (source->generated == 0 && !source->scenario) {
+            fprintf(stderr, "--batch needs --hunters or --scenario\n");
+            return false;
+        }
+        if (source->resume || source->replay || checkpoint->path || checkpoint->record || checkpoint->timeline ||
+            checkpoint->telemetry || branching->count > 0) {
+            fprintf(stderr, "--batch can't be combined with --resume, --replay, --checkpoint, --record, "
+                            "--timeline, --telemetry or --branches\n");
+            return false;
+        }
+        if (config->check || config->contention || config->phase_times || config->perf_counters ||
+            config->evidence_latency) {
+            fprintf(stderr, "--batch can't be combined with --check, --contention, --phase-times, "
+                            "--perf-counters or --evidence-latency\n");
+            return false;
+        }
+    }
+    return true;
+}
+
+// Creates one hunter in the van, growing the van first so every hunter fits
+static bool register_hunter(struct House* house, const char* name, int id) {
+    struct Room* van = house->starting_room;
+    if (van->hunter_count >= van->hunter_capacity &&
+        !room_set_capacity(van, van->hunter_capacity * 2)) {
+        fprintf(stderr, "Failed to grow the van for hunter %s\n", name);
+        return false;
+    }
+
+    struct Hunter* new_hunter = hunter_init(name, id, house);
+    if (!new_hunter) {
+        fprintf(stderr, "Failed to create hunter %s\n", name);
+        return false;
+    }
+
+    if (!hunter_collection_append(house, new_hunter)) {
+        fprintf(stderr, "Failed to store hunter %s\n", name);
+        __atomic_sub_fetch(&house->device_holders[evidence_to_index(new_hunter->device)], 1, __ATOMIC_RELAXED);
+        room_remove_hunter(van, new_hunter);
+        hunter_cleanup(new_hunter);
+        return false;
+    }
+    log_hunter_init(id, van->name, new_hunter->name, new_hunter->device);
+    return true;
+}
+
+static void register_hunters_interactive(struct House* house) {
+    printf("Enter hunter details (type 'done' for name to finish):\n");
+
+    char name_buffer[MAX_HUNTER_NAME];
+    int hunter_id;
+
+    while (true) {
+        printf("\nHunter name: ");
+        if (scanf("%63s", name_buffer) != 1) break;
+
+        if (strcmp(name_buffer, "done") == 0) {
+            break;
+        }
+
+        printf("Hunter ID: ");
+        if (scanf("%d", &hunter_id) != 1) {
+            fprintf(stderr, "Invalid ID input\n");
+            int c;
+            while ((c = getchar()) != '\n' && c != EOF);
+            continue;
+        }
+
+        register_hunter(house, name_buffer, hunter_id);
+    }
+}
+
+static bool register_hunters_from_file(struct House* house, const char* path) {
+    FILE* file = fopen(path, "r");
+    if (!file) {
+        fprintf(stderr, "Failed to open scenario file %s\n", path);
+        return false;
+    }
+
+    char line[256];
+    char name_buffer[MAX_HUNTER_NAME];
+    int hunter_id;
+    int line_number = 0;
+    while (fgets(line, sizeof(line), file)) {
+        line_number++;
+        if (line[0] == '#' || line[0] == '\n') continue;
+        if (sscanf(line, "%63s %d", name_buffer, &hunter_id) != 2) {
+            fprintf(stderr, "%s:%d: expected 'name id'\n", path, line_number);
+            continue;
+        }
+        register_hunter(house, name_buffer, hunter_id);
+    }
+    fclose(file);
+    return true;
+}
+
+// Registers the recorded hunters in their recorded order, so each gets its stream back
+static void register_hunters_from_trace(struct House* house) {
+    for (int i = 0; i < trace_hunter_count(); i++) {
+        register_hunter(house, trace_hunter_name(i), trace_hunter_id(i));
+    }
+}
+
+// Ids run from 1 upwards, skipping the ghosts' ids so log files never collide
+static void register_generated_hunters(struct House* house, int count) {
+    char name_buffer[MAX_HUNTER_NAME];
+    int hunter_id = 0;
+    for (int i = 0; i < count; i++) {
+        hunter_id++;
+        if (hunter_id >= DEFAULT_GHOST_ID && hunter_id < DEFAULT_GHOST_ID + house->ghost_count) {
+            hunter_id = DEFAULT_GHOST_ID + house->ghost_count;
+        }
+        snprintf(name_buffer, sizeof(name_buffer), "hunter%d", hunter_id);
+        register_hunter(house, name_buffer, hunter_id);
+    }
+}
+
+static long resident_kib() {
+    FILE* statm = fopen("/proc/self/statm", "r");
+    if (!statm) return 0;
+    long pages_total = 0;
+    long pages_resident = 0;
+    if (fscanf(statm, "%ld %ld", &pages_total, &pages_resident) != 2) {
+        pages_resident = 0;
+    }
+    fclose(statm);
+    return pages_resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+// High-water mark of this process's own memory; unlike ru_maxrss it doesn't start
+// from whatever the parent had resident when it forked us
+static long peak_resident_kib() {
+    FILE* status = fopen("/proc/self/status", "r");
+    if (!status) return 0;
+    char line[128];
+    long peak = 0;
+    while (fgets(line, sizeof(line), status)) {
+        if (sscanf(line, "VmHWM: %ld kB", &peak) == 1) break;
+    }
+    fclose(status);
+    return peak;
+}
+
+static double elapsed_ms(const struct timespec* start, const struct timespec* end) {
+    return (end->tv_sec - start->tv_sec) * 1000.0 + (end->tv_nsec - start->tv_nsec) / 1e6;
+}
+
+// Starts every ghost thread, then every hunter thread; returns the number of hunters started
+static int start_entity_threads(struct House* house, pthread_t* ghost_tids, pthread_t* hunter_tids,
+                                int* started_ghosts) {
+    // Entity threads keep very little on the stack, so small stacks let thousands fit
+    pthread_attr_t thread_attr;
+    pthread_attr_init(&thread_attr);
+    size_t stack_size = house->config.stack_size;
+    if (stack_size > 0 && pthread_attr_setstacksize(&thread_attr, stack_size) != 0) {
+        fprintf(stderr, "Stack size %zu rejected, using the default\n", stack_size);
+    }
+
+    // Start ghost threads; a resumed house can hold entities that already left
+    *started_ghosts = 0;
+    bool ghosts_started = true;
+    for (int i = 0; i < house->ghost_count; i++) {
+        if (!house->ghosts[i]->is_running) continue;
+        if (pthread_create(&ghost_tids[*started_ghosts], &thread_attr, ghost_thread, house->ghosts[i]) != 0) {
+            fprintf(stderr, "Failed to create ghost thread %d\n", i);
+            house_request_shutdown(house);
+            ghosts_started = false;
+            break;
+        }
+        (*started_ghosts)++;
+    }
+
+    // Start hunter threads
+    int started_hunters = 0;
+    for (int i = 0; i < house->hunter_count && ghosts_started; i++) {
+        if (!house->hunters[i]->is_running) continue;
+        if (pthread_create(&hunter_tids[started_hunters], &thread_attr, hunter_thread, house->hunters[i]) != 0) {
+            fprintf(stderr, "Failed to create hunter thread %d\n", i);
+            // Signal all previously created threads to end
+            house_request_shutdown(house);
+            break;
+        }
+        started_hunters++;
+    }
+    pthread_attr_destroy(&thread_attr);
+    return started_hunters;
+}
+
+static void write_checkpoint(struct House* house, const char* path) {
+    struct timespec begin;
+    struct timespec end;
+    long bytes = 0;
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+    if (house_checkpoint(house, path, &bytes)) {
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        printf("Checkpoint: %ld bytes written to %s in %.2f ms\n", bytes, path, elapsed_ms(&begin, &end));
+    }
+}
+
+// Steps 1-4 of a fresh run: the house, its rooms, the ghosts and the hunters
+static struct House* create_house(const struct SimConfig* config, const struct HunterSource* source) {
+    // 1. Initialize a House structure
+    struct House* house = house_init();
+    if (!house) {
+        fprintf(stderr, "Failed to initialize house\n");
+        return NULL;
+    }
+    house->config = *config;
+
+    // 2. Populate the House with rooms using the provided helper function
+    if (config->layout_rooms > 0) {
+        house_populate_generated(house, config->layout_rooms);
+    } else {
+        house_populate_rooms(house);
+    }
+    if (house->room_count == 0 || !house_apply_config(house)) {
+        fprintf(stderr, "Failed to size rooms\n");
+        house_cleanup(house);
+        return NULL;
+    }
+    printf("House populated with %d rooms\n", house->room_count);
+    // The checker has to see every INIT, so it starts before anyone arrives
+    if (config->check && !checker_start(house)) {
+        house_cleanup(house);
+        return NULL;
+    }
+
+    // 3. Initialize the ghosts, each with its own case file
+    if (!house_add_ghosts(house, config->ghost_count)) {
+        fprintf(stderr, "Failed to initialize ghosts\n");
+        house_cleanup(house);
+        return NULL;
+    }
+
+    // 4. Initialize hunters from a scenario, a generated count or user input
+    printf("\n--- Hunter Registration ---\n");
+    if (source->replay) {
+        register_hunters_from_trace(house);
+    } else if (source->scenario) {
+        if (!register_hunters_from_file(house, source->scenario)) {
+            house_cleanup(house);
+            return NULL;
+        }
+    } else if (source->generated > 0) {
+        register_generated_hunters(house, source->generated);
+    } else {
+        register_hunters_interactive(house);
+    }
+
+    if (!trace_attach_entities(house)) {
+        house_cleanup(house);
+        return NULL;
+    }
+    return house;
+}
+
+// Every batch run builds its house the way a fresh single run does
+static struct House* create_batch_house(const struct SimConfig* config, const void* context) {
+    return create_house(config, context);
+}
+
+static long long since_ms(const struct timespec* start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long long)elapsed_ms(start, &now);
+}
+
+// Waits for the outcome, taking checkpoints and forking the branches along the way
+static void wait_for_outcome(struct House* house, const struct CheckpointOptions* checkpoint,
+                             const struct BranchOptions* branching, struct BranchSet* branches) {
+    struct timespec started;
+    clock_gettime(CLOCK_MONOTONIC, &started);
+    long long next_checkpoint = checkpoint->path ? checkpoint->interval_ms : -1;
+    long long branch_at = branching->count > 0 ? branching->at_ms : -1;
+    while (true) {
+        long long due = next_checkpoint;
+        if (branch_at >= 0 && (due < 0 || branch_at < due)) {
+            due = branch_at;
+        }
+        if (due < 0) {
+            house_wait_done(house);
+            return;
+        }
+        long long wait_ms = due - since_ms(&started);
+        if (house_wait_done_for(house, wait_ms > 0 ? (long)wait_ms : 0)) {
+            return;
+        }
+        long long now = since_ms(&started);
+        if (branch_at >= 0 && now >= branch_at) {
+            house_branch(house, branching->count, branches);
+            branch_at = -1;
+        }
+        if (next_checkpoint >= 0 && now >= next_checkpoint) {
+            write_checkpoint(house, checkpoint->path);
+            next_checkpoint = since_ms(&started) + checkpoint->interval_ms;
+        }
+    }
+}
+
+static void write_trace(struct House* house, const char* path) {
+    long bytes = 0;
+    if (trace_save(path, house, &bytes)) {
+        printf("Trace: %ld bytes written to %s\n", bytes, path);
+    }
+}
+
+static void write_timeline(const char* path) {
+    long events = 0;
+    if (timeline_write(path, &events)) {
+        printf("Timeline: %ld events written to %s\n", events, path);
+    }
+}
+
+int main(int argc, char* argv[]) {
+    struct House* house = NULL;
+    pthread_t* ghost_tids = NULL;
+    pthread_t* hunter_tids = NULL;
+
+    struct SimConfig config;
+    struct HunterSource source = { .generated = 0, .scenario = NULL, .resume = NULL, .replay = NULL };
+    struct CheckpointOptions checkpoint = { .path = NULL, .interval_ms = 1000, .record = NULL,
+                                          .timeline = NULL, .telemetry = NULL };
+    struct BranchOptions branching = { .count = 0, .at_ms = 1000 };
+    struct BranchSet branches = { .count = 0, .pids = NULL, .outcome_fds = NULL, .fork_ms = 0.0 };
+    struct BatchOptions batch = { .runs = 0, .workers = 0, .precision = 0.0 };
+    simconfig_init(&config);
+    if (!parse_arguments(argc, argv, &config, &source, &checkpoint, &branching, &batch)) {
+        print_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    if (source.replay && !trace_load(source.replay, &config)) {
+        return EXIT_FAILURE;
+    }
+    // Before any other thread exists, so every one of them leaves SIGUSR1 to the dump thread
+    if (config.phase_times && !phase_timing_start()) {
+        return EXIT_FAILURE;
+    }
+    if (!config.seeded) {
+        config.seed = (unsigned)time(NULL) ^ (unsigned)getpid();
+    }
+    if (batch.runs > 0) {
+        return batch_run(&config, batch.runs, batch.workers, batch.precision, create_batch_house, &source) ?
+               EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    if (checkpoint.record) {
+        trace_start_recording();
+    }
+    // Workers run many entities each, so pacing every log line would stall all of them
+    log_set_pacing(!config.fast && config.exec_mode == EXEC_MODE_THREADS && !source.replay);
+    log_set_console(!config.quiet);
+    log_set_files(config.log_files);
+
+    printf("=== Ghost Hunter Simulation Starting ===\n");
+
+    struct timespec startup_begin;
+    clock_gettime(CLOCK_MONOTONIC, &startup_begin);
+    long rss_before_kib = resident_kib();
+    if (source.resume) {
+        house = house_restore(source.resume, &config);
+        if (!house) {
+            return EXIT_FAILURE;
+        }
+        if (config.check && !checker_start(house)) {
+            house_cleanup(house);
+            return EXIT_FAILURE;
+        }
+        struct timespec restored_at;
+        clock_gettime(CLOCK_MONOTONIC, &restored_at);
+        printf("Seed: %u\n", config.seed);
+        printf("Resumed %s in %.2f ms: %d rooms, %d ghosts, %d hunters\n", source.resume,
+               elapsed_ms(&startup_begin, &restored_at), house->room_count,
+               house->ghost_count, house->hunter_count);
+    } else {
+        printf("Seed: %u\n", config.seed);
+        house = create_house(&config, &source);
+        if (!house) {
+            return EXIT_FAILURE;
+        }
+    }
+
+    // Registration took the locks single-threaded; only the run itself is profiled
+    if (config.contention) {
+        contention_start(house, true);
+    }
+    if (checkpoint.timeline) {
+        timeline_start(house);
+    }
+    if (config.perf_counters) {
+        perf_counters_start();
+    }
+    if (config.evidence_latency) {
+        lifecycle_start(house);
+    }
+    if (checkpoint.telemetry && telemetry_start(house, checkpoint.telemetry)) {
+        printf("Telemetry: watch with ghost_hunter_top %s\n", checkpoint.telemetry);
+    }
+
+    int running_hunters = 0;
+    int running_ghosts = 0;
+    for (int i = 0; i < house->hunter_count; i++) {
+        running_hunters += house->hunters[i]->is_running;
+    }
+    for (int i = 0; i < house->ghost_count; i++) {
+        running_ghosts += house->ghosts[i]->is_running;
+    }
+    if (house->hunter_count == 0) {
+        printf("No hunters created. Simulation ending.\n");
+        house_cleanup(house);
+        return EXIT_SUCCESS;
+    }
+    if (running_hunters == 0 || running_ghosts == 0) {
+        printf("The checkpointed run had already ended. Simulation ending.\n");
+        house_cleanup(house);
+        return EXIT_SUCCESS;
+    }
+
+    printf("\n--- Starting Simulation with %d hunters ---\n", running_hunters);
+
+    // 5. Create threads for each ghost and each hunter, or the actor workers; a replay
+    //    runs every turn on this thread instead
+    bool replaying = source.replay != NULL;
+    bool use_actors = config.exec_mode == EXEC_MODE_ACTORS && !replaying;
+    bool use_threads = !use_actors && !replaying;
+    if (use_threads) {
+        hunter_tids = malloc(sizeof(pthread_t) * house->hunter_count);
+        ghost_tids = malloc(sizeof(pthread_t) * house->ghost_count);
+    }
+    if (use_threads && (!hunter_tids || !ghost_tids)) {
+        fprintf(stderr, "Failed to allocate thread array\n");
+        free(hunter_tids);
+        free(ghost_tids);
+        house_cleanup(house);
+        return EXIT_FAILURE;
+    }
+
+    // Only checkpoints and branches pause the run; without them turns skip the bracket
+    house->pausable = checkpoint.path != NULL || branching.count > 0;
+
+    // Count every entity as live up front so an early exit can't end the run
+    // before the rest have even started
+    for (int i = 0; i < running_hunters; i++) {
+        house_hunter_started(house);
+    }
+    for (int i = 0; i < running_ghosts; i++) {
+        house_ghost_started(house);
+    }
+
+    int started_ghosts = 0;
+    int started_hunters = 0;
+    if (replaying) {
+        started_ghosts = running_ghosts;
+        started_hunters = running_hunters;
+    } else if (use_actors) {
+        if (actors_start(house)) {
+            started_ghosts = running_ghosts;
+            started_hunters = running_hunters;
+        } else {
+            house_request_shutdown(house);
+        }
+    } else {
+        started_hunters = start_entity_threads(house, ghost_tids, hunter_tids, &started_ghosts);
+    }
+
+    struct timespec startup_end;
+    clock_gettime(CLOCK_MONOTONIC, &startup_end);
+    long rss_after_kib = resident_kib();
+    printf("Startup: %d hunters registered and started in %.2f ms, ~%.1f KiB resident per hunter\n",
+           started_hunters, elapsed_ms(&startup_begin, &startup_end),
+           started_hunters > 0 ? (double)(rss_after_kib - rss_before_kib) / started_hunters : 0.0);
+
+    printf("\n--- Simulation Running ---\n");
+    if (replaying) {
+        struct timespec replay_begin;
+        struct timespec replay_end;
+        clock_gettime(CLOCK_MONOTONIC, &replay_begin);
+        int turns = trace_replay(house);
+        clock_gettime(CLOCK_MONOTONIC, &replay_end);
+        printf("Replayed %d turns from %s in %.2f ms\n", turns, source.replay,
+               elapsed_ms(&replay_begin, &replay_end));
+        if (trace_has_diverged()) {
+            fprintf(stderr, "The replay diverged from the trace, so its logs differ from the recorded run\n");
+        }
+        started_ghosts = 0;
+        started_hunters = 0;
+    } else {
+        wait_for_outcome(house, &checkpoint, &branching, &branches);
+    }
+
+    if (use_actors) {
+        actors_join(house);
+    } else {
+        for (int i = 0; i < started_ghosts; i++) {
+            pthread_join(ghost_tids[i], NULL);
+        }
+        for (int i = 0; i < started_hunters; i++) {
+            pthread_join(hunter_tids[i], NULL);
+        }
+    }
+    struct timespec joined_at;
+    clock_gettime(CLOCK_MONOTONIC, &joined_at);
+    long long join_us = (joined_at.tv_sec - house->shutdown_at.tv_sec) * 1000000LL +
+                        (joined_at.tv_nsec - house->shutdown_at.tv_nsec) / 1000LL;
+    free(hunter_tids);
+    free(ghost_tids);
+    telemetry_stop();
+    if (checkpoint.record) {
+        write_trace(house, checkpoint.record);
+    }
+    if (checkpoint.timeline) {
+        write_timeline(checkpoint.timeline);
+    }
+    if (config.check) {
+        checker_stop();
+    }
+
+    printf("\n--- Simulation Complete ---\n");
+
+    // 7. Print final results to the console
+    printf("\n=== FINAL RESULTS ===\n");
+    for (int i = 0; i < house->ghost_count; i++) {
+        struct Ghost* ghost = house->ghosts[i];
+        printf("Ghost Type: %s\n", ghost_to_string(ghost->type));
+        printf("Ghost ID: %d\n", ghost->id);
+        printf("Ghost exited due to: %s%s\n", ghost_exit_to_string(ghost->exit_reason),
+               ghost->case_file.solved ? " (hunters solved its case)" : "");
+    }
+    printf("Threads joined %lld us after the outcome was decided\n", join_us);
+    printf("Events logged: %ld\n", log_event_count());
+    printf("Peak resident: %ld KiB\n", peak_resident_kib());
+
+    printf("\n--- Hunter Results ---\n");
+    int exit_counts[3] = {0};
+    for (int i = 0; i < house->hunter_count; i++) {
+        struct Hunter* h = house->hunters[i];
+        if (h->exit_reason >= LR_EVIDENCE && h->exit_reason <= LR_AFRAID) {
+            exit_counts[h->exit_reason]++;
+        }
+        if (config.quiet) continue;
+        printf("Hunter %d (%s):\n", h->id, h->name);
+        printf("  Exit reason: %s\n", exit_reason_to_string(h->exit_reason));
+        printf("  Final device: %s\n", evidence_to_string(h->device));
+        printf("  Final stats: boredom=%d, fear=%d\n", h->boredom, h->fear);
+    }
+    printf("Exit reasons: evidence=%d bored=%d afraid=%d\n",
+           exit_counts[LR_EVIDENCE], exit_counts[LR_BORED], exit_counts[LR_AFRAID]);
+
+    printf("\n--- Evidence Analysis ---\n");
+    printf("Device policy: %s\n",
+           house->config.device_policy == DEVICE_POLICY_INFORMED ? "informed" : "random");
+    printf("Exploration policy: %s\n",
+           house->config.explore_policy == EXPLORE_POLICY_FRONTIER ? "frontier" : "random");
+    // Hunter arrivals per room from the shared exploration map; the van is where everyone starts
+    int unvisited = 0;
+    int explorable = 0;
+    const struct Room* least = NULL;
+    const struct Room* most = NULL;
+    for (int i = 0; i < house->room_count; i++) {
+        const struct Room* room = &house->rooms[i];
+        if (room->is_exit) continue;
+        explorable++;
+        if (room->visits == 0) unvisited++;
+        if (!least || room->visits < least->visits) least = room;
+        if (!most || room->visits > most->visits) most = room;
+    }
+    if (least && most) {
+        printf("Room visits: least %u (%s), most %u (%s), %d of %d rooms never visited\n", least->visits,
+               least->name, most->visits, most->name, unvisited, explorable);
+    }
+    // The house counts as solved once the last open case closes
+    int solved_turn = -1;
+    for (int i = 0; i < house->ghost_count; i++) {
+        const struct CaseFile* case_file = &house->ghosts[i]->case_file;
+        if (!case_file->solved) {
+            solved_turn = -1;
+            break;
+        }
+        if (case_file->solved_turn > solved_turn) {
+            solved_turn = case_file->solved_turn;
+        }
+    }
+    if (solved_turn >= 0) {
+        printf("Turns to solve: %d\n", solved_turn);
+    } else {
+        printf("Turns to solve: unsolved\n");
+    }
+
+    for (int i = 0; i < house->ghost_count; i++) {
+        struct Ghost* ghost = house->ghosts[i];
+        EvidenceByte collected = ghost->case_file.collected;
+        if (house->ghost_count > 1) {
+            printf("\nCase file for ghost %d:\n", ghost->id);
+        }
+        printf("Collected evidence bits: 0x%02X\n", collected);
+        printf("Evidence matches known ghost: %s\n",
+               evidence_is_valid_ghost(collected) ? "YES" : "NO");
+
+        enum GhostType matched_ghost = evidence_identify_ghost(collected);
+        if (matched_ghost != 0) {
+            printf("Evidence identifies ghost as: %s\n", ghost_to_string(matched_ghost));
+            printf("Correct identification: %s\n",
+                   matched_ghost == ghost->type ? "YES" : "NO");
+        } else {
+            printf("Evidence is insufficient or inconsistent to identify a specific ghost.\n");
+            printf("Remaining candidates: %d\n", evidence_candidate_count(collected));
+        }
+    }
+    contention_report();
+    phase_timing_report("Turn Phase Latency");
+    perf_counters_report();
+    lifecycle_report();
+    phase_timing_stop();
+
+    // The branches ran alongside the rest of this run, so most are done by now
+    branches_collect(&branches);
+
+    // 8. Clean up all dynamically allocated resources
+    house_cleanup(house);
+    trace_free();
+    timeline_free();
+    lifecycle_free();
+
+    printf("\n=== Simulation Cleanup Complete ===\n");
+    return EXIT_SUCCESS;
 }
\ No newline at end of file
@@ -0,0 +1,311 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include "defs.h"
+#include "helpers.h"
+
+// Hardware performance counters per turn phase. Every thread that runs turns opens its
+// own perf_event_open group on first use and reads it at each phase boundary, the same
+// points the phase timer uses. Counters the kernel or the machine doesn't offer (virtual
+// machines often have no PMU, perf_event_paranoid can forbid all of them) are probed
+// once up front and left out, so the run goes ahead with whatever is there, or without
+// counters at all. Hardware and software counters go in separate groups: a group read
+// only brings a software sibling up to date at a context switch, so the task clock has to
+// lead its own group. A thread closes its groups when it exits, which keeps thread mode
+// within the fd limit as long as not too many entities run at the same time.
+
+enum PerfCounter {
+    PERF_CYCLES = 0,
+    PERF_INSTRUCTIONS,
+    PERF_CACHE_MISSES,
+    PERF_BRANCH_MISSES,
+    PERF_TASK_CLOCK,
+    PERF_CONTEXT_SWITCHES,
+    PERF_COUNTER_COUNT
+};
+
+enum PerfGroup {
+    PERF_GROUP_HARDWARE = 0,
+    PERF_GROUP_SOFTWARE = 1,
+    PERF_GROUP_COUNT
+};
+
+struct PerfCounterSpec {
+    const char* name;
+    uint32_t type;
+    uint64_t config;
+};
+
+static const struct PerfCounterSpec counter_specs[PERF_COUNTER_COUNT] = {
+    [PERF_CYCLES] = { "cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+    [PERF_INSTRUCTIONS] = { "instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+    [PERF_CACHE_MISSES] = { "cache misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+    [PERF_BRANCH_MISSES] = { "branch misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+    [PERF_TASK_CLOCK] = { "task clock", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK },
+    [PERF_CONTEXT_SWITCHES] = { "context switches", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES },
+};
+
+// Counters every thread opens, in the order a group read returns them
+struct GroupLayout {
+    int members[PERF_COUNTER_COUNT];
+    int count;
+};
+
+struct PhaseCounters {
+    unsigned long samples;
+    double totals[PERF_COUNTER_COUNT];
+};
+
+struct ThreadCounters {
+    struct ThreadCounters* next;
+    int fds[PERF_GROUP_COUNT][PERF_COUNTER_COUNT];  // members in layout order, [0] leads
+    int fd_count[PERF_GROUP_COUNT];
+    double turn_start[PERF_COUNTER_COUNT];
+    double last[PERF_COUNTER_COUNT];
+    unsigned long multiplexed;      // reads where the group didn't run all the time
+    struct PhaseCounters phases[PHASE_COUNT];
+};
+
+static bool counters_enabled = false;
+static struct GroupLayout layouts[PERF_GROUP_COUNT];
+static bool counter_available[PERF_COUNTER_COUNT];
+static bool exclude_kernel[PERF_COUNTER_COUNT];
+static struct ThreadCounters* all_counters = NULL;
+static pthread_mutex_t all_counters_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_key_t counters_key;
+static _Thread_local struct ThreadCounters* local_counters = NULL;
+static _Thread_local bool local_unavailable = false;
+static int threads_without_counters = 0;
+
+static int open_counter(enum PerfCounter counter, bool kernel_excluded, int group_fd) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = counter_specs[counter].type;
+    attr.config = counter_specs[counter].config;
+    attr.exclude_kernel = kernel_excluded;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, 0);
+}
+
+static void close_thread_counters(void* arg) {
+    struct ThreadCounters* counters = arg;
+    for (int g = 0; g < PERF_GROUP_COUNT; g++) {
+        for (int i = 0; i < counters->fd_count[g]; i++) {
+            close(counters->fds[g][i]);
+        }
+        counters->fd_count[g] = 0;
+    }
+}
+
+static struct ThreadCounters* thread_counters() {
+    if (local_counters || local_unavailable) return local_counters;
+    struct ThreadCounters* counters = calloc(1, sizeof(struct ThreadCounters));
+    if (!counters) {
+        local_unavailable = true;
+        __atomic_add_fetch(&threads_without_counters, 1, __ATOMIC_RELAXED);
+        return NULL;
+    }
+    for (int g = 0; g < PERF_GROUP_COUNT; g++) {
+        const struct GroupLayout* layout = &layouts[g];
+        for (int i = 0; i < layout->count; i++) {
+            int counter = layout->members[i];
+            int group_fd = i == 0 ? -1 : counters->fds[g][0];
+            int fd = open_counter(counter, exclude_kernel[counter], group_fd);
+            if (fd < 0) {
+                close_thread_counters(counters);
+                free(counters);
+                local_unavailable = true;
+                __atomic_add_fetch(&threads_without_counters, 1, __ATOMIC_RELAXED);
+                return NULL;
+            }
+            counters->fds[g][counters->fd_count[g]++] = fd;
+        }
+    }
+    pthread_setspecific(counters_key, counters);
+    pthread_mutex_lock(&all_counters_lock);
+    counters->next = all_counters;
+    all_counters = counters;
+    pthread_mutex_unlock(&all_counters_lock);
+    local_counters = counters;
+    return counters;
+}
+
+// Reads both groups into values, scaled up when the kernel had to multiplex one
+static bool read_counters(struct ThreadCounters* counters, double* values) {
+    for (int g = 0; g < PERF_GROUP_COUNT; g++) {
+        int count = counters->fd_count[g];
+        if (count == 0) continue;
+        uint64_t buffer[3 + PERF_COUNTER_COUNT];
+        ssize_t expected = (ssize_t)((3 + count) * sizeof(uint64_t));
+        if (read(counters->fds[g][0], buffer, sizeof(buffer)) != expected) return false;
+        uint64_t enabled = buffer[1];
+        uint64_t running = buffer[2];
+        double scale = 1.0;
+        if (running > 0 && running < enabled) {
+            scale = (double)enabled / running;
+            counters->multiplexed++;
+        }
+        for (int i = 0; i < count; i++) {
+            values[layouts[g].members[i]] = buffer[3 + i] * scale;
+        }
+    }
+    return true;
+}
+
+// Has to run before the entity threads start. Returns false when no counter can be
+// opened, which only turns the counters off; the run itself goes ahead.
+bool perf_counters_start() {
+    int available = 0;
+    for (int c = 0; c < PERF_COUNTER_COUNT; c++) {
+        // Software events count in the kernel, where context switches happen; fall back
+        // to user space only when the kernel part isn't allowed
+        bool software = counter_specs[c].type == PERF_TYPE_SOFTWARE;
+        int fd = software ? open_counter(c, false, -1) : -1;
+        bool kernel_excluded = fd < 0;
+        if (fd < 0) fd = open_counter(c, true, -1);
+        if (fd < 0) continue;
+        close(fd);
+        exclude_kernel[c] = kernel_excluded;
+        counter_available[c] = true;
+        struct GroupLayout* layout = &layouts[software ? PERF_GROUP_SOFTWARE : PERF_GROUP_HARDWARE];
+        layout->members[layout->count++] = c;
+        available++;
+    }
+    if (available == 0) {
+        fprintf(stderr, "Performance counters are unavailable (%s); running without them\n", strerror(errno));
+        return false;
+    }
+    if (pthread_key_create(&counters_key, close_thread_counters) != 0) {
+        fprintf(stderr, "Failed to set up per-thread performance counters; running without them\n");
+        return false;
+    }
+    if (available < PERF_COUNTER_COUNT) {
+        fprintf(stderr, "Performance counters not offered here:");
+        const char* separator = " ";
+        for (int c = 0; c < PERF_COUNTER_COUNT; c++) {
+            if (counter_available[c]) continue;
+            fprintf(stderr, "%s%s", separator, counter_specs[c].name);
+            separator = ", ";
+        }
+        fprintf(stderr, "\n");
+    }
+    phase_timing_read_counters();
+    counters_enabled = true;
+    return true;
+}
+
+// Called from phase_clock at the start of every turn
+void perf_counters_turn_begin() {
+    if (!counters_enabled) return;
+    struct ThreadCounters* counters = thread_counters();
+    if (!counters || !read_counters(counters, counters->turn_start)) return;
+    memcpy(counters->last, counters->turn_start, sizeof(counters->last));
+}
+
+// Called from phase_end; whole turns count from the start of the turn, every other
+// phase from the end of the one before it
+void perf_counters_phase_end(enum TurnPhase phase) {
+    struct ThreadCounters* counters = local_counters;
+    if (!counters_enabled || !counters) return;
+    double now[PERF_COUNTER_COUNT];
+    if (!read_counters(counters, now)) return;
+    bool whole_turn = phase == PHASE_HUNTER_TURN || phase == PHASE_GHOST_TURN;
+    const double* began = whole_turn ? counters->turn_start : counters->last;
+    struct PhaseCounters* totals = &counters->phases[phase];
+    totals->samples++;
+    for (int c = 0; c < PERF_COUNTER_COUNT; c++) {
+        if (counter_available[c]) totals->totals[c] += now[c] - began[c];
+    }
+    if (!whole_turn) memcpy(counters->last, now, sizeof(counters->last));
+}
+
+static void print_per_sample(double total, unsigned long samples, enum PerfCounter counter) {
+    if (counter_available[counter]) {
+        printf(" %11.2f", total / samples);
+    } else {
+        printf(" %11s", "-");
+    }
+}
+
+// Only once every entity has stopped; the counts are read without synchronisation
+void perf_counters_report() {
+    if (!counters_enabled) return;
+    struct PhaseCounters merged[PHASE_COUNT];
+    memset(merged, 0, sizeof(merged));
+    int threads = 0;
+    unsigned long multiplexed = 0;
+    pthread_mutex_lock(&all_counters_lock);
+    for (const struct ThreadCounters* counters = all_counters; counters; counters = counters->next) {
+        threads++;
+        multiplexed += counters->multiplexed;
+        for (int p = 0; p < PHASE_COUNT; p++) {
+            merged[p].samples += counters->phases[p].samples;
+            for (int c = 0; c < PERF_COUNTER_COUNT; c++) {
+                merged[p].totals[c] += counters->phases[p].totals[c];
+            }
+        }
+    }
+    pthread_mutex_unlock(&all_counters_lock);
+
+    bool have_ipc = counter_available[PERF_CYCLES] && counter_available[PERF_INSTRUCTIONS];
+    printf("\n--- Performance Counters (per sample) ---\n");
+    printf("%-26s %10s %11s %11s %6s %11s %11s %11s %11s\n", "phase", "samples", "cycles", "instructions",
+           "IPC", "cache miss", "branch miss", "ctx switch", "task us");
+    for (int p = 0; p < PHASE_COUNT; p++) {
+        const struct PhaseCounters* phase = &merged[p];
+        if (phase->samples == 0) continue;
+        bool nested = p != PHASE_HUNTER_TURN && p != PHASE_GHOST_TURN;
+        printf("%s%-*s %10lu", nested ? "  " : "", nested ? 24 : 26, phase_name(p), phase->samples);
+        print_per_sample(phase->totals[PERF_CYCLES], phase->samples, PERF_CYCLES);
+        print_per_sample(phase->totals[PERF_INSTRUCTIONS], phase->samples, PERF_INSTRUCTIONS);
+        if (have_ipc && phase->totals[PERF_CYCLES] > 0) {
+            printf(" %6.2f", phase->totals[PERF_INSTRUCTIONS] / phase->totals[PERF_CYCLES]);
+        } else {
+            printf(" %6s", "-");
+        }
+        print_per_sample(phase->totals[PERF_CACHE_MISSES], phase->samples, PERF_CACHE_MISSES);
+        print_per_sample(phase->totals[PERF_BRANCH_MISSES], phase->samples, PERF_BRANCH_MISSES);
+        print_per_sample(phase->totals[PERF_CONTEXT_SWITCHES], phase->samples, PERF_CONTEXT_SWITCHES);
+        print_per_sample(phase->totals[PERF_TASK_CLOCK] / 1e3, phase->samples, PERF_TASK_CLOCK);
+        printf("\n");
+    }
+
+    // Whole turns cover every phase, so they give the per-event figures
+    double turns[PERF_COUNTER_COUNT] = {0};
+    for (int c = 0; c < PERF_COUNTER_COUNT; c++) {
+        turns[c] = merged[PHASE_HUNTER_TURN].totals[c] + merged[PHASE_GHOST_TURN].totals[c];
+    }
+    long events = log_event_count();
+    if (events > 0) {
+        printf("Per logged event (%ld):", events);
+        const char* separator = " ";
+        for (int c = 0; c < PERF_COUNTER_COUNT; c++) {
+            if (!counter_available[c] || c == PERF_CYCLES) continue;
+            double per_event = turns[c] / events;
+            if (c == PERF_TASK_CLOCK) {
+                printf("%s%.1f task us", separator, per_event / 1e3);
+            } else {
+                printf("%s%.*f %s", separator, per_event < 10 ? 3 : 0, per_event, counter_specs[c].name);
+            }
+            separator = ", ";
+        }
+        printf("\n");
+    }
+    if (have_ipc && turns[PERF_CYCLES] > 0) {
+        printf("Overall IPC: %.2f\n", turns[PERF_INSTRUCTIONS] / turns[PERF_CYCLES]);
+    }
+    printf("Threads counted: %d", threads);
+    int without = __atomic_load_n(&threads_without_counters, __ATOMIC_RELAXED);
+    if (without > 0) printf(", %d without counters (out of file descriptors?)", without);
+    if (multiplexed > 0) printf(", %lu multiplexed reads scaled up", multiplexed);
+    printf("\n");
+}
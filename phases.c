@@ -0,0 +1,233 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <signal.h>
+#include <time.h>
+#include "defs.h"
+#include "helpers.h"
+
+// Turn phase timing. Each thread records into its own log-linear histograms, one per
+// phase it runs: values below PHASE_SUB_BUCKETS ns are exact, above that every power of
+// two is split into PHASE_SUB_BUCKETS buckets, so a bucket is within 1/8 of its values.
+// Counters have a single writer and are read with relaxed atomics for mid-run dumps.
+
+#define PHASE_SUB_BITS 3
+#define PHASE_SUB_BUCKETS (1 << PHASE_SUB_BITS)
+#define PHASE_MAX_BIT 35                // ~34 s; longer samples land in the last bucket
+#define PHASE_BUCKETS ((PHASE_MAX_BIT - PHASE_SUB_BITS + 2) * PHASE_SUB_BUCKETS)
+
+struct PhaseHistogram {
+    unsigned counts[PHASE_BUCKETS];
+    unsigned long total;
+    long long sum_ns;
+    long long max_ns;
+};
+
+struct ThreadPhases {
+    struct ThreadPhases* next;
+    struct PhaseHistogram* phases[PHASE_COUNT];     // allocated on the first sample
+};
+
+static const char* phase_names[PHASE_COUNT] = {
+    [PHASE_HUNTER_TURN] = "hunter turn",
+    [PHASE_HUNTER_UPDATE_STATS] = "  update_stats",
+    [PHASE_HUNTER_EXIT_CHECK] = "  check_exit_conditions",
+    [PHASE_HUNTER_VAN_CHECK] = "  van_check",
+    [PHASE_HUNTER_GATHER] = "  gather_evidence",
+    [PHASE_HUNTER_MOVE] = "  move",
+    [PHASE_GHOST_TURN] = "ghost turn",
+    [PHASE_GHOST_UPDATE_STATS] = "  update_stats",
+    [PHASE_GHOST_EXIT_CHECK] = "  check_exit_condition",
+    [PHASE_GHOST_ACTION] = "  take_action",
+};
+
+static bool phases_enabled = false;     // the clock runs, for histograms or the timeline
+static bool phase_histograms = false;
+static bool phase_spans = false;
+static bool phase_counters = false;
+static struct ThreadPhases* all_phases = NULL;
+static pthread_mutex_t all_phases_lock = PTHREAD_MUTEX_INITIALIZER;
+static _Thread_local struct ThreadPhases* local_phases = NULL;
+static pthread_t dump_thread;
+static bool dump_thread_started = false;
+static bool dump_thread_stopping = false;
+
+static int bucket_of(long long ns) {
+    if (ns < PHASE_SUB_BUCKETS) return ns > 0 ? (int)ns : 0;
+    int top = 63 - __builtin_clzll((unsigned long long)ns);
+    if (top > PHASE_MAX_BIT) return PHASE_BUCKETS - 1;
+    int shift = top - PHASE_SUB_BITS;
+    int sub = (int)((ns >> shift) & (PHASE_SUB_BUCKETS - 1));
+    return (shift + 1) * PHASE_SUB_BUCKETS + sub;
+}
+
+// Largest value a bucket holds, so percentiles never read low
+static long long bucket_ceiling(int bucket) {
+    if (bucket < PHASE_SUB_BUCKETS) return bucket;
+    int shift = bucket / PHASE_SUB_BUCKETS - 1;
+    long long low = (long long)(PHASE_SUB_BUCKETS + bucket % PHASE_SUB_BUCKETS) << shift;
+    return low + (1LL << shift) - 1;
+}
+
+static struct PhaseHistogram* histogram_for(enum TurnPhase phase) {
+    if (!local_phases) {
+        local_phases = calloc(1, sizeof(struct ThreadPhases));
+        if (!local_phases) return NULL;
+        pthread_mutex_lock(&all_phases_lock);
+        local_phases->next = all_phases;
+        all_phases = local_phases;
+        pthread_mutex_unlock(&all_phases_lock);
+    }
+    struct PhaseHistogram* histogram = local_phases->phases[phase];
+    if (!histogram) {
+        histogram = calloc(1, sizeof(struct PhaseHistogram));
+        if (!histogram) return NULL;
+        __atomic_store_n(&local_phases->phases[phase], histogram, __ATOMIC_RELEASE);
+    }
+    return histogram;
+}
+
+// Without the leading indentation the report uses to nest phases under their turn
+const char* phase_name(enum TurnPhase phase) {
+    const char* name = phase_names[phase];
+    return name + strspn(name, " ");
+}
+
+static long long monotonic_ns() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long long)now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+// Called once at the start of every turn
+long long phase_clock() {
+    if (!phases_enabled) return 0;
+    if (phase_counters) perf_counters_turn_begin();
+    return monotonic_ns();
+}
+
+// Records the phase that began at began and returns the time it ended, which is when
+// the next phase begins; does nothing and returns 0 when timing is off
+long long phase_end(enum TurnPhase phase, long long began) {
+    if (!phases_enabled || began == 0) return 0;
+    long long now = monotonic_ns();
+    if (phase_counters) perf_counters_phase_end(phase);
+    if (phase_spans) timeline_span(phase, began, now);
+    if (!phase_histograms) return now;
+    long long ns = now - began;
+    struct PhaseHistogram* histogram = histogram_for(phase);
+    if (!histogram) return now;
+    int bucket = bucket_of(ns);
+    __atomic_store_n(&histogram->counts[bucket], histogram->counts[bucket] + 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&histogram->total, histogram->total + 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&histogram->sum_ns, histogram->sum_ns + ns, __ATOMIC_RELAXED);
+    if (ns > histogram->max_ns) __atomic_store_n(&histogram->max_ns, ns, __ATOMIC_RELAXED);
+    return now;
+}
+
+static long long percentile(const struct PhaseHistogram* merged, double rank) {
+    unsigned long target = (unsigned long)(rank * merged->total);
+    if (target >= merged->total) target = merged->total - 1;
+    unsigned long seen = 0;
+    for (int b = 0; b < PHASE_BUCKETS; b++) {
+        seen += merged->counts[b];
+        if (seen > target) {
+            long long ceiling = bucket_ceiling(b);
+            return ceiling < merged->max_ns ? ceiling : merged->max_ns;
+        }
+    }
+    return merged->max_ns;
+}
+
+// Merges every thread's histograms and prints one line per phase that ran
+void phase_timing_report(const char* title) {
+    if (!phase_histograms) return;
+    struct PhaseHistogram* merged = calloc(PHASE_COUNT, sizeof(struct PhaseHistogram));
+    if (!merged) return;
+    pthread_mutex_lock(&all_phases_lock);
+    for (struct ThreadPhases* thread = all_phases; thread; thread = thread->next) {
+        for (int p = 0; p < PHASE_COUNT; p++) {
+            const struct PhaseHistogram* histogram = __atomic_load_n(&thread->phases[p], __ATOMIC_ACQUIRE);
+            if (!histogram) continue;
+            for (int b = 0; b < PHASE_BUCKETS; b++) {
+                merged[p].counts[b] += __atomic_load_n(&histogram->counts[b], __ATOMIC_RELAXED);
+            }
+            merged[p].total += __atomic_load_n(&histogram->total, __ATOMIC_RELAXED);
+            merged[p].sum_ns += __atomic_load_n(&histogram->sum_ns, __ATOMIC_RELAXED);
+            long long max_ns = __atomic_load_n(&histogram->max_ns, __ATOMIC_RELAXED);
+            if (max_ns > merged[p].max_ns) merged[p].max_ns = max_ns;
+        }
+    }
+    pthread_mutex_unlock(&all_phases_lock);
+
+    printf("\n--- %s ---\n", title);
+    printf("%-26s %10s %9s %9s %9s %9s %9s\n", "phase (us)", "samples", "mean", "p50", "p99", "p99.9", "max");
+    for (int p = 0; p < PHASE_COUNT; p++) {
+        const struct PhaseHistogram* histogram = &merged[p];
+        // A mid-run snapshot can count a sample before its bucket; the buckets decide
+        unsigned long bucketed = 0;
+        for (int b = 0; b < PHASE_BUCKETS; b++) {
+            bucketed += histogram->counts[b];
+        }
+        merged[p].total = bucketed;
+        if (bucketed == 0) continue;
+        printf("%-26s %10lu %9.1f %9.1f %9.1f %9.1f %9.1f\n", phase_names[p], bucketed,
+               histogram->sum_ns / 1e3 / bucketed, percentile(histogram, 0.50) / 1e3,
+               percentile(histogram, 0.99) / 1e3, percentile(histogram, 0.999) / 1e3,
+               histogram->max_ns / 1e3);
+    }
+    fflush(stdout);
+    free(merged);
+}
+
+static void* phase_dump_thread(void* arg) {
+    sigset_t* signals = arg;
+    while (true) {
+        int signal_number = 0;
+        if (sigwait(signals, &signal_number) != 0) continue;
+        if (__atomic_load_n(&dump_thread_stopping, __ATOMIC_ACQUIRE)) break;
+        phase_timing_report("Turn Phase Latency (SIGUSR1)");
+    }
+    return NULL;
+}
+
+// Has to run before any other thread exists: SIGUSR1 is blocked here and every thread
+// created afterwards inherits that, so only the dump thread ever takes it
+bool phase_timing_start() {
+    static sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGUSR1);
+    if (pthread_sigmask(SIG_BLOCK, &signals, NULL) != 0) {
+        fprintf(stderr, "Failed to block SIGUSR1 for phase timing\n");
+        return false;
+    }
+    phase_histograms = true;
+    phases_enabled = true;
+    if (pthread_create(&dump_thread, NULL, phase_dump_thread, &signals) != 0) {
+        fprintf(stderr, "Failed to start the phase timing thread; SIGUSR1 dumps are off\n");
+        return true;
+    }
+    dump_thread_started = true;
+    return true;
+}
+
+// Has to run before the entity threads start, like phase_timing_start
+void phase_timing_emit_spans() {
+    phase_spans = true;
+    phases_enabled = true;
+}
+
+// Has to run before the entity threads start, like phase_timing_start
+void phase_timing_read_counters() {
+    phase_counters = true;
+    phases_enabled = true;
+}
+
+void phase_timing_stop() {
+    if (!dump_thread_started) return;
+    __atomic_store_n(&dump_thread_stopping, true, __ATOMIC_RELEASE);
+    pthread_kill(dump_thread, SIGUSR1);
+    pthread_join(dump_thread, NULL);
+    dump_thread_started = false;
+}
@@ -1,160 +1,453 @@
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-#include <pthread.h>
-#include "defs.h"
-#include "helpers.h"
-
-void room_init(struct Room* room, const char* name, bool is_exit) {
-    if (!room) return;
-    strncpy(room->name, name, MAX_ROOM_NAME - 1);
-    room->name[MAX_ROOM_NAME - 1] = '\0';
-    room->connection_count = 0;
-    room->hunter_count = 0;
-    room->ghost = NULL;
-    room->evidence = 0;
-    room->is_exit = is_exit;
-    if (sem_init(&room->sem, 0, 1) != 0) {
-        fprintf(stderr, "Failed to initialize room semaphore\n");
-    }
-}
-
-void rooms_connect(struct Room* a, struct Room* b) {
-    if (!a || !b) return;
-    if (a->connection_count >= MAX_CONNECTIONS) {
-        fprintf(stderr, "WARNING: Room '%s' connections exceed MAX_CONNECTIONS (%d)\n", a->name, MAX_CONNECTIONS);
-        return;
-    }
-    if (b->connection_count >= MAX_CONNECTIONS) {
-        fprintf(stderr, "WARNING: Room '%s' connections exceed MAX_CONNECTIONS (%d)\n", b->name, MAX_CONNECTIONS);
-        return;
-    }
-    a->connections[a->connection_count++] = b;
-    b->connections[b->connection_count++] = a;
-}
-
-bool room_add_hunter(struct Room* room, struct Hunter* hunter) {
-    if (!room || !hunter) return false;
-    sem_wait(&room->sem);
-    if (room->hunter_count >= MAX_ROOM_OCCUPANCY) {
-        sem_post(&room->sem);
-        return false;
-    }
-    room->hunters[room->hunter_count++] = hunter;
-    hunter->current_room = room;
-    sem_post(&room->sem);
-    return true;
-}
-
-void room_remove_hunter(struct Room* room, struct Hunter* hunter) {
-    if (!room || !hunter) return;
-    sem_wait(&room->sem);
-    for (int i = 0; i < room->hunter_count; i++) {
-        if (room->hunters[i] == hunter) {
-            for (int j = i; j < room->hunter_count - 1; j++) {
-                room->hunters[j] = room->hunters[j + 1];
-            }
-            room->hunter_count--;
-            break;
-        }
-    }
-    hunter->current_room = NULL;
-    sem_post(&room->sem);
-}
-
-void room_set_ghost(struct Room* room, struct Ghost* ghost) {
-    if (!room) return;
-    sem_wait(&room->sem);
-    room->ghost = ghost;
-    if (ghost) {
-        ghost->current_room = room;
-    }
-    sem_post(&room->sem);
-}
-
-void room_remove_ghost(struct Room* room) {
-    if (!room) return;
-    sem_wait(&room->sem);
-    if (room->ghost) {
-        room->ghost->current_room = NULL;
-    }
-    room->ghost = NULL;
-    sem_post(&room->sem);
-}
-
-void room_add_evidence(struct Room* room, enum EvidenceType evidence) {
-    if (!room) return;
-    sem_wait(&room->sem);
-    room->evidence |= evidence;
-    sem_post(&room->sem);
-}
-
-bool room_remove_evidence(struct Room* room, enum EvidenceType evidence) {
-    if (!room) return false;
-    sem_wait(&room->sem);
-    bool had_evidence = (room->evidence & evidence) != 0;
-    if (had_evidence) {
-        room->evidence &= ~evidence;
-    }
-    sem_post(&room->sem);
-    return had_evidence;
-}
-
-bool room_has_evidence(struct Room* room, enum EvidenceType evidence) {
-    if (!room) return false;
-    sem_wait(&room->sem);
-    bool result = (room->evidence & evidence) != 0;
-    sem_post(&room->sem);
-    return result;
-}
-
-// To avoid re-locking in room_move_entity, we can inline logic instead of calling the above functions.
-bool room_move_entity(struct Room* from, struct Room* to, void* entity) {
-    if (!from || !to || !entity) return false;
-    struct Room* first = (from < to) ? from : to;
-    struct Room* second = (from < to) ? to : from;
-    sem_wait(&first->sem);
-    sem_wait(&second->sem);
-    bool can_move = true;
-    if (entity != from->ghost) {
-        if (to->hunter_count >= MAX_ROOM_OCCUPANCY) {
-            can_move = false;
-        }
-    }
-    if (can_move) {
-        if (entity == from->ghost) {
-            from->ghost = NULL;
-            to->ghost = entity;
-            ((struct Ghost*)entity)->current_room = to;
-        } else {
-            // Inline remove/add, not re-locking
-            // Remove from 'from'
-            for (int i = 0; i < from->hunter_count; i++) {
-                if (from->hunters[i] == entity) {
-                    for (int j = i; j < from->hunter_count - 1; j++) {
-                        from->hunters[j] = from->hunters[j + 1];
-                    }
-                    from->hunter_count--;
-                    break;
-                }
-            }
-            // Add to 'to'
-            to->hunters[to->hunter_count++] = (struct Hunter*)entity;
-            ((struct Hunter*)entity)->current_room = to;
-        }
-    }
-    sem_post(&second->sem);
-    sem_post(&first->sem);
-    return can_move;
-}
-
-struct Room* room_get_random_connection(struct Room* room) {
-    if (!room || room->connection_count == 0) return NULL;
-    int index = rand_int_threadsafe(0, room->connection_count);
-    return room->connections[index];
-}
-
-void room_cleanup(struct Room* room) {
-    if (!room) return;
-    sem_destroy(&room->sem);
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+#include "defs.h"
+#include "helpers.h"
+
+// Rooms owned by an actor worker are only ever touched by that worker, so they skip sem
+static void room_lock(struct Room* room) {
+    if (!room->owner) contention_wait(&room->sem, contention_room_slot(room));
+}
+
+static void room_unlock(struct Room* room) {
+    if (!room->owner) contention_post(&room->sem, contention_room_slot(room));
+}
+
+// Publishes the room's new state while it is still held, then releases it
+static void room_unlock_changed(struct Room* room) {
+    telemetry_room(room);
+    room_unlock(room);
+}
+
+void room_init(struct Room* room, const char* name, bool is_exit) {
+    if (!room) return;
+    strncpy(room->name, name, MAX_ROOM_NAME - 1);
+    room->name[MAX_ROOM_NAME - 1] = '\0';
+    room->connection_count = 0;
+    room->hunter_count = 0;
+    room->hunter_capacity = 0;
+    room->hunters = NULL;
+    room->ghost_count = 0;
+    room->evidence = NULL;
+    room->evidence_slots = 0;
+    room->evidence_any = 0;
+    room->is_exit = is_exit;
+    room->visits = 0;
+    room->last_visit = 0;
+    room->sighted = 0;
+    for (int i = 0; i < ROOM_EVENT_KINDS; i++) {
+        room->event_counts[i] = 0;
+    }
+    room->waiters = 0;
+    room->owner = NULL;
+    room->occupancy = 0;
+    if (sem_init(&room->sem, 0, 1) != 0) {
+        fprintf(stderr, "Failed to initialize room semaphore\n");
+    }
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    if (pthread_mutex_init(&room->wait_lock, NULL) != 0 ||
+        pthread_cond_init(&room->changed, &attr) != 0) {
+        fprintf(stderr, "Failed to initialize room wait condition\n");
+    }
+    pthread_condattr_destroy(&attr);
+    room_set_capacity(room, MAX_ROOM_OCCUPANCY);
+    room_set_evidence_slots(room, 1);
+}
+
+// The child of a fork() has only the forking thread, so anyone the parent had waiting
+// on this room is gone. Turns were paused, so nobody held the room itself.
+void room_reset_after_fork(struct Room* room) {
+    if (!room) return;
+    room->waiters = 0;
+    sem_destroy(&room->sem);
+    if (sem_init(&room->sem, 0, 1) != 0) {
+        fprintf(stderr, "Failed to initialize room semaphore\n");
+    }
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    if (pthread_mutex_init(&room->wait_lock, NULL) != 0 ||
+        pthread_cond_init(&room->changed, &attr) != 0) {
+        fprintf(stderr, "Failed to initialize room wait condition\n");
+    }
+    pthread_condattr_destroy(&attr);
+}
+
+void rooms_connect(struct Room* a, struct Room* b) {
+    if (!a || !b) return;
+    if (a->connection_count >= MAX_CONNECTIONS) {
+        fprintf(stderr, "WARNING: Room '%s' connections exceed MAX_CONNECTIONS (%d)\n", a->name, MAX_CONNECTIONS);
+        return;
+    }
+    if (b->connection_count >= MAX_CONNECTIONS) {
+        fprintf(stderr, "WARNING: Room '%s' connections exceed MAX_CONNECTIONS (%d)\n", b->name, MAX_CONNECTIONS);
+        return;
+    }
+    a->connections[a->connection_count++] = b;
+    b->connections[b->connection_count++] = a;
+}
+
+// Capacity can shrink only down to the current occupancy
+bool room_set_capacity(struct Room* room, int capacity) {
+    if (!room || capacity < 1) return false;
+    room_lock(room);
+    if (capacity < room->hunter_count) {
+        room_unlock(room);
+        return false;
+    }
+    struct Hunter** hunters = realloc(room->hunters, sizeof(struct Hunter*) * capacity);
+    if (!hunters) {
+        room_unlock(room);
+        return false;
+    }
+    room->hunters = hunters;
+    room->hunter_capacity = capacity;
+    room_unlock(room);
+    return true;
+}
+
+// One evidence mask per ghost, so hunters know whose case a reading belongs to
+bool room_set_evidence_slots(struct Room* room, int slots) {
+    if (!room || slots < 1) return false;
+    room_lock(room);
+    EvidenceByte* evidence = realloc(room->evidence, sizeof(EvidenceByte) * slots);
+    if (!evidence) {
+        room_unlock(room);
+        return false;
+    }
+    for (int i = room->evidence_slots; i < slots; i++) {
+        evidence[i] = 0;
+    }
+    room->evidence = evidence;
+    room->evidence_slots = slots;
+    room_unlock(room);
+    return true;
+}
+
+// Unlocked helpers shared by the locking entry points and room_move_entity.
+// Order inside hunters[] doesn't matter, so removal swaps in the last hunter.
+static void room_insert_hunter(struct Room* room, struct Hunter* hunter) {
+    hunter->room_slot = room->hunter_count;
+    room->hunters[room->hunter_count++] = hunter;
+    hunter->current_room = room;
+}
+
+static void room_detach_hunter(struct Room* room, struct Hunter* hunter) {
+    int slot = hunter->room_slot;
+    if (slot < 0 || slot >= room->hunter_count || room->hunters[slot] != hunter) return;
+    struct Hunter* last = room->hunters[--room->hunter_count];
+    room->hunters[slot] = last;
+    last->room_slot = slot;
+    hunter->room_slot = -1;
+}
+
+bool room_add_hunter(struct Room* room, struct Hunter* hunter) {
+    if (!room || !hunter) return false;
+    room_lock(room);
+    if (room->hunter_count >= room->hunter_capacity) {
+        room_unlock(room);
+        return false;
+    }
+    room_insert_hunter(room, hunter);
+    room_unlock_changed(room);
+    room_notify(room, ROOM_EVENT_HUNTER);
+    return true;
+}
+
+void room_remove_hunter(struct Room* room, struct Hunter* hunter) {
+    if (!room || !hunter) return;
+    room_lock(room);
+    room_detach_hunter(room, hunter);
+    hunter->current_room = NULL;
+    if (room->owner) {
+        __atomic_sub_fetch(&room->occupancy, 1, __ATOMIC_RELAXED);
+    }
+    room_unlock_changed(room);
+    room_notify(room, ROOM_EVENT_HUNTER);
+}
+
+void room_add_ghost(struct Room* room, struct Ghost* ghost) {
+    if (!room) return;
+    room_lock(room);
+    room->ghost_count++;
+    if (ghost) {
+        ghost->current_room = room;
+    }
+    room_unlock_changed(room);
+    room_notify(room, ROOM_EVENT_GHOST);
+}
+
+void room_remove_ghost(struct Room* room, struct Ghost* ghost) {
+    if (!room) return;
+    room_lock(room);
+    if (room->ghost_count > 0) {
+        room->ghost_count--;
+    }
+    if (ghost) {
+        ghost->current_room = NULL;
+    }
+    room_unlock_changed(room);
+    room_notify(room, ROOM_EVENT_GHOST);
+}
+
+void room_add_evidence(struct Room* room, int ghost_index, enum EvidenceType evidence) {
+    if (!room || ghost_index < 0 || ghost_index >= room->evidence_slots) return;
+    room_lock(room);
+    if (!(room->evidence[ghost_index] & evidence)) {
+        lifecycle_dropped(room, ghost_index, evidence);
+    }
+    room->evidence[ghost_index] |= evidence;
+    room->evidence_any |= evidence;
+    room_unlock_changed(room);
+    room_notify(room, ROOM_EVENT_EVIDENCE);
+}
+
+bool room_remove_evidence(struct Room* room, int ghost_index, enum EvidenceType evidence) {
+    if (!room || ghost_index < 0 || ghost_index >= room->evidence_slots) return false;
+    room_lock(room);
+    bool had_evidence = (room->evidence[ghost_index] & evidence) != 0;
+    if (had_evidence) {
+        room->evidence[ghost_index] &= ~evidence;
+        EvidenceByte any = 0;
+        for (int i = 0; i < room->evidence_slots; i++) {
+            any |= room->evidence[i];
+        }
+        room->evidence_any = any;
+        lifecycle_collected(room, ghost_index, evidence);
+    }
+    room_unlock_changed(room);
+    return had_evidence;
+}
+
+bool room_has_evidence(struct Room* room, enum EvidenceType evidence) {
+    if (!room) return false;
+    room_lock(room);
+    bool result = (room->evidence_any & evidence) != 0;
+    room_unlock(room);
+    return result;
+}
+
+EvidenceByte room_get_evidence(struct Room* room) {
+    if (!room) return 0;
+    room_lock(room);
+    EvidenceByte evidence = room->evidence_any;
+    room_unlock(room);
+    return evidence;
+}
+
+// The exploration map is advisory, so it is updated with relaxed atomics instead of taking sem
+void room_record_visit(struct Room* room, unsigned clock) {
+    if (!room) return;
+    __atomic_add_fetch(&room->visits, 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&room->last_visit, clock, __ATOMIC_RELAXED);
+}
+
+void room_record_sighting(struct Room* room, EvidenceByte seen) {
+    if (!room || !seen) return;
+    __atomic_or_fetch(&room->sighted, seen, __ATOMIC_RELAXED);
+}
+
+void room_clear_sighting(struct Room* room, enum EvidenceType evidence) {
+    if (!room) return;
+    __atomic_and_fetch(&room->sighted, (EvidenceByte)~evidence, __ATOMIC_RELAXED);
+}
+
+// Actor mode move. Other workers may be filling the destination at the same time, so a
+// hunter first reserves a place there atomically. A move into another partition leaves
+// the entity between rooms: the caller hands it to the owning worker, which finishes
+// the arrival with room_accept_entity().
+static bool room_move_owned_entity(struct Room* from, struct Room* to, struct Entity* entity) {
+    bool same_owner = from->owner == to->owner;
+    if (entity->kind == ENTITY_GHOST) {
+        struct Ghost* ghost = (struct Ghost*)entity;
+        from->ghost_count--;
+        if (same_owner) {
+            to->ghost_count++;
+        }
+        ghost->current_room = to;
+        telemetry_room(from);
+        if (same_owner) telemetry_room(to);
+        return true;
+    }
+    struct Hunter* hunter = (struct Hunter*)entity;
+    int occupied = __atomic_load_n(&to->occupancy, __ATOMIC_RELAXED);
+    do {
+        if (occupied >= to->hunter_capacity) return trace_move(false);
+    } while (!__atomic_compare_exchange_n(&to->occupancy, &occupied, occupied + 1, true,
+                                          __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+    trace_move(true);
+    __atomic_sub_fetch(&from->occupancy, 1, __ATOMIC_RELAXED);
+    room_detach_hunter(from, hunter);
+    if (same_owner) {
+        room_insert_hunter(to, hunter);
+    } else {
+        hunter->current_room = to;
+    }
+    telemetry_room(from);
+    if (same_owner) telemetry_room(to);
+    return true;
+}
+
+// Completes a hand-over from another partition; the place was reserved by the move
+void room_accept_entity(struct Room* room, struct Entity* entity) {
+    if (!room || !entity) return;
+    if (entity->kind == ENTITY_GHOST) {
+        room->ghost_count++;
+    } else {
+        room_insert_hunter(room, (struct Hunter*)entity);
+    }
+    telemetry_room(room);
+}
+
+// To avoid re-locking in room_move_entity, we can inline logic instead of calling the above functions.
+bool room_move_entity(struct Room* from, struct Room* to, void* entity) {
+    if (!from || !to || !entity) return false;
+    if (from->owner) {
+        return room_move_owned_entity(from, to, (struct Entity*)entity);
+    }
+    struct Room* first = (from < to) ? from : to;
+    struct Room* second = (from < to) ? to : from;
+    contention_wait(&first->sem, contention_room_slot(first));
+    contention_wait(&second->sem, contention_room_slot(second));
+    bool can_move = true;
+    bool is_ghost = ((struct Entity*)entity)->kind == ENTITY_GHOST;
+    unsigned events = is_ghost ? ROOM_EVENT_GHOST : ROOM_EVENT_HUNTER;
+    if (!is_ghost) {
+        can_move = trace_move(to->hunter_count < to->hunter_capacity);
+    }
+    if (can_move) {
+        if (is_ghost) {
+            from->ghost_count--;
+            to->ghost_count++;
+            ((struct Ghost*)entity)->current_room = to;
+        } else {
+            // Inline remove/add, not re-locking
+            room_detach_hunter(from, (struct Hunter*)entity);
+            room_insert_hunter(to, (struct Hunter*)entity);
+        }
+        telemetry_room(from);
+        telemetry_room(to);
+    }
+    contention_post(&second->sem, contention_room_slot(second));
+    contention_post(&first->sem, contention_room_slot(first));
+    if (can_move) {
+        room_notify(from, events);
+        room_notify(to, events);
+    }
+    return can_move;
+}
+
+// Waiters re-check the counters under wait_lock, and notifiers only take the lock when
+// someone is waiting, so an idle room costs one atomic increment per change
+void room_notify(struct Room* room, unsigned events) {
+    // Nobody waits on a room in actor mode
+    if (!room || room->owner) return;
+    for (int i = 0; i < ROOM_EVENT_KINDS; i++) {
+        if (events & (1u << i)) {
+            __atomic_add_fetch(&room->event_counts[i], 1, __ATOMIC_SEQ_CST);
+        }
+    }
+    if (__atomic_load_n(&room->waiters, __ATOMIC_SEQ_CST) > 0) {
+        pthread_mutex_lock(&room->wait_lock);
+        pthread_cond_broadcast(&room->changed);
+        pthread_mutex_unlock(&room->wait_lock);
+    }
+}
+
+unsigned room_event_snapshot(struct Room* room, unsigned interest) {
+    if (!room) return 0;
+    unsigned total = 0;
+    for (int i = 0; i < ROOM_EVENT_KINDS; i++) {
+        if (interest & (1u << i)) {
+            total += __atomic_load_n(&room->event_counts[i], __ATOMIC_SEQ_CST);
+        }
+    }
+    return total;
+}
+
+// Returns true when a change of interest (or *cancel becoming true) ended the wait early
+bool room_wait_event(struct Room* room, unsigned interest, unsigned snapshot, long timeout_ns, const bool* cancel) {
+    if (!room) return false;
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += timeout_ns / 1000000000L;
+    deadline.tv_nsec += timeout_ns % 1000000000L;
+    if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+
+    bool changed = false;
+    pthread_mutex_lock(&room->wait_lock);
+    __atomic_add_fetch(&room->waiters, 1, __ATOMIC_SEQ_CST);
+    while (!(changed = room_event_snapshot(room, interest) != snapshot ||
+                       (cancel && __atomic_load_n(cancel, __ATOMIC_ACQUIRE)))) {
+        if (pthread_cond_timedwait(&room->changed, &room->wait_lock, &deadline) != 0) {
+            changed = room_event_snapshot(room, interest) != snapshot ||
+                      (cancel && __atomic_load_n(cancel, __ATOMIC_ACQUIRE));
+            break;
+        }
+    }
+    __atomic_sub_fetch(&room->waiters, 1, __ATOMIC_SEQ_CST);
+    pthread_mutex_unlock(&room->wait_lock);
+    return changed;
+}
+
+// Wake everyone blocked on this room so they can re-check their cancel flag
+void room_interrupt_waiters(struct Room* room) {
+    if (!room) return;
+    pthread_mutex_lock(&room->wait_lock);
+    pthread_cond_broadcast(&room->changed);
+    pthread_mutex_unlock(&room->wait_lock);
+}
+
+struct Room* room_get_random_connection(struct Room* room) {
+    if (!room || room->connection_count == 0) return NULL;
+    int index = rand_int_threadsafe(0, room->connection_count);
+    return room->connections[index];
+}
+
+// Weighted pick favouring connections nobody has visited for a while, with a strong
+// pull towards rooms where someone spotted evidence this device can collect
+struct Room* room_get_frontier_connection(struct Room* room, unsigned clock, enum EvidenceType device) {
+    if (!room || room->connection_count == 0) return NULL;
+    unsigned weights[MAX_CONNECTIONS];
+    unsigned total = 0;
+    for (int i = 0; i < room->connection_count; i++) {
+        struct Room* next = room->connections[i];
+        unsigned last = __atomic_load_n(&next->last_visit, __ATOMIC_RELAXED);
+        unsigned staleness = clock - last;
+        if (staleness > 64) staleness = 64;
+        weights[i] = 1 + staleness;
+        if (__atomic_load_n(&next->sighted, __ATOMIC_RELAXED) & device) {
+            weights[i] += 256;
+        }
+        total += weights[i];
+    }
+    int pick = rand_int_threadsafe(0, (int)total);
+    int index = room->connection_count - 1;
+    for (int i = 0; i < room->connection_count; i++) {
+        if (pick < (int)weights[i]) {
+            index = i;
+            break;
+        }
+        pick -= (int)weights[i];
+    }
+    // The weights come from other hunters' visits, so a replay takes the recorded pick
+    return room->connections[trace_observe(index)];
+}
+
+void room_cleanup(struct Room* room) {
+    if (!room) return;
+    sem_destroy(&room->sem);
+    free(room->hunters);
+    room->hunters = NULL;
+    free(room->evidence);
+    room->evidence = NULL;
+    pthread_cond_destroy(&room->changed);
+    pthread_mutex_destroy(&room->wait_lock);
 }
\ No newline at end of file
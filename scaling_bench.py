@@ -0,0 +1,317 @@
+"""
+End-to-end scaling benchmark for ghost_hunter_sim.
+
+Usage:
+- Build the simulator with make first
+- The script runs complete simulations with --fast --quiet --no-log in a scratch
+  directory, sweeping hunter count, house size and execution mode / worker count
+
+Command Line Arguments:
+- --hunters 10,100,1000 hunter counts to sweep
+- --rooms 0,64,256 house sizes to sweep; 0 is Willow House
+- --exec threads,actors execution modes to sweep
+- --workers 1,2,4 actor worker counts to sweep (thread mode has one thread per entity)
+- --runs <number> simulations per configuration
+- --out <filename> full results as JSON; --csv <filename> one plot-ready row per configuration
+- --baseline <filename> compare against an earlier --out file and flag regressions
+- --tolerance <fraction> how much worse than the baseline still passes (default 0.10)
+
+The exit status is 1 when a configuration regressed against the baseline or failed.
+"""
+
+from __future__ import annotations
+
+import argparse
+import csv
+import json
+import os
+import platform
+import re
+import subprocess
+import sys
+import tempfile
+import threading
+import time
+from dataclasses import dataclass, field
+from typing import Dict, List, Optional, Tuple
+
+
+EVENTS_PATTERN = re.compile(r"^Events logged: (\d+)$", re.MULTILINE)
+PEAK_RSS_PATTERN = re.compile(r"^Peak resident: (\d+) KiB$", re.MULTILINE)
+
+# Metrics compared against a baseline, and whether bigger is better
+COMPARED_METRICS: Dict[str, bool] = {
+    "sims_per_sec": True,
+    "events_per_sec": True,
+    "peak_rss_kib": False,
+}
+
+CSV_COLUMNS = [
+    "exec",
+    "workers",
+    "hunters",
+    "rooms",
+    "runs",
+    "failures",
+    "wall_s",
+    "sims_per_sec",
+    "events_per_sec",
+    "events_per_sim",
+    "peak_rss_kib",
+    "cpu_utilisation",
+]
+
+
+@dataclass
+class Config:
+    exec_mode: str
+    workers: int        # 0 in thread mode
+    hunters: int
+    rooms: int          # 0 for Willow House
+
+    @property
+    def key(self) -> str:
+        return f"{self.exec_mode}/w{self.workers}/h{self.hunters}/r{self.rooms}"
+
+    def arguments(self, seed: int) -> List[str]:
+        arguments = ["--fast", "--quiet", "--no-log", "--seed", str(seed),
+                     "--hunters", str(self.hunters), "--exec", self.exec_mode]
+        if self.exec_mode == "actors":
+            arguments += ["--workers", str(self.workers)]
+        if self.rooms > 0:
+            arguments += ["--rooms", str(self.rooms)]
+        return arguments
+
+
+@dataclass
+class Result:
+    config: Config
+    runs: int = 0
+    failures: int = 0
+    wall_s: float = 0.0
+    events: int = 0
+    cpu_s: float = 0.0
+    peak_rss_kib: int = 0
+    errors: List[str] = field(default_factory=list)
+
+    def metrics(self) -> Dict[str, float]:
+        succeeded = self.runs - self.failures
+        wall = self.wall_s if self.wall_s > 0 else float("nan")
+        return {
+            "sims_per_sec": succeeded / wall,
+            "events_per_sec": self.events / wall,
+            "events_per_sim": self.events / succeeded if succeeded else 0.0,
+            "peak_rss_kib": self.peak_rss_kib,
+            "cpu_utilisation": self.cpu_s / wall,
+        }
+
+
+def parse_counts(text: str) -> List[int]:
+    try:
+        counts = [int(part) for part in text.split(",") if part.strip()]
+    except ValueError:
+        raise argparse.ArgumentTypeError(f"expected a comma-separated list of numbers, got '{text}'")
+    if not counts or any(count < 0 for count in counts):
+        raise argparse.ArgumentTypeError(f"expected non-negative numbers, got '{text}'")
+    return counts
+
+
+def parse_modes(text: str) -> List[str]:
+    modes = [part.strip() for part in text.split(",") if part.strip()]
+    for mode in modes:
+        if mode not in ("threads", "actors"):
+            raise argparse.ArgumentTypeError(f"unknown execution mode '{mode}'")
+    return modes
+
+
+def build_configs(args: argparse.Namespace) -> List[Config]:
+    configs = []
+    for exec_mode in args.exec:
+        worker_counts = args.workers if exec_mode == "actors" else [0]
+        for workers in worker_counts:
+            for hunters in args.hunters:
+                for rooms in args.rooms:
+                    configs.append(Config(exec_mode, workers, hunters, rooms))
+    return configs
+
+
+def run_once(binary: str, config: Config, seed: int, workdir: str,
+             timeout: float) -> Tuple[float, int, float, int, Optional[str]]:
+    """One simulation: wall seconds, events, CPU seconds, peak RSS in KiB, and an error or None.
+
+    The child is reaped with wait4 so its CPU time is its own, not the running total
+    over every child so far. Its ru_maxrss starts from this script's RSS at fork, so
+    the peak the simulator reports about itself is preferred.
+    """
+    with tempfile.TemporaryFile(dir=workdir) as output:
+        started = time.perf_counter()
+        process = subprocess.Popen([binary] + config.arguments(seed), cwd=workdir, stdin=subprocess.DEVNULL,
+                                   stdout=output, stderr=subprocess.STDOUT)
+        timer = threading.Timer(timeout, process.kill)
+        timer.start()
+        try:
+            _, status, usage = os.wait4(process.pid, 0)
+        finally:
+            timer.cancel()
+        wall = time.perf_counter() - started
+        process.returncode = os.waitstatus_to_exitcode(status)
+        output.seek(0)
+        text = output.read().decode("utf-8", errors="replace")
+
+    cpu = usage.ru_utime + usage.ru_stime
+    peak_rss = usage.ru_maxrss if sys.platform != "darwin" else usage.ru_maxrss // 1024
+    if process.returncode != 0:
+        reason = f"timed out after {timeout:g} s" if process.returncode == -9 else f"exit status {process.returncode}"
+        tail = text.strip().splitlines()[-1:] or [""]
+        return wall, 0, cpu, peak_rss, f"{reason}: {tail[0][:200]}"
+    reported_peak = PEAK_RSS_PATTERN.search(text)
+    if reported_peak and int(reported_peak.group(1)) > 0:
+        peak_rss = int(reported_peak.group(1))
+    match = EVENTS_PATTERN.search(text)
+    if not match:
+        return wall, 0, cpu, peak_rss, "no 'Events logged' line in the output"
+    return wall, int(match.group(1)), cpu, peak_rss, None
+
+
+def run_config(binary: str, config: Config, runs: int, seed: int, workdir: str, timeout: float) -> Result:
+    result = Result(config=config)
+    for run in range(runs):
+        wall, events, cpu, peak_rss, error = run_once(binary, config, seed + run, workdir, timeout)
+        result.runs += 1
+        result.wall_s += wall
+        result.cpu_s += cpu
+        result.peak_rss_kib = max(result.peak_rss_kib, peak_rss)
+        if error:
+            result.failures += 1
+            result.errors.append(f"seed {seed + run}: {error}")
+        else:
+            result.events += events
+    return result
+
+
+def result_row(result: Result) -> Dict[str, object]:
+    config = result.config
+    metrics = result.metrics()
+    return {
+        "exec": config.exec_mode,
+        "workers": config.workers,
+        "hunters": config.hunters,
+        "rooms": config.rooms,
+        "runs": result.runs,
+        "failures": result.failures,
+        "wall_s": round(result.wall_s, 4),
+        "sims_per_sec": round(metrics["sims_per_sec"], 3),
+        "events_per_sec": round(metrics["events_per_sec"], 1),
+        "events_per_sim": round(metrics["events_per_sim"], 1),
+        "peak_rss_kib": metrics["peak_rss_kib"],
+        "cpu_utilisation": round(metrics["cpu_utilisation"], 3),
+    }
+
+
+def compare(rows: List[Dict[str, object]], baseline: Dict[str, object], tolerance: float) -> List[str]:
+    """Regressions of rows against a baseline results file, as printable lines."""
+    previous = {}
+    for row in baseline.get("results", []):
+        config = Config(row["exec"], row["workers"], row["hunters"], row["rooms"])
+        previous[config.key] = row
+    regressions = []
+    for row in rows:
+        key = Config(row["exec"], row["workers"], row["hunters"], row["rooms"]).key
+        old = previous.get(key)
+        if old is None:
+            continue
+        for metric, higher_is_better in COMPARED_METRICS.items():
+            before = float(old[metric])
+            after = float(row[metric])
+            if before <= 0:
+                continue
+            change = (after - before) / before
+            worse = -change if higher_is_better else change
+            if worse > tolerance:
+                regressions.append(f"{key} {metric}: {before:g} -> {after:g} ({change:+.1%})")
+    return regressions
+
+
+def main() -> None:
+    parser = argparse.ArgumentParser(description="Sweep complete ghost_hunter_sim runs and measure how they scale.")
+    parser.add_argument("--binary", default="./ghost_hunter_sim", help="Simulator to run (default ./ghost_hunter_sim).")
+    parser.add_argument("--hunters", type=parse_counts, default=[10, 100, 1000], help="Hunter counts, comma-separated.")
+    parser.add_argument("--rooms", type=parse_counts, default=[0, 64, 256],
+                        help="House sizes, comma-separated; 0 is Willow House.")
+    parser.add_argument("--exec", type=parse_modes, default=["threads", "actors"],
+                        help="Execution modes, comma-separated: threads, actors.")
+    parser.add_argument("--workers", type=parse_counts, default=None,
+                        help="Actor worker counts, comma-separated (default 1, 2, 4, ... up to the CPU count).")
+    parser.add_argument("--runs", type=int, default=3, help="Simulations per configuration (default 3).")
+    parser.add_argument("--seed", type=int, default=1, help="Seed of the first run; later runs count up from it.")
+    parser.add_argument("--timeout", type=float, default=120.0, help="Seconds before a run counts as hung.")
+    parser.add_argument("--out", default="scaling_results.json", help="Full results as JSON.")
+    parser.add_argument("--csv", default="scaling_results.csv", help="One plot-ready row per configuration.")
+    parser.add_argument("--baseline", default=None, help="Earlier --out file to compare against.")
+    parser.add_argument("--tolerance", type=float, default=0.10,
+                        help="Fraction a metric may get worse than the baseline before it is flagged (default 0.10).")
+    args = parser.parse_args()
+
+    if args.runs < 1:
+        parser.error("--runs needs a positive count")
+    cpus = os.cpu_count() or 1
+    if args.workers is None:
+        args.workers = []
+        count = 1
+        while count < cpus:
+            args.workers.append(count)
+            count *= 2
+        args.workers.append(cpus)
+    if any(count < 1 for count in args.workers):
+        parser.error("--workers needs positive counts")
+    binary = os.path.abspath(args.binary)
+    if not os.access(binary, os.X_OK):
+        parser.error(f"{args.binary} is not an executable; run make first")
+
+    configs = build_configs(args)
+    rows = []
+    results = []
+    print(f"{'configuration':<28} {'sims/s':>9} {'events/s':>12} {'peak RSS':>10} {'CPU':>6}")
+    with tempfile.TemporaryDirectory(prefix="ghost_scaling.") as workdir:
+        for config in configs:
+            result = run_config(binary, config, args.runs, args.seed, workdir, args.timeout)
+            row = result_row(result)
+            rows.append(row)
+            results.append(result)
+            print(f"{config.key:<28} {row['sims_per_sec']:>9.2f} {row['events_per_sec']:>12.0f} "
+                  f"{row['peak_rss_kib']:>7} KiB {row['cpu_utilisation']:>6.2f}", flush=True)
+            for error in result.errors:
+                print(f"  ! {error}")
+
+    report = {
+        "machine": {"cpus": cpus, "platform": platform.platform(), "python": platform.python_version()},
+        "binary": args.binary,
+        "runs": args.runs,
+        "seed": args.seed,
+        "results": rows,
+        "errors": {result.config.key: result.errors for result in results if result.errors},
+    }
+    with open(args.out, "w", encoding="utf-8") as handle:
+        json.dump(report, handle, indent=2)
+        handle.write("\n")
+    with open(args.csv, "w", encoding="utf-8", newline="") as handle:
+        writer = csv.DictWriter(handle, fieldnames=CSV_COLUMNS)
+        writer.writeheader()
+        writer.writerows(rows)
+    print(f"Results written to {args.out} and {args.csv}")
+
+    failed = sum(result.failures for result in results)
+    regressions = []
+    if args.baseline:
+        with open(args.baseline, "r", encoding="utf-8") as handle:
+            regressions = compare(rows, json.load(handle), args.tolerance)
+        print(f"Regressions beyond {args.tolerance:.0%} of {args.baseline}: {len(regressions)}")
+        for line in regressions:
+            print(f"  - {line}")
+    if failed:
+        print(f"Failed runs: {failed}")
+    sys.exit(1 if regressions or failed else 0)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,250 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "defs.h"
+#include "helpers.h"
+
+// Live telemetry in a POSIX shared memory segment. Every record has exactly one writer at
+// a time: the entity's own turn, whoever holds a room's lock, whoever holds a case file's
+// mutex, and a publisher thread for the run-wide counters. Publishing a record is a
+// seqlock write of a handful of fields, with no syscalls and no shared locks, so the
+// simulation threads only pay a few stores per turn. See struct TelemetryHeader.
+
+static bool telemetry_enabled = false;
+static const struct House* telemetry_house = NULL;
+static struct TelemetryHeader* segment = NULL;
+static size_t segment_size = 0;
+static char segment_name[128];
+static struct TelemetryRoom* rooms = NULL;
+static struct TelemetryHunter* hunters = NULL;
+static struct TelemetryGhost* ghosts = NULL;
+static struct TelemetryCase* cases = NULL;
+static pthread_t publisher;
+static bool publisher_started = false;
+static bool publisher_stopping = false;
+static pthread_mutex_t publisher_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t publisher_wake = PTHREAD_COND_INITIALIZER;
+
+static long long monotonic_ns() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long long)now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+// Single-writer seqlock: odd while the fields change, release stores so a reader that
+// sees the final even value also sees every field
+static void seq_begin(uint32_t* seq) {
+    __atomic_store_n(seq, *seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static void seq_end(uint32_t* seq) {
+    __atomic_store_n(seq, *seq + 1, __ATOMIC_RELEASE);
+}
+
+#define PUBLISH(field, value) __atomic_store_n(&(field), (value), __ATOMIC_RELAXED)
+
+static int room_index(const struct Room* room) {
+    if (!room) return -1;
+    const struct Room* first = telemetry_house->rooms;
+    if (room < first || room >= first + telemetry_house->room_count) return -1;
+    return (int)(room - first);
+}
+
+void telemetry_room(const struct Room* room) {
+    if (!telemetry_enabled) return;
+    int index = room_index(room);
+    if (index < 0) return;
+    struct TelemetryRoom* record = &rooms[index];
+    seq_begin(&record->seq);
+    PUBLISH(record->hunters, room->hunter_count);
+    PUBLISH(record->ghosts, room->ghost_count);
+    PUBLISH(record->evidence, room->evidence_any);
+    seq_end(&record->seq);
+}
+
+void telemetry_hunter(const struct Hunter* hunter) {
+    if (!telemetry_enabled || !hunter || hunter->index < 0 || hunter->index >= telemetry_house->hunter_count) return;
+    struct TelemetryHunter* record = &hunters[hunter->index];
+    seq_begin(&record->seq);
+    PUBLISH(record->room, room_index(hunter->current_room));
+    PUBLISH(record->boredom, hunter->boredom);
+    PUBLISH(record->fear, hunter->fear);
+    PUBLISH(record->device, evidence_to_index(hunter->device));
+    PUBLISH(record->turns, hunter->turns);
+    PUBLISH(record->running, hunter->is_running);
+    seq_end(&record->seq);
+}
+
+void telemetry_ghost(const struct Ghost* ghost) {
+    if (!telemetry_enabled || !ghost || ghost->index < 0 || ghost->index >= telemetry_house->ghost_count) return;
+    struct TelemetryGhost* record = &ghosts[ghost->index];
+    seq_begin(&record->seq);
+    PUBLISH(record->room, room_index(ghost->current_room));
+    PUBLISH(record->boredom, ghost->boredom);
+    PUBLISH(record->turns, ghost->turns);
+    PUBLISH(record->running, ghost->is_running);
+    seq_end(&record->seq);
+}
+
+// Called with the case file's mutex held
+void telemetry_case(const struct CaseFile* case_file) {
+    if (!telemetry_enabled || !case_file) return;
+    const struct Ghost* ghost = (const struct Ghost*)((const char*)case_file - offsetof(struct Ghost, case_file));
+    if (ghost->index < 0 || ghost->index >= telemetry_house->ghost_count ||
+        telemetry_house->ghosts[ghost->index] != ghost) return;
+    struct TelemetryCase* record = &cases[ghost->index];
+    seq_begin(&record->seq);
+    PUBLISH(record->collected, case_file->collected);
+    PUBLISH(record->candidates, case_file->candidates);
+    PUBLISH(record->solved, case_file->solved);
+    PUBLISH(record->solved_turn, case_file->solved_turn);
+    seq_end(&record->seq);
+}
+
+static void publish_header(bool finished) {
+    seq_begin(&segment->seq);
+    PUBLISH(segment->finished, finished);
+    PUBLISH(segment->updated_ns, monotonic_ns());
+    PUBLISH(segment->events, (long long)log_event_count());
+    seq_end(&segment->seq);
+}
+
+static void* publisher_thread(void* arg) {
+    (void)arg;
+    pthread_mutex_lock(&publisher_lock);
+    while (!publisher_stopping) {
+        publish_header(false);
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_nsec += TELEMETRY_PUBLISH_NS;
+        deadline.tv_sec += deadline.tv_nsec / 1000000000L;
+        deadline.tv_nsec %= 1000000000L;
+        pthread_cond_timedwait(&publisher_wake, &publisher_lock, &deadline);
+    }
+    pthread_mutex_unlock(&publisher_lock);
+    return NULL;
+}
+
+// Has to run before the entity threads start. Fills in everything that doesn't change,
+// publishes the current state of every record, and only then sets the magic.
+bool telemetry_start(const struct House* house, const char* name) {
+    if (!house || !name) return false;
+    snprintf(segment_name, sizeof(segment_name), "%s%s", name[0] == '/' ? "" : "/", name);
+
+    size_t rooms_offset = sizeof(struct TelemetryHeader);
+    size_t hunters_offset = rooms_offset + (size_t)house->room_count * sizeof(struct TelemetryRoom);
+    size_t ghosts_offset = hunters_offset + (size_t)house->hunter_count * sizeof(struct TelemetryHunter);
+    size_t cases_offset = ghosts_offset + (size_t)house->ghost_count * sizeof(struct TelemetryGhost);
+    size_t size = cases_offset + (size_t)house->ghost_count * sizeof(struct TelemetryCase);
+
+    int fd = shm_open(segment_name, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        fprintf(stderr, "Failed to create telemetry segment %s\n", segment_name);
+        return false;
+    }
+    if (ftruncate(fd, (off_t)size) != 0) {
+        fprintf(stderr, "Failed to size telemetry segment %s\n", segment_name);
+        close(fd);
+        shm_unlink(segment_name);
+        return false;
+    }
+    void* mapping = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        fprintf(stderr, "Failed to map telemetry segment %s\n", segment_name);
+        shm_unlink(segment_name);
+        return false;
+    }
+    segment = mapping;
+    segment_size = size;
+    telemetry_house = house;
+    rooms = (struct TelemetryRoom*)((char*)mapping + rooms_offset);
+    hunters = (struct TelemetryHunter*)((char*)mapping + hunters_offset);
+    ghosts = (struct TelemetryGhost*)((char*)mapping + ghosts_offset);
+    cases = (struct TelemetryCase*)((char*)mapping + cases_offset);
+
+    segment->version = TELEMETRY_VERSION;
+    segment->size = size;
+    segment->pid = (int32_t)getpid();
+    segment->room_count = house->room_count;
+    segment->hunter_count = house->hunter_count;
+    segment->ghost_count = house->ghost_count;
+    segment->rooms_offset = (uint32_t)rooms_offset;
+    segment->hunters_offset = (uint32_t)hunters_offset;
+    segment->ghosts_offset = (uint32_t)ghosts_offset;
+    segment->cases_offset = (uint32_t)cases_offset;
+    const enum EvidenceType* devices = NULL;
+    int device_count = get_all_evidence_types(&devices);
+    for (int i = 0; i < device_count && i < EVIDENCE_TYPE_COUNT; i++) {
+        snprintf(segment->device_names[evidence_to_index(devices[i])], TELEMETRY_NAME_LENGTH, "%s",
+                 evidence_to_string(devices[i]));
+    }
+    segment->started_ns = monotonic_ns();
+    for (int i = 0; i < house->room_count; i++) {
+        snprintf(rooms[i].name, sizeof(rooms[i].name), "%s", house->rooms[i].name);
+    }
+    for (int i = 0; i < house->hunter_count; i++) {
+        hunters[i].id = house->hunters[i]->id;
+        snprintf(hunters[i].name, sizeof(hunters[i].name), "%s", house->hunters[i]->name);
+    }
+    for (int i = 0; i < house->ghost_count; i++) {
+        ghosts[i].id = house->ghosts[i]->id;
+        snprintf(ghosts[i].type, sizeof(ghosts[i].type), "%s", ghost_to_string(house->ghosts[i]->type));
+    }
+
+    telemetry_enabled = true;
+    for (int i = 0; i < house->room_count; i++) {
+        telemetry_room(&house->rooms[i]);
+    }
+    for (int i = 0; i < house->hunter_count; i++) {
+        telemetry_hunter(house->hunters[i]);
+    }
+    for (int i = 0; i < house->ghost_count; i++) {
+        telemetry_ghost(house->ghosts[i]);
+        telemetry_case(&house->ghosts[i]->case_file);
+    }
+    publish_header(false);
+    __atomic_store_n(&segment->magic, TELEMETRY_MAGIC, __ATOMIC_RELEASE);
+
+    publisher_stopping = false;
+    if (pthread_create(&publisher, NULL, publisher_thread, NULL) != 0) {
+        fprintf(stderr, "Failed to start the telemetry publisher; the event counters stay put\n");
+    } else {
+        publisher_started = true;
+    }
+    return true;
+}
+
+// A forked branch keeps the mapping but must not write into the parent's telemetry
+void telemetry_detach() {
+    telemetry_enabled = false;
+    publisher_started = false;
+}
+
+// Marks the run finished and removes the segment's name; a viewer that already has it
+// mapped keeps the final state
+void telemetry_stop() {
+    if (!segment) return;
+    if (publisher_started) {
+        pthread_mutex_lock(&publisher_lock);
+        publisher_stopping = true;
+        pthread_cond_signal(&publisher_wake);
+        pthread_mutex_unlock(&publisher_lock);
+        pthread_join(publisher, NULL);
+        publisher_started = false;
+    }
+    if (telemetry_enabled) {
+        publish_header(true);
+        shm_unlink(segment_name);
+    }
+    telemetry_enabled = false;
+    munmap(segment, segment_size);
+    segment = NULL;
+}
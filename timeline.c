@@ -0,0 +1,294 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+#include "defs.h"
+#include "helpers.h"
+
+// Entity activity timeline in the Chrome trace event format, which chrome://tracing and
+// ui.perfetto.dev both open. Every thread appends to its own chain of event chunks, so
+// recording never takes a lock or writes shared memory; chunk sizes come out of one
+// run-wide budget so a long run can't grow without bound. Events carry the entity they
+// belong to rather than the thread, which gives every hunter and ghost its own track
+// whether it runs on its own thread or on an actor worker.
+
+#define TIMELINE_EVENT_LIMIT (1L << 21)     // ~100 MiB of events; later ones are dropped
+#define TIMELINE_FIRST_CHUNK 64
+#define TIMELINE_MAX_CHUNK 4096
+#define TIMELINE_HUNTER_PID 1
+#define TIMELINE_GHOST_PID 2
+
+enum TimelineEventType {
+    TIMELINE_PHASE = 0,
+    TIMELINE_LOCK_WAIT = 1,
+    TIMELINE_INSTANT = 2
+};
+
+struct TimelineEvent {
+    long long began;            // monotonic ns
+    long long ended;            // equal to began for instants
+    const char* name;           // phase or action, both static strings
+    const char* room;           // instants: room names live as long as the house
+    const char* device;
+    const char* extra;
+    int entity_id;
+    short slot;                 // lock waits: contention slot of the lock
+    unsigned char kind;         // enum EntityKind
+    unsigned char type;         // enum TimelineEventType
+};
+
+struct TimelineChunk {
+    struct TimelineChunk* next;
+    int count;
+    int capacity;
+    struct TimelineEvent events[];
+};
+
+struct ThreadTimeline {
+    struct ThreadTimeline* next;
+    struct TimelineChunk* head;
+    struct TimelineChunk* tail;
+    long dropped;
+    // Entity this thread is running; lock waits and phases go on its track
+    bool bound;
+    enum EntityKind kind;
+    int entity_id;
+};
+
+static bool timeline_enabled = false;
+static const struct House* timeline_house = NULL;
+static long long timeline_origin = 0;
+static long budget_used = 0;
+static struct ThreadTimeline* all_timelines = NULL;
+static pthread_mutex_t all_timelines_lock = PTHREAD_MUTEX_INITIALIZER;
+static _Thread_local struct ThreadTimeline* local_timeline = NULL;
+
+static long long monotonic_ns() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long long)now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+static struct ThreadTimeline* thread_timeline() {
+    if (!local_timeline) {
+        local_timeline = calloc(1, sizeof(struct ThreadTimeline));
+        if (!local_timeline) return NULL;
+        pthread_mutex_lock(&all_timelines_lock);
+        local_timeline->next = all_timelines;
+        all_timelines = local_timeline;
+        pthread_mutex_unlock(&all_timelines_lock);
+    }
+    return local_timeline;
+}
+
+// Next free event of this thread; chunks double in size so thousands of threads
+// that each record a few turns stay small
+static struct TimelineEvent* next_event(struct ThreadTimeline* timeline) {
+    struct TimelineChunk* tail = timeline->tail;
+    if (tail && tail->count < tail->capacity) {
+        return &tail->events[tail->count++];
+    }
+    int capacity = tail ? tail->capacity * 2 : TIMELINE_FIRST_CHUNK;
+    if (capacity > TIMELINE_MAX_CHUNK) capacity = TIMELINE_MAX_CHUNK;
+    if (__atomic_load_n(&budget_used, __ATOMIC_RELAXED) >= TIMELINE_EVENT_LIMIT ||
+        __atomic_add_fetch(&budget_used, capacity, __ATOMIC_RELAXED) > TIMELINE_EVENT_LIMIT) {
+        timeline->dropped++;
+        return NULL;
+    }
+    struct TimelineChunk* chunk = malloc(sizeof(struct TimelineChunk) + (size_t)capacity * sizeof(struct TimelineEvent));
+    if (!chunk) {
+        timeline->dropped++;
+        return NULL;
+    }
+    chunk->next = NULL;
+    chunk->count = 1;
+    chunk->capacity = capacity;
+    if (tail) {
+        tail->next = chunk;
+    } else {
+        timeline->head = chunk;
+    }
+    timeline->tail = chunk;
+    return &chunk->events[0];
+}
+
+// Has to run before the entity threads start; turns before it aren't recorded
+bool timeline_start(const struct House* house) {
+    if (!house) return false;
+    timeline_house = house;
+    timeline_origin = monotonic_ns();
+    contention_start(house, false);
+    phase_timing_emit_spans();
+    timeline_enabled = true;
+    return true;
+}
+
+// Entity threads bind once; turns bind again, behind the phase clock check, because an
+// actor worker runs many entities
+void timeline_enter(enum EntityKind kind, int entity_id) {
+    if (!timeline_enabled) return;
+    struct ThreadTimeline* timeline = thread_timeline();
+    if (!timeline) return;
+    timeline->bound = true;
+    timeline->kind = kind;
+    timeline->entity_id = entity_id;
+}
+
+void timeline_span(enum TurnPhase phase, long long began, long long ended) {
+    struct ThreadTimeline* timeline = local_timeline;
+    if (!timeline_enabled || !timeline || !timeline->bound) return;
+    struct TimelineEvent* event = next_event(timeline);
+    if (!event) return;
+    *event = (struct TimelineEvent){ .began = began, .ended = ended, .name = phase_name(phase),
+                                     .entity_id = timeline->entity_id, .kind = timeline->kind,
+                                     .type = TIMELINE_PHASE };
+}
+
+void timeline_lock_wait(int slot, long long began, long long acquired) {
+    struct ThreadTimeline* timeline = local_timeline;
+    if (!timeline_enabled || !timeline || !timeline->bound) return;
+    struct TimelineEvent* event = next_event(timeline);
+    if (!event) return;
+    *event = (struct TimelineEvent){ .began = began, .ended = acquired, .name = "lock wait",
+                                     .entity_id = timeline->entity_id, .kind = timeline->kind,
+                                     .slot = (short)slot, .type = TIMELINE_LOCK_WAIT };
+}
+
+// Log records name their entity, so events outside a timed turn still land on its track
+void timeline_instant(bool is_ghost, int entity_id, const char* action, const char* room,
+                      const char* device, const char* extra) {
+    if (!timeline_enabled) return;
+    struct ThreadTimeline* timeline = thread_timeline();
+    if (!timeline) return;
+    struct TimelineEvent* event = next_event(timeline);
+    if (!event) return;
+    long long now = monotonic_ns();
+    *event = (struct TimelineEvent){ .began = now, .ended = now, .name = action, .room = room,
+                                     .device = device, .extra = extra, .entity_id = entity_id,
+                                     .kind = is_ghost ? ENTITY_GHOST : ENTITY_HUNTER,
+                                     .type = TIMELINE_INSTANT };
+}
+
+static void write_json_string(FILE* file, const char* text) {
+    fputc('"', file);
+    for (const unsigned char* c = (const unsigned char*)text; *c; c++) {
+        if (*c == '"' || *c == '\\') {
+            fprintf(file, "\\%c", *c);
+        } else if (*c < 0x20) {
+            fprintf(file, "\\u%04x", *c);
+        } else {
+            fputc(*c, file);
+        }
+    }
+    fputc('"', file);
+}
+
+// Every later entry starts with its own separator
+static void write_track_names(FILE* file) {
+    fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":\"Hunters\"}}",
+            TIMELINE_HUNTER_PID);
+    fprintf(file, ",\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":\"Ghosts\"}}",
+            TIMELINE_GHOST_PID);
+    char name[MAX_HUNTER_NAME + 32];
+    for (int i = 0; i < timeline_house->hunter_count; i++) {
+        const struct Hunter* hunter = timeline_house->hunters[i];
+        snprintf(name, sizeof(name), "hunter %d %s", hunter->id, hunter->name);
+        fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":",
+                TIMELINE_HUNTER_PID, hunter->id);
+        write_json_string(file, name);
+        fprintf(file, "}}");
+    }
+    for (int i = 0; i < timeline_house->ghost_count; i++) {
+        const struct Ghost* ghost = timeline_house->ghosts[i];
+        fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,"
+                "\"args\":{\"name\":\"ghost %d %s\"}}",
+                TIMELINE_GHOST_PID, ghost->id, ghost->id, ghost_to_string(ghost->type));
+    }
+}
+
+static void write_event(FILE* file, const struct TimelineEvent* event) {
+    int pid = event->kind == ENTITY_GHOST ? TIMELINE_GHOST_PID : TIMELINE_HUNTER_PID;
+    double ts_us = (event->began - timeline_origin) / 1e3;
+    if (event->type == TIMELINE_INSTANT) {
+        fprintf(file, "{\"name\":\"%s\",\"cat\":\"event\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%.3f,\"pid\":%d,\"tid\":%d,"
+                "\"args\":{", event->name, ts_us, pid, event->entity_id);
+        const char* separator = "";
+        const char* keys[] = { "room", "device", "extra" };
+        const char* values[] = { event->room, event->device, event->extra };
+        for (int i = 0; i < 3; i++) {
+            if (!values[i] || !values[i][0]) continue;
+            fprintf(file, "%s\"%s\":", separator, keys[i]);
+            write_json_string(file, values[i]);
+            separator = ",";
+        }
+        fprintf(file, "}}");
+        return;
+    }
+    double dur_us = (event->ended - event->began) / 1e3;
+    if (event->type == TIMELINE_LOCK_WAIT) {
+        char lock[MAX_ROOM_NAME + 16] = "?";
+        contention_slot_name(event->slot, lock, sizeof(lock));
+        fprintf(file, "{\"name\":\"lock wait\",\"cat\":\"lock\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,"
+                "\"pid\":%d,\"tid\":%d,\"args\":{\"lock\":", ts_us, dur_us, pid, event->entity_id);
+        write_json_string(file, lock);
+        fprintf(file, "}}");
+        return;
+    }
+    fprintf(file, "{\"name\":\"%s\",\"cat\":\"phase\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":%d}",
+            event->name, ts_us, dur_us, pid, event->entity_id);
+}
+
+// Only once every entity has stopped; room names and hunters have to still exist
+bool timeline_write(const char* path, long* events_written) {
+    if (!timeline_enabled) return false;
+    FILE* file = fopen(path, "w");
+    if (!file) {
+        fprintf(stderr, "Failed to open timeline file %s\n", path);
+        return false;
+    }
+    fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    write_track_names(file);
+    long written = 0;
+    long dropped = 0;
+    pthread_mutex_lock(&all_timelines_lock);
+    for (const struct ThreadTimeline* timeline = all_timelines; timeline; timeline = timeline->next) {
+        dropped += timeline->dropped;
+        for (const struct TimelineChunk* chunk = timeline->head; chunk; chunk = chunk->next) {
+            for (int i = 0; i < chunk->count; i++) {
+                fprintf(file, ",\n");
+                write_event(file, &chunk->events[i]);
+                written++;
+            }
+        }
+    }
+    pthread_mutex_unlock(&all_timelines_lock);
+    fprintf(file, "\n],\"otherData\":{\"dropped_events\":%ld}}\n", dropped);
+    bool ok = fclose(file) == 0;
+    if (!ok) {
+        fprintf(stderr, "Failed to write timeline file %s\n", path);
+    }
+    if (dropped > 0) {
+        fprintf(stderr, "Timeline: %ld events past the %ld event limit were dropped\n", dropped, TIMELINE_EVENT_LIMIT);
+    }
+    if (events_written) *events_written = written;
+    return ok;
+}
+
+void timeline_free() {
+    pthread_mutex_lock(&all_timelines_lock);
+    struct ThreadTimeline* timeline = all_timelines;
+    all_timelines = NULL;
+    pthread_mutex_unlock(&all_timelines_lock);
+    while (timeline) {
+        struct ThreadTimeline* next = timeline->next;
+        struct TimelineChunk* chunk = timeline->head;
+        while (chunk) {
+            struct TimelineChunk* next_chunk = chunk->next;
+            free(chunk);
+            chunk = next_chunk;
+        }
+        free(timeline);
+        timeline = next;
+    }
+}
@@ -0,0 +1,276 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "defs.h"
+
+// ghost_hunter_top: maps a running simulation's telemetry segment read-only and redraws
+// its state. Nothing here writes to the segment, so any number of viewers can watch a
+// run without it noticing. See struct TelemetryHeader for the layout.
+
+#define TOP_SNAPSHOT_RETRIES 1000
+
+struct TopOptions {
+    const char* name;
+    long interval_ms;
+    int rows;               // hunters listed, the rest are summarised
+    bool once;
+};
+
+struct TopState {
+    const struct TelemetryHeader* segment;
+    const struct TelemetryRoom* rooms;
+    const struct TelemetryHunter* hunters;
+    const struct TelemetryGhost* ghosts;
+    const struct TelemetryCase* cases;
+    long long last_events;
+    long long last_turns;
+    long long last_ns;
+};
+
+static void print_usage(const char* program) {
+    fprintf(stderr,
+            "Usage: %s [options] NAME\n"
+            "  NAME                 Telemetry segment the simulator was started with (--telemetry NAME)\n"
+            "  --interval MS        Time between refreshes (default 500)\n"
+            "  --rows N             Hunters listed individually (default 20)\n"
+            "  --once               Print one snapshot and exit\n",
+            program);
+}
+
+static bool parse_arguments(int argc, char* argv[], struct TopOptions* options) {
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* value = (i + 1 < argc) ? argv[i + 1] : NULL;
+        if (strcmp(arg, "--interval") == 0 && value) {
+            options->interval_ms = atol(value);
+            if (options->interval_ms < 1) {
+                fprintf(stderr, "--interval needs a positive number of milliseconds\n");
+                return false;
+            }
+            i++;
+        } else if (strcmp(arg, "--rows") == 0 && value) {
+            options->rows = atoi(value);
+            if (options->rows < 0) {
+                fprintf(stderr, "--rows can't be negative\n");
+                return false;
+            }
+            i++;
+        } else if (strcmp(arg, "--once") == 0) {
+            options->once = true;
+        } else if (arg[0] != '-' && !options->name) {
+            options->name = arg;
+        } else {
+            fprintf(stderr, "Unknown or incomplete option '%s'\n", arg);
+            return false;
+        }
+    }
+    if (!options->name) {
+        fprintf(stderr, "Which telemetry segment? Pass the NAME given to --telemetry\n");
+        return false;
+    }
+    return true;
+}
+
+static long long monotonic_ns() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long long)now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+static void sleep_ms(long ms) {
+    struct timespec pause = { ms / 1000, (ms % 1000) * 1000000L };
+    nanosleep(&pause, NULL);
+}
+
+// Copies one seqlock-protected record; false when its writer kept it busy throughout
+static bool read_record(void* copy, const void* record, size_t size) {
+    const uint32_t* seq = record;
+    for (int attempt = 0; attempt < TOP_SNAPSHOT_RETRIES; attempt++) {
+        uint32_t before = __atomic_load_n(seq, __ATOMIC_ACQUIRE);
+        if (before & 1) continue;
+        memcpy(copy, record, size);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(seq, __ATOMIC_RELAXED) == before) return true;
+    }
+    return false;
+}
+
+// Waits for the segment to exist and be complete, then maps it read-only
+static const struct TelemetryHeader* open_segment(const char* name) {
+    char path[128];
+    snprintf(path, sizeof(path), "%s%s", name[0] == '/' ? "" : "/", name);
+    bool announced = false;
+    while (true) {
+        int fd = shm_open(path, O_RDONLY, 0);
+        if (fd >= 0) {
+            struct stat info;
+            if (fstat(fd, &info) == 0 && (size_t)info.st_size >= sizeof(struct TelemetryHeader)) {
+                void* mapping = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+                close(fd);
+                if (mapping == MAP_FAILED) {
+                    fprintf(stderr, "Failed to map telemetry segment %s\n", path);
+                    return NULL;
+                }
+                const struct TelemetryHeader* segment = mapping;
+                if (__atomic_load_n(&segment->magic, __ATOMIC_ACQUIRE) == TELEMETRY_MAGIC) {
+                    if (segment->version != TELEMETRY_VERSION || segment->size > (uint64_t)info.st_size) {
+                        fprintf(stderr, "Telemetry segment %s has version %u, this viewer reads %u\n", path,
+                                segment->version, TELEMETRY_VERSION);
+                        return NULL;
+                    }
+                    return segment;
+                }
+                munmap(mapping, (size_t)info.st_size);
+            } else {
+                close(fd);
+            }
+        }
+        if (!announced) {
+            fprintf(stderr, "Waiting for a simulation to publish %s...\n", path);
+            announced = true;
+        }
+        sleep_ms(200);
+    }
+}
+
+static void evidence_letters(uint32_t mask, const struct TelemetryHeader* segment, char* buffer, size_t size) {
+    size_t used = 0;
+    for (int i = 0; i < EVIDENCE_TYPE_COUNT && used + 1 < size; i++) {
+        buffer[used++] = (mask & (1u << i)) ? segment->device_names[i][0] : '.';
+    }
+    buffer[used] = '\0';
+}
+
+static const char* room_name(const struct TopState* state, int index) {
+    if (index < 0 || index >= state->segment->room_count) return "(gone)";
+    return state->rooms[index].name;
+}
+
+static void draw(struct TopState* state, const struct TopOptions* options) {
+    const struct TelemetryHeader* segment = state->segment;
+    struct TelemetryHeader header;
+    if (!read_record(&header.seq, &segment->seq,
+                     sizeof(struct TelemetryHeader) - offsetof(struct TelemetryHeader, seq))) {
+        header = *segment;
+    }
+    long long now = monotonic_ns();
+
+    if (!options->once) printf("\033[H\033[2J");
+    double elapsed_s = (header.updated_ns - segment->started_ns) / 1e9;
+    printf("ghost_hunter_sim pid %d  %s  %.1f s  events %lld", segment->pid,
+           header.finished ? "finished" : "running", elapsed_s, header.events);
+    if (now - header.updated_ns > 5 * TELEMETRY_PUBLISH_NS && !header.finished) {
+        printf("  (no update for %.1f s)", (now - header.updated_ns) / 1e9);
+    }
+    printf("\n");
+
+    // Rooms
+    printf("\n%-24s %7s %6s  evidence\n", "room", "hunters", "ghosts");
+    for (int i = 0; i < segment->room_count; i++) {
+        struct TelemetryRoom room;
+        if (!read_record(&room, &state->rooms[i], sizeof(room))) continue;
+        char letters[EVIDENCE_TYPE_COUNT + 1];
+        evidence_letters(room.evidence, segment, letters, sizeof(letters));
+        printf("%-24.24s %7d %6d  %s\n", room.name, room.hunters, room.ghosts, letters);
+    }
+
+    // Ghosts and what the hunters know about them
+    printf("\n%-8s %-14s %-20s %7s %6s  %-8s %10s  %s\n", "ghost", "type", "room", "boredom", "turns",
+           "evidence", "candidates", "case");
+    for (int i = 0; i < segment->ghost_count; i++) {
+        struct TelemetryGhost ghost;
+        struct TelemetryCase case_file;
+        if (!read_record(&ghost, &state->ghosts[i], sizeof(ghost)) ||
+            !read_record(&case_file, &state->cases[i], sizeof(case_file))) continue;
+        char letters[EVIDENCE_TYPE_COUNT + 1];
+        evidence_letters(case_file.collected, segment, letters, sizeof(letters));
+        char solved[32] = "open";
+        if (case_file.solved) snprintf(solved, sizeof(solved), "solved on turn %d", case_file.solved_turn);
+        printf("%-8d %-14.14s %-20.20s %7d %6d  %-8s %10d  %s%s\n", ghost.id, ghost.type,
+               ghost.running ? room_name(state, ghost.room) : "(left)", ghost.boredom, ghost.turns, letters,
+               __builtin_popcount(case_file.candidates), solved, ghost.running ? "" : ", ghost left");
+    }
+
+    // Hunters: the first rows individually, everyone in the totals
+    int running = 0;
+    long long turns = 0;
+    long long boredom = 0;
+    long long fear = 0;
+    int device_counts[EVIDENCE_TYPE_COUNT] = {0};
+    printf("\n%-8s %-16s %-20s %-12s %7s %5s %6s\n", "hunter", "name", "room", "device", "boredom", "fear", "turns");
+    for (int i = 0; i < segment->hunter_count; i++) {
+        struct TelemetryHunter hunter;
+        if (!read_record(&hunter, &state->hunters[i], sizeof(hunter))) continue;
+        turns += hunter.turns;
+        if (hunter.running) {
+            running++;
+            boredom += hunter.boredom;
+            fear += hunter.fear;
+            if (hunter.device >= 0 && hunter.device < EVIDENCE_TYPE_COUNT) device_counts[hunter.device]++;
+        }
+        if (i >= options->rows) continue;
+        const char* device = hunter.device >= 0 && hunter.device < EVIDENCE_TYPE_COUNT ?
+                             segment->device_names[hunter.device] : "?";
+        printf("%-8d %-16.16s %-20.20s %-12.12s %7d %5d %6d\n", hunter.id, hunter.name,
+               hunter.running ? room_name(state, hunter.room) : "(left)", device, hunter.boredom, hunter.fear,
+               hunter.turns);
+    }
+    if (segment->hunter_count > options->rows) {
+        printf("... %d more\n", segment->hunter_count - options->rows);
+    }
+    printf("\nHunters in the house: %d of %d", running, segment->hunter_count);
+    if (running > 0) {
+        printf(", mean boredom %.1f, mean fear %.1f", (double)boredom / running, (double)fear / running);
+    }
+    printf("\nDevices held:");
+    for (int i = 0; i < EVIDENCE_TYPE_COUNT; i++) {
+        printf(" %s=%d", segment->device_names[i], device_counts[i]);
+    }
+    printf("\n");
+
+    // Rates since the previous refresh
+    if (state->last_ns > 0 && header.updated_ns > state->last_ns) {
+        double seconds = (header.updated_ns - state->last_ns) / 1e9;
+        printf("Events/s: %.0f  hunter turns/s: %.0f\n", (header.events - state->last_events) / seconds,
+               (turns - state->last_turns) / seconds);
+    }
+    if (header.updated_ns > state->last_ns) {
+        state->last_events = header.events;
+        state->last_turns = turns;
+        state->last_ns = header.updated_ns;
+    }
+    fflush(stdout);
+}
+
+int main(int argc, char* argv[]) {
+    struct TopOptions options = { .name = NULL, .interval_ms = 500, .rows = 20, .once = false };
+    if (!parse_arguments(argc, argv, &options)) {
+        print_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    const struct TelemetryHeader* segment = open_segment(options.name);
+    if (!segment) {
+        return EXIT_FAILURE;
+    }
+    const char* base = (const char*)segment;
+    struct TopState state = {
+        .segment = segment,
+        .rooms = (const struct TelemetryRoom*)(base + segment->rooms_offset),
+        .hunters = (const struct TelemetryHunter*)(base + segment->hunters_offset),
+        .ghosts = (const struct TelemetryGhost*)(base + segment->ghosts_offset),
+        .cases = (const struct TelemetryCase*)(base + segment->cases_offset),
+    };
+    while (true) {
+        draw(&state, &options);
+        if (options.once || __atomic_load_n(&segment->finished, __ATOMIC_ACQUIRE)) break;
+        sleep_ms(options.interval_ms);
+    }
+    munmap((void*)segment, segment->size);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,435 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "defs.h"
+#include "helpers.h"
+
+// Record and replay of a run.
+//
+// Every entity records into its own stream, so recording needs no locks. Each stream
+// holds, in the order the entity made them:
+//   TURN     global sequence number taken when the turn started
+//   RANDOM   every value rand_int_threadsafe() returned
+//   OBSERVE  every read of state other entities change (occupancy, evidence,
+//            case files, device counts, exploration map picks)
+//   MOVE     whether room_move_entity() succeeded
+//   CLOCK    log timestamps, as the difference from the previous one
+// Setup (ghost creation and hunter registration) records into stream 0.
+//
+// Replay hands each entity its recorded values instead of the live ones, so an entity
+// takes exactly the same decisions whatever the others do. The turns still run in
+// their recorded start order, which keeps shared writes such as case files in step.
+#define TRACE_MAGIC "GHTR"
+#define TRACE_VERSION 1
+
+enum TraceTag {
+    TRACE_TAG_TURN = 1,
+    TRACE_TAG_RANDOM = 2,
+    TRACE_TAG_OBSERVE = 3,
+    TRACE_TAG_MOVE = 4,
+    TRACE_TAG_CLOCK = 5
+};
+
+static enum TraceMode trace_mode = TRACE_OFF;
+static struct TraceStream setup_stream;
+static struct TraceStream* entity_streams = NULL;
+static int entity_stream_count = 0;
+static unsigned long turn_sequence = 0;
+static bool trace_diverged = false;
+static char (*recorded_names)[MAX_HUNTER_NAME] = NULL;
+static int* recorded_ids = NULL;
+static int recorded_hunters = 0;
+static _Thread_local struct TraceStream* bound_trace = NULL;
+
+static bool stream_reserve(struct TraceStream* stream, size_t extra) {
+    if (stream->length + extra <= stream->capacity) return true;
+    size_t capacity = stream->capacity ? stream->capacity * 2 : 256;
+    while (capacity < stream->length + extra) {
+        capacity *= 2;
+    }
+    unsigned char* data = realloc(stream->data, capacity);
+    if (!data) return false;
+    stream->data = data;
+    stream->capacity = capacity;
+    return true;
+}
+
+// Tag byte followed by the zigzag-encoded value as a little-endian base-128 varint
+static void stream_put(struct TraceStream* stream, enum TraceTag tag, long long value) {
+    if (!stream_reserve(stream, 11)) {
+        trace_diverged = true;
+        return;
+    }
+    unsigned long long bits = ((unsigned long long)value << 1) ^ (unsigned long long)(value >> 63);
+    stream->data[stream->length++] = (unsigned char)tag;
+    do {
+        unsigned char byte = bits & 0x7F;
+        bits >>= 7;
+        stream->data[stream->length++] = byte | (bits ? 0x80 : 0);
+    } while (bits);
+}
+
+static bool stream_get(struct TraceStream* stream, enum TraceTag tag, long long* value) {
+    if (stream->position >= stream->length || stream->data[stream->position] != tag) {
+        return false;
+    }
+    size_t position = stream->position + 1;
+    unsigned long long bits = 0;
+    int shift = 0;
+    while (position < stream->length) {
+        unsigned char byte = stream->data[position++];
+        bits |= (unsigned long long)(byte & 0x7F) << shift;
+        shift += 7;
+        if (!(byte & 0x80)) {
+            stream->position = position;
+            *value = (long long)(bits >> 1) ^ -(long long)(bits & 1);
+            return true;
+        }
+    }
+    return false;
+}
+
+// Records the live value, or swaps in the recorded one during replay
+static long long trace_value(enum TraceTag tag, long long value) {
+    struct TraceStream* stream = bound_trace;
+    if (trace_mode == TRACE_OFF || !stream) return value;
+    if (trace_mode == TRACE_RECORD) {
+        stream_put(stream, tag, value);
+        return value;
+    }
+    long long recorded;
+    if (!stream_get(stream, tag, &recorded)) {
+        if (!trace_diverged) {
+            fprintf(stderr, "Replay diverged from the trace in stream of entity %d at byte %zu\n",
+                    stream->entity_id, stream->position);
+        }
+        trace_diverged = true;
+        return value;
+    }
+    return recorded;
+}
+
+enum TraceMode trace_get_mode() {
+    return trace_mode;
+}
+
+void trace_bind(struct TraceStream* stream) {
+    bound_trace = stream;
+}
+
+void trace_turn() {
+    long long sequence = 0;
+    if (trace_mode == TRACE_RECORD && bound_trace) {
+        sequence = (long long)__atomic_fetch_add(&turn_sequence, 1, __ATOMIC_RELAXED);
+    }
+    trace_value(TRACE_TAG_TURN, sequence);
+}
+
+int trace_random(int value) {
+    return (int)trace_value(TRACE_TAG_RANDOM, value);
+}
+
+int trace_observe(int value) {
+    return (int)trace_value(TRACE_TAG_OBSERVE, value);
+}
+
+bool trace_move(bool moved) {
+    return trace_value(TRACE_TAG_MOVE, moved) != 0;
+}
+
+long long trace_clock(long long timestamp) {
+    struct TraceStream* stream = bound_trace;
+    if (trace_mode == TRACE_OFF || !stream) return timestamp;
+    long long delta = trace_value(TRACE_TAG_CLOCK, timestamp - stream->last_clock);
+    stream->last_clock += delta;
+    return stream->last_clock;
+}
+
+bool trace_has_diverged() {
+    return trace_diverged;
+}
+
+void trace_start_recording() {
+    trace_mode = TRACE_RECORD;
+    memset(&setup_stream, 0, sizeof(setup_stream));
+    setup_stream.entity_id = -1;
+    trace_bind(&setup_stream);
+}
+
+// Ghost streams come first, in House::ghosts order, then the hunters in House::hunters order
+bool trace_attach_entities(struct House* house) {
+    if (trace_mode == TRACE_OFF || !house) return true;
+    int count = house->ghost_count + house->hunter_count;
+    if (trace_mode == TRACE_RECORD) {
+        entity_streams = calloc(count > 0 ? count : 1, sizeof(struct TraceStream));
+        if (!entity_streams) return false;
+        entity_stream_count = count;
+    } else if (count != entity_stream_count) {
+        fprintf(stderr, "Trace holds %d entities but the replayed house has %d\n",
+                entity_stream_count, count);
+        return false;
+    }
+    for (int i = 0; i < house->ghost_count; i++) {
+        entity_streams[i].entity_id = house->ghosts[i]->id;
+        house->ghosts[i]->entity.trace = &entity_streams[i];
+    }
+    for (int i = 0; i < house->hunter_count; i++) {
+        struct TraceStream* stream = &entity_streams[house->ghost_count + i];
+        stream->entity_id = house->hunters[i]->id;
+        house->hunters[i]->entity.trace = stream;
+    }
+    trace_bind(NULL);
+    return true;
+}
+
+static bool write_stream(FILE* file, const struct TraceStream* stream) {
+    unsigned long long length = stream->length;
+    return fwrite(&length, sizeof(length), 1, file) == 1 &&
+           (length == 0 || fwrite(stream->data, 1, stream->length, file) == stream->length);
+}
+
+bool trace_save(const char* path, struct House* house, long* bytes_written) {
+    if (trace_mode != TRACE_RECORD || !house) return false;
+    FILE* file = fopen(path, "wb");
+    if (!file) {
+        fprintf(stderr, "Failed to create trace %s\n", path);
+        return false;
+    }
+    const struct SimConfig* config = &house->config;
+    int32_t header[] = {
+        TRACE_VERSION, config->device_policy, config->explore_policy, (int32_t)config->seed,
+        config->room_capacity, config->ghost_count, config->layout_rooms, config->log_files,
+        house->hunter_count, entity_stream_count
+    };
+    bool ok = fwrite(TRACE_MAGIC, 1, 4, file) == 4 &&
+              fwrite(header, sizeof(header), 1, file) == 1;
+    for (int i = 0; ok && i < house->hunter_count; i++) {
+        struct Hunter* hunter = house->hunters[i];
+        int32_t id = hunter->id;
+        ok = fwrite(hunter->name, 1, MAX_HUNTER_NAME, file) == MAX_HUNTER_NAME &&
+             fwrite(&id, sizeof(id), 1, file) == 1;
+    }
+    ok = ok && write_stream(file, &setup_stream);
+    for (int i = 0; ok && i < entity_stream_count; i++) {
+        ok = write_stream(file, &entity_streams[i]);
+    }
+    if (ok && bytes_written) {
+        *bytes_written = ftell(file);
+    }
+    if (fclose(file) != 0) {
+        ok = false;
+    }
+    if (!ok) {
+        fprintf(stderr, "Failed to write trace %s\n", path);
+    }
+    return ok;
+}
+
+static bool read_stream(FILE* file, struct TraceStream* stream) {
+    unsigned long long length = 0;
+    if (fread(&length, sizeof(length), 1, file) != 1) return false;
+    memset(stream, 0, sizeof(*stream));
+    if (length == 0) return true;
+    stream->data = malloc(length);
+    if (!stream->data) return false;
+    stream->length = stream->capacity = length;
+    return fread(stream->data, 1, length, file) == length;
+}
+
+// Loads a trace for replay. The recorded configuration replaces what shapes the run.
+bool trace_load(const char* path, struct SimConfig* config) {
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        fprintf(stderr, "Failed to open trace %s\n", path);
+        return false;
+    }
+    char magic[4];
+    int32_t header[10];
+    bool ok = fread(magic, 1, 4, file) == 4 && memcmp(magic, TRACE_MAGIC, 4) == 0 &&
+              fread(header, sizeof(header), 1, file) == 1 && header[0] == TRACE_VERSION &&
+              header[8] >= 0 && header[9] >= 0;
+    if (ok) {
+        config->device_policy = (enum DevicePolicy)header[1];
+        config->explore_policy = (enum ExplorePolicy)header[2];
+        config->seed = (unsigned)header[3];
+        config->seeded = true;
+        config->room_capacity = header[4];
+        config->ghost_count = header[5];
+        config->layout_rooms = header[6];
+        config->log_files = header[7] != 0;
+        recorded_hunters = header[8];
+        entity_stream_count = header[9];
+        recorded_names = calloc(recorded_hunters > 0 ? recorded_hunters : 1, MAX_HUNTER_NAME);
+        recorded_ids = calloc(recorded_hunters > 0 ? recorded_hunters : 1, sizeof(int));
+        entity_streams = calloc(entity_stream_count > 0 ? entity_stream_count : 1,
+                                sizeof(struct TraceStream));
+        ok = recorded_names && recorded_ids && entity_streams;
+    }
+    for (int i = 0; ok && i < recorded_hunters; i++) {
+        int32_t id = 0;
+        ok = fread(recorded_names[i], 1, MAX_HUNTER_NAME, file) == MAX_HUNTER_NAME &&
+             fread(&id, sizeof(id), 1, file) == 1;
+        recorded_names[i][MAX_HUNTER_NAME - 1] = '\0';
+        recorded_ids[i] = id;
+    }
+    ok = ok && read_stream(file, &setup_stream);
+    for (int i = 0; ok && i < entity_stream_count; i++) {
+        ok = read_stream(file, &entity_streams[i]);
+    }
+    fclose(file);
+    if (!ok) {
+        fprintf(stderr, "%s is not a trace this build can replay\n", path);
+        trace_free();
+        return false;
+    }
+    setup_stream.entity_id = -1;
+    trace_mode = TRACE_REPLAY;
+    trace_bind(&setup_stream);
+    return true;
+}
+
+int trace_hunter_count() {
+    return recorded_hunters;
+}
+
+const char* trace_hunter_name(int index) {
+    return (index >= 0 && index < recorded_hunters) ? recorded_names[index] : NULL;
+}
+
+int trace_hunter_id(int index) {
+    return (index >= 0 && index < recorded_hunters) ? recorded_ids[index] : 0;
+}
+
+struct TurnSlot {
+    long long sequence;
+    struct Entity* entity;
+};
+
+static int compare_turns(const void* a, const void* b) {
+    long long left = ((const struct TurnSlot*)a)->sequence;
+    long long right = ((const struct TurnSlot*)b)->sequence;
+    return (left > right) - (left < right);
+}
+
+// Collects every TURN record without consuming the streams
+static int collect_turns(struct TurnSlot** turns_out) {
+    int count = 0;
+    int capacity = 1024;
+    struct TurnSlot* turns = malloc(sizeof(struct TurnSlot) * capacity);
+    for (int i = 0; turns && i < entity_stream_count; i++) {
+        struct TraceStream* stream = &entity_streams[i];
+        struct TraceStream scan = *stream;
+        scan.position = 0;
+        while (scan.position < scan.length) {
+            enum TraceTag tag = (enum TraceTag)scan.data[scan.position];
+            long long value;
+            if (!stream_get(&scan, tag, &value)) break;
+            if (tag != TRACE_TAG_TURN) continue;
+            if (count == capacity) {
+                capacity *= 2;
+                struct TurnSlot* grown = realloc(turns, sizeof(struct TurnSlot) * capacity);
+                if (!grown) {
+                    free(turns);
+                    return -1;
+                }
+                turns = grown;
+            }
+            turns[count].sequence = value;
+            turns[count].entity = stream->owner;
+            count++;
+        }
+    }
+    if (!turns) return -1;
+    qsort(turns, count, sizeof(struct TurnSlot), compare_turns);
+    *turns_out = turns;
+    return count;
+}
+
+static bool entity_running(struct Entity* entity) {
+    if (entity->kind == ENTITY_GHOST) return ((struct Ghost*)entity)->is_running;
+    return ((struct Hunter*)entity)->is_running;
+}
+
+static void entity_leave(struct Entity* entity) {
+    trace_bind(entity->trace);
+    if (entity->kind == ENTITY_GHOST) {
+        ghost_leave_house((struct Ghost*)entity);
+    } else {
+        hunter_leave_house((struct Hunter*)entity);
+    }
+}
+
+// Runs every recorded turn on the calling thread in the order the turns started. Rooms
+// are grown to fit every hunter because the recorded move outcomes decide who gets in.
+int trace_replay(struct House* house) {
+    if (trace_mode != TRACE_REPLAY || !house) return -1;
+    for (int i = 0; i < house->ghost_count; i++) {
+        entity_streams[i].owner = &house->ghosts[i]->entity;
+    }
+    for (int i = 0; i < house->hunter_count; i++) {
+        entity_streams[house->ghost_count + i].owner = &house->hunters[i]->entity;
+    }
+    for (int r = 0; r < house->room_count; r++) {
+        struct Room* room = &house->rooms[r];
+        if (room->hunter_capacity < house->hunter_count) {
+            room_set_capacity(room, house->hunter_count);
+        }
+    }
+
+    struct TurnSlot* turns = NULL;
+    int count = collect_turns(&turns);
+    if (count < 0) return -1;
+    for (int i = 0; i < count; i++) {
+        struct Entity* entity = turns[i].entity;
+        trace_bind(entity->trace);
+        if (entity->kind == ENTITY_GHOST) {
+            struct Ghost* ghost = (struct Ghost*)entity;
+            rand_bind_stream(&ghost->rng_state);
+            ghost_take_turn(ghost);
+        } else {
+            struct Hunter* hunter = (struct Hunter*)entity;
+            rand_bind_stream(&hunter->rng_state);
+            hunter_take_turn(hunter);
+        }
+        if (!entity_running(entity)) {
+            entity_leave(entity);
+        }
+    }
+    free(turns);
+
+    // Whoever was still inside when the run ended leaves the way they did then
+    for (int i = 0; i < house->ghost_count; i++) {
+        if (house->ghosts[i]->is_running) entity_leave(&house->ghosts[i]->entity);
+    }
+    for (int i = 0; i < house->hunter_count; i++) {
+        if (house->hunters[i]->is_running) entity_leave(&house->hunters[i]->entity);
+    }
+    trace_bind(NULL);
+    rand_bind_stream(NULL);
+    for (int i = 0; i < entity_stream_count && !trace_diverged; i++) {
+        if (entity_streams[i].position != entity_streams[i].length) {
+            fprintf(stderr, "Replay left part of the trace of entity %d unused\n",
+                    entity_streams[i].entity_id);
+            trace_diverged = true;
+        }
+    }
+    return count;
+}
+
+void trace_free() {
+    free(setup_stream.data);
+    memset(&setup_stream, 0, sizeof(setup_stream));
+    for (int i = 0; i < entity_stream_count; i++) {
+        free(entity_streams[i].data);
+    }
+    free(entity_streams);
+    entity_streams = NULL;
+    entity_stream_count = 0;
+    free(recorded_names);
+    recorded_names = NULL;
+    free(recorded_ids);
+    recorded_ids = NULL;
+    recorded_hunters = 0;
+    trace_mode = TRACE_OFF;
+    trace_bind(NULL);
+}
@@ -9,6 +9,12 @@ Usage:
 Command Line Arguments:
 - --limit <number> limits the number of logs that it looks at for quick tests
 - --export <filename> exports a combined log, sorted by timestamp
+- --jobs <number> parses the log files in this many processes (default: one per core)
+- --follow checks the logs while the simulation is still writing them (stop with Ctrl-C)
+
+The files are parsed in parallel into compact columns, one or more chunks per file,
+a few chunks ahead of where the check has got to. Every log file is already in time
+order, so the columns are merged as streams and checked one timestamp at a time.
 
 Note: This code might be updated throughout the project to modify or add additional verifications.
 """
@@ -16,11 +22,36 @@ Note: This code might be updated throughout the project to modify or add additio
 from __future__ import annotations
 
 import argparse
+import contextlib
 import csv
+import functools
 import glob
-from collections import defaultdict
+import heapq
+import itertools
+import multiprocessing
+import os
+import sys
+import time
+from array import array
+from collections import defaultdict, deque
 from dataclasses import dataclass, field
-from typing import Dict, List, Optional, Set, Tuple
+from typing import Callable, Dict, Iterable, Iterator, List, Optional, Set, Tuple
+
+
+# Bytes of log handed to one parse task; bigger files are split, smaller ones batched.
+# Tasks shrink towards the minimum until every process gets a few of them.
+PARSE_CHUNK_BYTES = 4 * 1024 * 1024
+PARSE_CHUNK_MIN_BYTES = 64 * 1024
+PARSE_TASKS_PER_JOB = 4
+# Chunks of one file parsed ahead of the merge, so memory stays at files x this many chunks
+PARSE_CHUNKS_AHEAD = 2
+
+# --follow defaults: how often files are polled, how long an entry may wait for the
+# other files to catch up, and how long the logs stay quiet before the run counts as over
+FOLLOW_POLL_MS = 200
+FOLLOW_LAG_MS = 1000
+FOLLOW_IDLE_EXIT_S = 10.0
+FOLLOW_STATUS_S = 5.0
 
 
 # Willow house layout
@@ -122,70 +153,198 @@ def compute_pending_evidence(entries: List[LogEntry]) -> Dict[Tuple[int, str, st
     return pending
 
 
-def parse_logs(limit: Optional[int] = None) -> List[LogEntry]:
-    entries: List[LogEntry] = []
+@dataclass
+class LogColumns:
+    """One parsed chunk of a log file, a column per field instead of an object per row.
+
+    Text fields are stored as indexes into strings; lines counts from the chunk start.
+    """
+
+    path: str
+    rows: int = 0
+    timestamp: array = field(default_factory=lambda: array("q"))
+    entity_id: array = field(default_factory=lambda: array("q"))
+    boredom: array = field(default_factory=lambda: array("q"))
+    fear: array = field(default_factory=lambda: array("q"))
+    line: array = field(default_factory=lambda: array("l"))
+    text: array = field(default_factory=lambda: array("l"))  # 5 per row: type, room, device, action, extra
+    strings: List[str] = field(default_factory=list)
+
+
+def parse_chunk(path: str, start: int, end: int) -> LogColumns:
+    with open(path, "rb") as handle:
+        handle.seek(start)
+        data = handle.read(end - start)
+    columns = LogColumns(path=path)
+    codes: Dict[str, int] = {}
+
+    def code(value: str) -> int:
+        index = codes.get(value)
+        if index is None:
+            index = codes[value] = len(columns.strings)
+            columns.strings.append(value)
+        return index
+
+    for row_number, row in enumerate(csv.reader(data.decode("utf-8").splitlines()), start=1):
+        columns.rows = row_number
+        if not row:
+            continue
+        columns.timestamp.append(int(row[0]))
+        columns.entity_id.append(int(row[2]))
+        columns.boredom.append(int(row[5]))
+        columns.fear.append(int(row[6]))
+        columns.line.append(row_number)
+        columns.text.extend((
+            code(row[1].strip()),
+            code(row[3].strip()),
+            code(row[4].strip()),
+            code(row[7].strip()),
+            code(row[8].strip()),
+        ))
+    return columns
+
+
+def split_file(path: str, chunk_bytes: int) -> List[Tuple[str, int, int]]:
+    """Cut a file into byte ranges of about chunk_bytes that end on a line break."""
+    size = os.path.getsize(path)
+    chunks = []
+    start = 0
+    with open(path, "rb") as handle:
+        while size - start > chunk_bytes:
+            handle.seek(start + chunk_bytes)
+            handle.readline()
+            end = handle.tell()
+            chunks.append((path, start, end))
+            start = end
+    if start < size or not chunks:
+        chunks.append((path, start, size))
+    return chunks
+
+
+def plan_chunks(paths: List[str], jobs: int) -> List[List[Tuple[str, int, int]]]:
+    """Cut every file into chunks sized for the number of jobs, one list per file."""
+    total = sum(os.path.getsize(path) for path in paths)
+    chunk_bytes = min(PARSE_CHUNK_BYTES, max(PARSE_CHUNK_MIN_BYTES, total // (jobs * PARSE_TASKS_PER_JOB)))
+    return [split_file(path, chunk_bytes) for path in paths]
+
+
+def parse_ahead(
+    submit: Callable[[Tuple[str, int, int]], Callable[[], LogColumns]],
+    chunks: List[Tuple[str, int, int]],
+) -> Iterator[LogColumns]:
+    """Parse one file's chunks in order, with at most PARSE_CHUNKS_AHEAD of them in flight.
+
+    The first chunks are submitted right away, so every file starts parsing before the
+    merge asks for its first entry; each chunk handed out submits the next one.
+    """
+    remaining = iter(chunks)
+    pending = deque(submit(chunk) for chunk in itertools.islice(remaining, PARSE_CHUNKS_AHEAD))
+
+    def stream() -> Iterator[LogColumns]:
+        while pending:
+            columns = pending.popleft()()
+            pending.extend(submit(chunk) for chunk in itertools.islice(remaining, 1))
+            yield columns
+
+    return stream()
+
+
+def iter_columns(chunks: Iterable[LogColumns]) -> Iterator[LogEntry]:
+    """Rebuild the entries of one file, in order, from its parsed chunks."""
+    line_offset = 0
+    for columns in chunks:
+        strings = columns.strings
+        text = columns.text
+        for index in range(len(columns.timestamp)):
+            base = index * 5
+            yield LogEntry(
+                timestamp=columns.timestamp[index],
+                entity_type=strings[text[base]],
+                entity_id=columns.entity_id[index],
+                room=strings[text[base + 1]],
+                device=strings[text[base + 2]],
+                boredom=columns.boredom[index],
+                fear=columns.fear[index],
+                action=strings[text[base + 3]],
+                extra=strings[text[base + 4]],
+                source=columns.path,
+                line=line_offset + columns.line[index],
+            )
+        line_offset += columns.rows
+
+
+def parse_logs(limit: Optional[int] = None, jobs: Optional[int] = None) -> Iterator[LogEntry]:
+    """Parse every log file in parallel and merge them into one stream ordered by timestamp.
+
+    Files are parsed a few chunks ahead of the merge rather than all up front, so memory
+    stays bounded however long the run was. Ties keep the order of a global stable sort:
+    file name first, then line.
+    """
+    paths = sorted(glob.glob("log_*.csv"))
+    if jobs is None:
+        jobs = os.cpu_count() or 1
     try:
-        for path in sorted(glob.glob("log_*.csv")):
-            with open(path, "r", encoding="utf-8", newline="") as handle:
-                reader = csv.reader(handle)
-                for line_number, row in enumerate(reader, start=1):
-                    if not row:
-                        continue
-
-                    timestamp = int(row[0])
-                    entity_type = row[1].strip()
-                    entity_id = int(row[2])
-                    room = row[3].strip()
-                    device = row[4].strip()
-                    boredom = int(row[5])
-                    fear = int(row[6])
-                    action = row[7].strip()
-                    extra = row[8].strip()
-
-                    entries.append(
-                        LogEntry(
-                            timestamp=timestamp,
-                            entity_type=entity_type,
-                            entity_id=entity_id,
-                            room=room,
-                            device=device,
-                            boredom=boredom,
-                            fear=fear,
-                            action=action,
-                            extra=extra,
-                            source=path,
-                            line=line_number,
-                        )
-                    )
+        files = plan_chunks(paths, jobs)
+        tasks = sum(len(chunks) for chunks in files)
+        with contextlib.ExitStack() as stack:
+            if jobs > 1 and tasks > 1:
+                pool = stack.enter_context(multiprocessing.Pool(min(jobs, tasks)))
+
+                def submit(chunk: Tuple[str, int, int]) -> Callable[[], LogColumns]:
+                    return pool.apply_async(parse_chunk, chunk).get
+            else:
+
+                def submit(chunk: Tuple[str, int, int]) -> Callable[[], LogColumns]:
+                    return functools.partial(parse_chunk, *chunk)
+
+            streams = [iter_columns(parse_ahead(submit, chunks)) for chunks in files]
+            merged: Iterator[LogEntry] = heapq.merge(*streams, key=lambda entry: entry.timestamp)
+            if limit is not None:
+                merged = itertools.islice(merged, limit)
+            yield from merged
     except Exception:
         print("Something was wrong while parsing.")
         raise
 
-    entries.sort(key=lambda entry: entry.timestamp)
-    if limit is not None:
-        entries = entries[:limit]
-    return entries
 
+class Validator:
+    """Room, hunter and ghost state carried from one group of entries to the next."""
 
-def simulate(
-    entries: List[LogEntry],
-    change_timestamps: Set[int],
-    pending_evidence: Dict[Tuple[int, str, str], int],
-) -> (Dict[str, int], Dict[str, List[str]]):
-    rooms = {name: RoomState(name=name, neighbors=neighbors) for name, neighbors in WILLOW_ROOMS.items()}
-    hunters: Dict[int, HunterState] = {}
-    ghosts: Dict[int, GhostState] = {}
-
-    stats = defaultdict(int)
-    samples: Dict[str, List[str]] = defaultdict(list)
+    def __init__(self, on_issue: Optional[Callable[[str, str], None]] = None) -> None:
+        self.on_issue = on_issue
+        self.rooms = {name: RoomState(name=name, neighbors=neighbors) for name, neighbors in WILLOW_ROOMS.items()}
+        self.hunters: Dict[int, HunterState] = {}
+        self.ghosts: Dict[int, GhostState] = {}
+        self.stats = defaultdict(int)
+        self.samples: Dict[str, List[str]] = defaultdict(list)
 
-    def report(issue: str, entry: LogEntry, detail: str) -> None:
-        stats[issue] += 1
-        if len(samples[issue]) < 5:
-            samples[issue].append(f"{entry.timestamp} | {detail}")
+    def report(self, issue: str, entry: LogEntry, detail: str) -> None:
+        self.stats[issue] += 1
+        if len(self.samples[issue]) < 5:
+            self.samples[issue].append(f"{entry.timestamp} | {detail}")
+            if self.on_issue is not None:
+                self.on_issue(issue, self.samples[issue][-1])
         entry.issues.add(issue)
 
-    for index, entry in enumerate(entries):
+    def check_group(self, group: List[LogEntry]) -> None:
+        """Check entries sharing one timestamp; same-timestamp tolerances only look inside it."""
+        change_timestamps = compute_room_change_timestamps(group)
+        pending_evidence = compute_pending_evidence(group)
+        for entry in group:
+            self.check_entry(entry, change_timestamps, pending_evidence)
+        self.stats["entries"] += len(group)
+
+    def check_entry(
+        self,
+        entry: LogEntry,
+        change_timestamps: Set[int],
+        pending_evidence: Dict[Tuple[int, str, str], int],
+    ) -> None:
+        rooms = self.rooms
+        hunters = self.hunters
+        ghosts = self.ghosts
+        report = self.report
+
         if entry.entity_type == "hunter":
             state = hunters.get(entry.entity_id)
 
@@ -204,11 +363,11 @@ def simulate(
                     rooms[entry.room].hunters.add(entry.entity_id)
                 else:
                     report("movement", entry, f"{entry.source}:{entry.line} unknown room '{entry.room}' during INIT")
-                continue
+                return
 
             if state is None:
                 report("missing_init", entry, f"{entry.source}:{entry.line} hunter {entry.entity_id} seen before INIT")
-                continue
+                return
 
             state.boredom = entry.boredom
             state.fear = entry.fear
@@ -299,13 +458,11 @@ def simulate(
                 state.returning = False
 
             # Boredom reset check
-            ghost_state = next(iter(ghosts.values()), None)
             if (
-                ghost_state
-                and ghost_state.room
-                and state.room == ghost_state.room
-                and state.boredom != 0
+                state.boredom != 0
+                and state.room
                 and entry.timestamp not in change_timestamps
+                and any(ghost.room == state.room for ghost in ghosts.values())
             ):
                 report("boredom", entry, f"{entry.source}:{entry.line} hunter {entry.entity_id} boredom {state.boredom} with ghost in {state.room}")
 
@@ -324,11 +481,11 @@ def simulate(
                     rooms[entry.room].ghost_present = True
                 else:
                     report("movement", entry, f"{entry.source}:{entry.line} ghost {entry.entity_id} init unknown room {entry.room}")
-                continue
+                return
 
             if state is None:
                 report("missing_init", entry, f"{entry.source}:{entry.line} ghost {entry.entity_id} seen before INIT")
-                continue
+                return
 
             state.boredom = entry.boredom
 
@@ -379,27 +536,153 @@ def simulate(
         else:
             report("unknown_entity", entry, f"{entry.source}:{entry.line} unknown entity type '{entry.entity_type}'")
 
-    stats["entries"] = len(entries)
-    return stats, samples
-
-
-def export_entries(entries: List[LogEntry], path: str) -> None:
-    with open(path, "w", encoding="utf-8", newline="") as handle:
-        writer = csv.writer(handle)
-        writer.writerow([
-            "timestamp",
-            "entity_type",
-            "entity_id",
-            "room",
-            "device",
-            "boredom",
-            "fear",
-            "action",
-            "extra",
-            "issues",
-        ])
-        for entry in entries:
-            writer.writerow(entry.to_row(include_issues=True))
+
+def simulate(
+    entries: Iterable[LogEntry],
+    on_group: Optional[Callable[[List[LogEntry]], None]] = None,
+) -> (Dict[str, int], Dict[str, List[str]]):
+    """Check a timestamp-ordered stream; on_group sees each group once its issues are known."""
+    validator = Validator()
+    for _, grouped in itertools.groupby(entries, key=lambda entry: entry.timestamp):
+        group = list(grouped)
+        validator.check_group(group)
+        if on_group is not None:
+            on_group(group)
+    return validator.stats, validator.samples
+
+
+class LogTail:
+    """Reads whatever a log file gained since the last poll, holding back a partial last line."""
+
+    def __init__(self, path: str) -> None:
+        self.path = path
+        self.offset = 0
+        self.partial = b""
+        self.rows = 0
+        self.last_timestamp: Optional[int] = None
+        self.finished = False
+
+    def read(self) -> List[LogEntry]:
+        try:
+            with open(self.path, "rb") as handle:
+                handle.seek(0, os.SEEK_END)
+                if handle.tell() < self.offset:
+                    print(f"{self.path} shrank while being followed; reading it from the start again", file=sys.stderr)
+                    self.offset, self.partial, self.rows = 0, b"", 0
+                handle.seek(self.offset)
+                data = handle.read()
+        except FileNotFoundError:
+            return []
+        self.offset += len(data)
+        data = self.partial + data
+        cut = data.rfind(b"\n") + 1
+        self.partial = data[cut:]
+        entries = []
+        for raw in data[:cut].splitlines():
+            self.rows += 1
+            if not raw.strip():
+                continue
+            row = next(csv.reader([raw.decode("utf-8")]))
+            entry = LogEntry(
+                timestamp=int(row[0]),
+                entity_type=row[1].strip(),
+                entity_id=int(row[2]),
+                room=row[3].strip(),
+                device=row[4].strip(),
+                boredom=int(row[5]),
+                fear=int(row[6]),
+                action=row[7].strip(),
+                extra=row[8].strip(),
+                source=self.path,
+                line=self.rows,
+            )
+            self.last_timestamp = entry.timestamp
+            self.finished = entry.action == "EXIT"
+            entries.append(entry)
+        return entries
+
+
+def follow_logs(
+    validator: Validator,
+    on_group: Optional[Callable[[List[LogEntry]], None]],
+    poll_ms: int,
+    lag_ms: int,
+    idle_exit_s: float,
+) -> None:
+    """Check log files as they grow, until nothing was written for idle_exit_s or Ctrl-C.
+
+    An entry is held until every entity still running has logged something later, or
+    until it is lag_ms old by the wall clock, so issues surface within about
+    lag_ms + poll_ms of being written.
+    """
+    tails: Dict[str, LogTail] = {}
+    pending: List[Tuple[int, str, int, LogEntry]] = []
+    quiet_since = time.monotonic()
+    status_at = time.monotonic()
+    reported = 0
+
+    def release(watermark: Optional[int]) -> None:
+        while pending and (watermark is None or pending[0][0] < watermark):
+            timestamp = pending[0][0]
+            group = []
+            while pending and pending[0][0] == timestamp:
+                group.append(heapq.heappop(pending)[3])
+            validator.check_group(group)
+            if on_group is not None:
+                on_group(group)
+
+    try:
+        while True:
+            for path in glob.glob("log_*.csv"):
+                if path not in tails:
+                    tails[path] = LogTail(path)
+            grew = False
+            for tail in tails.values():
+                for entry in tail.read():
+                    heapq.heappush(pending, (entry.timestamp, entry.source, entry.line, entry))
+                    grew = True
+
+            # Entity files are written in time order, so nothing older than the slowest
+            # running entity's last line can still arrive, barring a writer stalled past lag_ms
+            watermark = int(time.time() * 1000) - lag_ms
+            running = [tail.last_timestamp for tail in tails.values()
+                       if not tail.finished and tail.last_timestamp is not None]
+            if running:
+                watermark = max(watermark, min(running))
+            release(watermark)
+
+            now = time.monotonic()
+            if grew:
+                quiet_since = now
+            elif tails and idle_exit_s > 0 and now - quiet_since >= idle_exit_s:
+                break
+            issues = sum(count for issue, count in validator.stats.items() if issue != "entries")
+            if now - status_at >= FOLLOW_STATUS_S and (grew or issues != reported):
+                print(f"Following {len(tails)} files: {validator.stats['entries']} entries checked, "
+                      f"{issues} issues, {len(pending)} waiting", flush=True)
+                status_at = now
+                reported = issues
+            time.sleep(poll_ms / 1000.0)
+    except KeyboardInterrupt:
+        pass
+    for tail in tails.values():
+        for entry in tail.read():
+            heapq.heappush(pending, (entry.timestamp, entry.source, entry.line, entry))
+    release(None)
+
+
+EXPORT_HEADER = [
+    "timestamp",
+    "entity_type",
+    "entity_id",
+    "room",
+    "device",
+    "boredom",
+    "fear",
+    "action",
+    "extra",
+    "issues",
+]
 
 
 def main() -> None:
@@ -416,13 +699,61 @@ def main() -> None:
         default=None,
         help="Optional output CSV path containing the combined, ordered logs.",
     )
+    parser.add_argument(
+        "--jobs",
+        type=int,
+        default=None,
+        help="Processes used to parse the log files (default: one per core).",
+    )
+    parser.add_argument(
+        "--follow",
+        action="store_true",
+        help="Keep checking the log files while the simulation writes them.",
+    )
+    parser.add_argument(
+        "--poll-ms",
+        type=int,
+        default=FOLLOW_POLL_MS,
+        help=f"With --follow, how often to look for new lines and files (default {FOLLOW_POLL_MS}).",
+    )
+    parser.add_argument(
+        "--lag-ms",
+        type=int,
+        default=FOLLOW_LAG_MS,
+        help=f"With --follow, the longest an entry waits for slower files (default {FOLLOW_LAG_MS}).",
+    )
+    parser.add_argument(
+        "--idle-exit",
+        type=float,
+        default=FOLLOW_IDLE_EXIT_S,
+        help=f"With --follow, stop once nothing was written for this many seconds; "
+             f"0 waits for Ctrl-C (default {FOLLOW_IDLE_EXIT_S:g}).",
+    )
 
     args = parser.parse_args()
+    if args.follow and args.limit is not None:
+        parser.error("--limit can't be combined with --follow")
 
-    entries = parse_logs(limit=args.limit)
-    change_timestamps = compute_room_change_timestamps(entries)
-    pending_evidence = compute_pending_evidence(entries)
-    stats, samples = simulate(entries, change_timestamps, pending_evidence)
+    export_handle = None
+    on_group = None
+    if args.export:
+        export_handle = open(args.export, "w", encoding="utf-8", newline="")
+        writer = csv.writer(export_handle)
+        writer.writerow(EXPORT_HEADER)
+
+        def on_group(group: List[LogEntry]) -> None:
+            writer.writerows(entry.to_row(include_issues=True) for entry in group)
+
+    try:
+        if args.follow:
+            validator = Validator(on_issue=lambda issue, sample: print(f"[{issue}] {sample}", flush=True))
+            follow_logs(validator, on_group, args.poll_ms, args.lag_ms, args.idle_exit)
+            stats, samples = validator.stats, validator.samples
+        else:
+            stats, samples = simulate(parse_logs(limit=args.limit, jobs=args.jobs), on_group)
+    finally:
+        if export_handle is not None:
+            export_handle.close()
 
     print(f"Processed entries: {stats['entries']}")
     print(f"Movement issues: {stats['movement']}")
@@ -451,7 +782,6 @@ def main() -> None:
             print(f"  - {sample}")
 
     if args.export:
-        export_entries(entries, args.export)
         print(f"Combined timeline exported to {args.export}")
 
 